@@ -13,7 +13,8 @@
 #include "usart.h"
 #include "cmsis_os.h"
 
-#define DEBUGREPO_UART_HANDLE 				huart6
+// UART de salida: USART2 (PA2 TX / PA3 RX, 115200 baudios), configurada en STCubeMX
+#define DEBUGREPO_UART_HANDLE 				huart2
 
 #define DEBUGREPO_SEND_STATS
 #define DEBUGREPO_SEND_HANDLERS_STATS
@@ -21,25 +22,69 @@
 #define DEBUGREPO_SEND_HANDLERS_STATS_EVERY             100
 
 // Para utilizar un mutex que permita serializar el acceso a la cola compartida como sección crítica
+// (la que usan las tareas que no tienen cola propia, ver DEBUGREPO_TASKS_NUMSLOTS)
 // basta con eliminar la marca de comentario de la definición de la macro USE_MUTEX:
 #define DEBUGREPO_USE_MUTEX
 
+// Para enviar los mensajes por DMA directamente desde el repositorio (sin copiarlos y
+// agrupando en una única transferencia los mensajes de texto consecutivos)
+// basta con eliminar la marca de comentario de la definición de la macro USE_DMA.
+// Requiere que la UART DEBUGREPO_UART_HANDLE tenga asociado un canal DMA de transmisión
+// (USART2_TX en DMA1_Stream6 canal 4, configurado en STCubeMX) y que su callback de
+// transmisión terminada llame a debugrepoUARTCallback
+#define DEBUGREPO_USE_DMA
+
 // Para estresar al sistema mientras se insertan mensajes en la cola 
 // (y forzar así conflictos de acceso a la cola entre las diferentes tareas) 
 // basta con eliminar la marca de comentario de la definición de la macro USE_DELAY
 //#define DEBUGREPO_USE_DELAY
 
-#define DEBUGREPO_INSERT_DELAY_TICKS         1
+// Para despertar a la tarea de extracción con una notificación (osSignalSet) cada
+// vez que una tarea inserta un mensaje, en lugar de esperar a que venza el retardo
+// DEBUGREPO_EXTRACT_DELAY_TICKS, basta con eliminar la marca de comentario de la
+// definición de la macro USE_NOTIFY. Los mensajes insertados desde ISR siguen
+// recogiéndose al vencer el retardo.
+#define DEBUGREPO_USE_NOTIFY
+
 #define DEBUGREPO_EXTRACT_DELAY_TICKS        10
 
+/* Prioridad y tamaño de pila (en palabras) de la tarea de extracción: por debajo
+   de las tareas KNX para que el envío por la consola no retrase al bus */
+#define DEBUGREPO_TASK_PRIORITY              osPriorityLow
+#define DEBUGREPO_TASK_STACK_SIZE            192
 
-/* Numero maximo de bytes almacenados en el repositorio (tareas)        */
-#define DEBUGREPO_SIZE	                        (4*1024)
+
+/* Numero de colas del repositorio de tareas: cada tarea que inserta mensajes
+   obtiene una cola propia (sin exclusión mutua) hasta agotar las colas;
+   la última es compartida por el resto de tareas                       */
+#define DEBUGREPO_TASKS_NUMSLOTS                (6)
+/* Numero maximo de bytes almacenados en cada cola del repositorio
+  de tareas (potencia de 2)                                             */
+#define DEBUGREPO_SIZE	                        (1024)
 /* Numero maximo de bytes almacenados en el repositorio de manejadores 
-  (uno por nivel de interrupcion)                                       */
+  (uno por nivel de interrupcion, potencia de 2)                        */
 #define DEBUGREPO_HANDLERS_SIZE	                (512)
+/* Numero maximo de mensajes almacenados en cada cola del repositorio
+  de tareas y de manejadores (potencias de 2)                           */
+#define DEBUGREPO_RECORDS                       (64)
+#define DEBUGREPO_HANDLERS_RECORDS              (32)
 
 #define DEBUGREPO_MSG_MAXLEN			(512)
+
+/* Trazas binarias (debugrepoInsertTrace). Se envían por la consola sin formatear,
+   mezcladas con el texto, en tramas con el formato:
+     DEBUGREPO_TRACE_SYNC | longitud (2 bytes) | marca de tiempo (4 bytes, ms) | evento (1 byte) | datos
+   donde la longitud cuenta los bytes que la siguen y los campos multibyte son little-endian.
+   Tools/debugrepo_decode.py separa las tramas del texto y las presenta en el PC */
+#define DEBUGREPO_TRACE_SYNC                    ((char)0x1E)
+#define DEBUGREPO_TRACE_FRAME_LEN               (3)
+#define DEBUGREPO_TRACE_HDR_LEN                 (5)
+#define DEBUGREPO_TRACE_MAXLEN                  (DEBUGREPO_MSG_MAXLEN - DEBUGREPO_TRACE_FRAME_LEN - DEBUGREPO_TRACE_HDR_LEN)
+/* Identificadores de evento reservados (el resto quedan a disposición de la aplicación) */
+#define DEBUGREPO_TRACE_KNX_RX                  ((uint8_t)0x01)   /* Trama KNX recibida del bus */
+#define DEBUGREPO_TRACE_KNX_TX                  ((uint8_t)0x02)   /* Trama KNX enviada al bus   */
+#define DEBUGREPO_TRACE_KNX_MON                 ((uint8_t)0x03)   /* Trama capturada por knx_monitor
+                                                                     (marca de tiempo en us, ver knx_monitor.h) */
 #define DEBUGREPO_HANDLERS_FINAL_MASK 	        ((uint32_t)0x0000007FU)
 
 /* Estadísticas de uso / errores                 */
@@ -53,6 +98,7 @@ void debugrepoInit (void);
 int debugrepoInsertMsg (const char *msg);
 int debugrepoInsertMsgLen (const char *msg, uint16_t len);
 int debugrepoInsertBinMsgLen (const char *msg, uint16_t len);
+int debugrepoInsertTrace (uint8_t event_id, const void *data, uint16_t len);
 int debugrepoExtractMsg (char msg[], int maxlen);
 void debugrepoUARTCallback(UART_HandleTypeDef *huart);
 
@@ -20,4 +20,9 @@ void copyBinString(const char *from, unsigned int length, char buffer[], unsigne
 char *formatUnsignedInt(char buffer[], unsigned int buffer_length, unsigned int value, unsigned int formatted_length, char padding);
 char *formatInt(char buffer[], unsigned int buffer_length, int value, unsigned int formatted_length, char padding);
 
+// Construccion de lineas de texto por partes: escriben a partir de p sin pasar
+// de end y devuelven la nueva posicion, o NULL si no cabe (y si p ya era NULL)
+char *appendString(char *p, char *end, const char *str);
+char *appendUnsignedInt(char *p, char *end, const char *label, unsigned int value);
+
 #endif // __HELPERS_H
@@ -0,0 +1,159 @@
+/**
+ * @file isr_prof.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Medida del tiempo de ejecución de las rutinas de interrupción
+ *
+ * Cada ISR instrumentada marca su entrada y su salida con @ref ISR_PROF_ENTER
+ * y @ref ISR_PROF_EXIT, que leen el contador de ciclos del DWT del Cortex-M4.
+ * La ISR sólo deposita la muestra (instante de entrada y duración en ciclos)
+ * en una cola circular propia de esa ISR, sin bloqueos: la ISR es el único
+ * productor y la tarea que llama a @ref isr_prof_process el único consumidor.
+ *
+ * El cálculo de mínimo, máximo, media, histograma y periodo entre entradas
+ * (jitter) se hace fuera de la ISR, desde @ref isr_prof_process.
+ *
+ * Si no se define la macro ISR_PROF las macros de instrumentación quedan
+ * vacías y el módulo no añade ningún coste.
+ *
+ * @{
+ */
+#ifndef __ISR_PROF_H
+#define __ISR_PROF_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Para instrumentar las ISR basta con eliminar la marca de comentario de la definición de la macro */
+//#define ISR_PROF
+
+#ifdef ISR_PROF
+#include "stm32f4xx.h"  // Para el acceso al DWT (CMSIS)
+#endif
+
+/* Número de muestras que caben en la cola de cada ISR (potencia de 2) */
+#define ISR_PROF_RING_SIZE          64
+
+/* Número de intervalos del histograma: el intervalo k acumula las ejecuciones
+   de entre 2^k y 2^(k+1)-1 ciclos (el último, las de 2^(ISR_PROF_HIST_BINS-1) o más) */
+#define ISR_PROF_HIST_BINS          16
+
+#ifdef ISR_PROF
+/**
+ * @brief Marcar la entrada en una ISR instrumentada
+ * @param[in] id Identificador de la ISR (ver @ref isr_prof_id_t)
+ *
+ * Declara una variable local, por lo que sólo puede usarse una vez por función
+ */
+#define ISR_PROF_ENTER(id)          uint32_t isr_prof_start_ = DWT->CYCCNT
+/**
+ * @brief Marcar la salida de una ISR instrumentada
+ * @param[in] id Identificador de la ISR (ver @ref isr_prof_id_t)
+ */
+#define ISR_PROF_EXIT(id)           isr_prof_record((id), isr_prof_start_, DWT->CYCCNT)
+#else
+#define ISR_PROF_ENTER(id)
+#define ISR_PROF_EXIT(id)
+#endif
+
+/* ----------------------- Tipos de datos públicos ------------------------- */
+
+/**
+ * Tipo enumerado con las ISR instrumentadas
+ */
+enum isr_prof_id_e {
+    ISR_PROF_USART3_IRQ,            /**< USART3_IRQHandler completa (TPUART)         */
+    ISR_PROF_KNX_RX_CPLT,           /**< knx_phy_tpuart_rx_cplt                       */
+    ISR_PROF_KNX_TX_CPLT,           /**< knx_phy_tpuart_tx_cplt                       */
+    ISR_PROF_KNX_RESET_TIMEOUT,     /**< knx_phy_tpuart_reset_timeout                 */
+    ISR_PROF_NUM_IDS                /**< Número de ISR instrumentadas (no es una ISR) */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef enum isr_prof_id_e isr_prof_id_t;
+
+/**
+ * Tipo estructurado con las estadísticas acumuladas de una ISR (en ciclos de CPU)
+ */
+struct isr_prof_stats_s {
+    uint32_t count;                         /**< Ejecuciones procesadas                               */
+    uint32_t overruns;                      /**< Muestras perdidas por estar llena la cola            */
+    uint32_t min;                           /**< Duración mínima                                      */
+    uint32_t max;                           /**< Duración máxima                                      */
+    uint64_t total;                         /**< Suma de duraciones (media = total / count)           */
+    uint32_t period_min;                    /**< Mínimo tiempo entre dos entradas consecutivas        */
+    uint32_t period_max;                    /**< Máximo tiempo entre dos entradas consecutivas        */
+    uint32_t hist[ISR_PROF_HIST_BINS];      /**< Histograma logarítmico de duraciones                 */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct isr_prof_stats_s isr_prof_stats_t;
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+/**
+ * @brief Inicializar el módulo y arrancar el contador de ciclos del DWT
+ *
+ * @returns Nada
+ */
+void isr_prof_init (void);
+
+/**
+ * @brief Registrar una ejecución de una ISR (llamada desde @ref ISR_PROF_EXIT)
+ * @param[in] id    Identificador de la ISR
+ * @param[in] start Valor de DWT->CYCCNT a la entrada
+ * @param[in] end   Valor de DWT->CYCCNT a la salida
+ *
+ * @returns Nada
+ */
+void isr_prof_record (isr_prof_id_t id, uint32_t start, uint32_t end);
+
+/**
+ * @brief Vaciar las colas de muestras y acumularlas en las estadísticas
+ *
+ * Sólo puede llamarse desde una única tarea (consumidor de las colas)
+ *
+ * @returns Nada
+ */
+void isr_prof_process (void);
+
+/**
+ * @brief Obtener las estadísticas acumuladas de una ISR
+ * @param[in]  id    Identificador de la ISR
+ * @param[out] stats Destino de la copia
+ *
+ * Procesa previamente las muestras pendientes (ver @ref isr_prof_process)
+ *
+ * @returns Nada
+ */
+void isr_prof_get_stats (isr_prof_id_t id, isr_prof_stats_t *stats);
+
+/**
+ * @brief Enviar las estadísticas de todas las ISR a través de debug_repo
+ *
+ * Una línea de texto por ISR con el formato
+ * <tt>[isrprof] NOMBRE n=.. min=.. max=.. mean=.. pmin=.. pmax=.. ovr=.. hist=h0,h1,...</tt>
+ *
+ * @returns Nada
+ */
+void isr_prof_report (void);
+
+/**
+ * @brief Enviar las estadísticas de todas las ISR en binario a través de debug_repo
+ *
+ * Dos mensajes por ISR. Ambos empiezan por el identificador de la ISR y un octeto
+ * de parte: 0 va seguido de los campos de @ref isr_prof_stats_t anteriores a hist
+ * y 1 del histograma, tal y como están en memoria (little-endian).
+ *
+ * @returns Nada
+ */
+void isr_prof_dump (void);
+
+#endif /* __ISR_PROF_H */
+
+/* @} */
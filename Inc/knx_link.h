@@ -22,9 +22,64 @@
 
 /* ---------------- #includes necesarios para este fichero ----------------- */
 #include <stdint.h>     // Para los tipos uintXX_t
+#include <stddef.h>     // Para size_t
+#include "knx_stats.h"  // Para knx_stats_t
 
 /* --------------------------- Macros pÃºblicas ----------------------------- */
 
+/* Número de descriptores de trama para L_Data.req (ver @ref knx_link_data_req_alloc),
+   para tramas estándar y para tramas extendidas (ver knx_pool.h). Con más
+   descriptores que KNX_LINK_TX_QUEUE_LEN una ráfaga de una prioridad no agota
+   los que necesitan las demás */
+#define KNX_LINK_TX_STD_FRAMES      8
+#define KNX_LINK_TX_EXT_FRAMES      1
+
+/* Longitud máxima de una trama a transmitir (igual a KNX_PHY_TX_MAX_FRAME_LEN) */
+#define KNX_LINK_TX_MAX_FRAME_LEN   63
+/* Máximo de octetos de LSDU (TPCI, APCI y datos) de una trama a transmitir.
+   Hasta 16 octetos se envía trama estándar y a partir de ahí extendida */
+#define KNX_LINK_TX_MAX_LSDU        (KNX_LINK_TX_MAX_FRAME_LEN - 8)
+
+/* Valores asociados al campo priority de knx_link_tx_frame_t */
+#define KNX_LINK_PRIORITY_SYSTEM    0
+#define KNX_LINK_PRIORITY_URGENT    1
+#define KNX_LINK_PRIORITY_NORMAL    2
+#define KNX_LINK_PRIORITY_LOW       3
+#define KNX_LINK_PRIORITIES         4   /**< Número de prioridades (una cola de transmisión por prioridad) */
+/* Valores asociados al campo at de knx_link_tx_frame_t */
+#define KNX_LINK_AT_INDIVIDUAL      0
+#define KNX_LINK_AT_GROUP           1
+/* Valor inicial del campo hop_count de knx_link_tx_frame_t */
+#define KNX_LINK_DEFAULT_HOP_COUNT  6
+
+/* Entradas de la caché de tramas recibidas para descartar repeticiones
+   (ver @ref knx_link_rx_is_duplicate) y tiempo (en ms) que se recuerda
+   cada trama entregada. La TP-UART del emisor repite hasta 3 veces una
+   trama no reconocida en unas decenas de ms */
+#define KNX_LINK_RX_DUP_ENTRIES     8
+#define KNX_LINK_RX_DUP_EXPIRY_MS   500
+
+/* Periodo (en ms) con el que debe llamarse a knx_link_health_poll. Con el
+   aviso de temperatura (TW) activo la TP-UART recibe como mucho una trama
+   por periodo */
+#define KNX_LINK_HEALTH_PERIOD_MS   250
+/* Periodos seguidos con nuevos errores PE o TE de la TP-UART tras los que
+   se reinicia */
+#define KNX_LINK_HEALTH_MAX_STRIKES 3
+/* Espera máxima (en ms) de la confirmación de esos resets */
+#define KNX_LINK_HEALTH_RESET_WAIT_MS 1000
+
+/* Valores asociados a knx_link_data_req() */
+#define KNX_LINK_DATA_REQ_OK        ((uint32_t)1) /**< Trama encolada (el descriptor vuelve a la pila al entregarla al nivel físico) */
+#define KNX_LINK_DATA_REQ_ERROR     ((uint32_t)0) /**< Parámetros no válidos o el estado del nivel de enlace no es NORMAL */
+#define KNX_LINK_DATA_REQ_BUSY      ((uint32_t)2) /**< La cola de su prioridad está llena, reintentar más tarde */
+
+/* Tramas como máximo en cada cola de transmisión */
+#define KNX_LINK_TX_QUEUE_LEN       4
+/* Tiempo máximo (en ms) de espera de L_Data.con de la TP-UART antes de
+   entregarle la siguiente trama */
+#define KNX_LINK_TX_CON_TIMEOUT_MS  500
+
 /* ----------------------- Tipos de datos pÃºblicos ------------------------- */
 
 
@@ -37,13 +92,60 @@ enum knx_link_comm_state_e {
     KNX_LINK_NORMAL_STATE,          /**< Modo normal de trabajo, 
                                          podemos enviar/recibir tramas */
     KNX_LINK_STOP_STATE,            /**< Modo stop / error                   */
-    KNX_LINK_MONITOR_STATE          /**< Modo monitor (no implementado)      */
+    KNX_LINK_MONITOR_STATE          /**< Modo monitor: TP-UART en busmonitor,
+                                         captura pasiva (ver knx_monitor.h) */
 };
 /**
  * RedefiniciÃ³n con typedef para usar una Ãºnica palabra
  */
 typedef enum knx_link_comm_state_e knx_link_comm_state_t;
 
+/**
+ * Tipo estructurado descriptor de una trama a enviar con L_Data.req
+ *
+ * Se obtiene de una pila de descriptores (@ref knx_link_data_req_alloc), se
+ * rellenan los parámetros y la LSDU directamente en él y se entrega con
+ * @ref knx_link_data_req. La cabecera la completa el nivel de enlace sobre
+ * el propio descriptor, sin copiar la LSDU, y el checksum lo añade el nivel
+ * físico al enviarla.
+ * Cada descriptor es un bloque de knx_pool.h con sitio justo para una trama
+ * estándar o para la trama extendida más larga que admite la TP-UART.
+ */
+struct knx_link_tx_frame_s {
+    uint8_t  priority;      /**< Prioridad (KNX_LINK_PRIORITY_xxx)                        */
+    uint8_t  at;            /**< Address type (KNX_LINK_AT_INDIVIDUAL / KNX_LINK_AT_GROUP) */
+    uint8_t  hop_count;     /**< Contador de saltos (0 .. 7)                              */
+    uint8_t  lsdu_len;      /**< Octetos de LSDU escritos en lsdu (1 .. lsdu_max)         */
+    uint8_t  lsdu_max;      /**< Capacidad de lsdu (sólo lectura)                         */
+    uint16_t da;            /**< Destination address                                      */
+    uint32_t tick;          /**< Instante de encolado en ms (uso interno)                 */
+    uint8_t  *lsdu;         /**< LSDU (TPCI, APCI y datos), dentro de bytes               */
+    uint8_t  bytes[];       /**< Trama (uso interno)                                      */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_link_tx_frame_s knx_link_tx_frame_t;
+
+/**
+ * Tipo estructurado con las estadísticas de una cola de transmisión (ver @ref knx_link_get_tx_stats)
+ */
+struct knx_link_tx_stats_s {
+    uint32_t depth;           /**< Tramas en cola                                           */
+    uint32_t depth_hwm;       /**< Máximo de tramas en cola                                 */
+    uint32_t queued;          /**< Tramas aceptadas por knx_link_data_req                   */
+    uint32_t rejected;        /**< Tramas rechazadas por estar la cola llena                */
+    uint32_t sent;            /**< Tramas entregadas al nivel físico                        */
+    uint32_t con_timeouts;    /**< Tramas sin L_Data.con en KNX_LINK_TX_CON_TIMEOUT_MS      */
+    uint32_t latency_last;    /**< Espera en cola (ms) de la última trama entregada         */
+    uint32_t latency_max;     /**< Máxima espera en cola (ms)                               */
+    uint32_t latency_total;   /**< Suma de esperas (media = latency_total / sent)           */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_link_tx_stats_s knx_link_tx_stats_t;
+
 /* ----------------- DeclaraciÃ³n de funciones pÃºblicas --------------------- */
 
 /**
@@ -93,6 +195,21 @@ uint16_t knx_link_get_poll_slot_number (void);
  */
 uint32_t knx_link_add_grp_address (uint16_t grp_address); 
 
+/**
+ * @brief Añadir un conjunto de direcciones de grupo al sistema
+ * @param[in] list Direcciones de grupo a añadir
+ * @param[in] n    Número de direcciones en list
+ *
+ * Esta función almacena de una vez todas las direcciones de grupo de list
+ * en la tabla de direcciones de grupo del nivel de enlace. Con la tabla
+ * ordenada, las direcciones se ordenan y se eliminan los duplicados una
+ * única vez para todo el lote, en lugar de una vez por dirección.
+ *
+ * @returns 0 Falta memoria (sólo se han añadido las direcciones que caben)
+ * @returns 1 Operación terminada con éxito
+ */
+uint32_t knx_link_add_grp_addresses (const uint16_t *list, size_t n); 
+
 /**
  * @brief Buscar una direcciÃ³n de grupo entre las almacenadas en el sistema
  * @param[in] grp_address DirecciÃ³n de grupo a buscar
@@ -105,6 +222,143 @@ uint32_t knx_link_add_grp_address (uint16_t grp_address);
  */
 uint32_t knx_link_exists_grp_address (uint16_t grp_address); 
 
+/**
+ * @brief Comprobar si una trama recibida es la repetición de una ya entregada
+ * @param[in] ctrl Campo CTRL de la trama
+ * @param[in] sa   Source address
+ * @param[in] da   Destination address
+ * @param[in] chk  Octeto CHK de la trama
+ * @param[in] now  Instante de recepción en ms
+ *
+ * Sólo las tramas con REP = 0 (repetidas) pueden ser duplicados. Se comparan
+ * con las entregadas en los últimos KNX_LINK_RX_DUP_EXPIRY_MS (ver
+ * @ref knx_link_rx_delivered) por SA, DA, CTRL sin el bit REP y checksum.
+ * Es llamada por el nivel físico desde la ISR de recepción.
+ *
+ * @returns 1 Repetición de una trama ya entregada (debe descartarse)
+ * @returns 0 En otro caso
+ */
+uint32_t knx_link_rx_is_duplicate (uint8_t ctrl, uint16_t sa, uint16_t da, uint8_t chk, uint32_t now);
+
+/**
+ * @brief Recordar una trama recibida entregada a los niveles superiores
+ * @param[in] ctrl Campo CTRL de la trama
+ * @param[in] sa   Source address
+ * @param[in] da   Destination address
+ * @param[in] chk  Octeto CHK de la trama
+ * @param[in] now  Instante de recepción en ms
+ *
+ * Ocupa la entrada de la caché de la misma trama, una caducada o la más
+ * antigua. Es llamada por el nivel físico desde la ISR de recepción.
+ *
+ * @returns Nada
+ */
+void knx_link_rx_delivered (uint8_t ctrl, uint16_t sa, uint16_t da, uint8_t chk, uint32_t now);
+
+
+
+/**
+ * @brief L_Data.req() :: Obtener un descriptor de trama a enviar
+ * @param[in] lsdu_len Octetos de LSDU que se van a enviar (1 .. KNX_LINK_TX_MAX_LSDU)
+ *
+ * El descriptor se saca de la pila de tramas estándar (hasta 16 octetos de LSDU)
+ * o de la de tramas extendidas, y se devuelve con lsdu_len ya ajustado y los
+ * parámetros por defecto (prioridad LOW, dirección de grupo 0 y contador de
+ * saltos KNX_LINK_DEFAULT_HOP_COUNT). Basta con escribir la LSDU en
+ * frame->lsdu, ajustar da, etc. y entregarlo con @ref knx_link_data_req.
+ * lsdu_len puede reducirse después, pero no superar lsdu_max.
+ * Puede llamarse desde una tarea o desde una ISR.
+ *
+ * @returns Descriptor, o NULL si lsdu_len no es válido o no quedan descriptores libres
+ */
+knx_link_tx_frame_t *knx_link_data_req_alloc (uint8_t lsdu_len);
+
+/**
+ * @brief L_Data.req() :: Enviar una trama
+ * @param[in] frame Descriptor obtenido con @ref knx_link_data_req_alloc
+ *
+ * Encola la trama en la cola de su prioridad. El planificador entrega a la
+ * TP-UART una trama cada vez, siempre la más antigua de la cola de mayor
+ * prioridad con tramas pendientes, en cuanto la TP-UART ha confirmado la
+ * anterior (L_Data.con). Al entregarla completa la cabecera (con la dirección
+ * individual de este sistema como SA) sobre el propio descriptor y la pasa al
+ * nivel físico (@ref knx_phy_frame_req), que le añade el checksum.
+ * La confirmación L_Data.con() llega a través de knx_phy_data_con.
+ * Sólo debe llamarse desde tareas.
+ *
+ * @returns KNX_LINK_DATA_REQ_OK Trama encolada; el descriptor pertenece al nivel de enlace y no debe volver a usarse
+ * @returns KNX_LINK_DATA_REQ_BUSY Cola llena; el descriptor sigue perteneciendo al llamante para reintentar
+ * @returns KNX_LINK_DATA_REQ_ERROR Parámetros no válidos o estado distinto de NORMAL; el descriptor sigue perteneciendo al llamante
+ */
+uint32_t knx_link_data_req (knx_link_tx_frame_t *frame);
+
+/**
+ * @brief Devolver a la pila un descriptor sin enviarlo
+ * @param[in] frame Descriptor obtenido con @ref knx_link_data_req_alloc
+ *
+ * Puede llamarse desde una tarea o desde una ISR.
+ *
+ * @returns Nada
+ */
+void knx_link_data_req_free (knx_link_tx_frame_t *frame);
+
+/**
+ * @brief Avisar al planificador de transmisión de que la TP-UART puede estar libre
+ * @param[in] confirmed 1 si se ha recibido L_Data.con de la trama en curso, 0 si
+ *                      sólo ha terminado una transmisión por la UART
+ *
+ * Es llamada por el nivel físico desde las ISR de la UART, y entrega la
+ * siguiente trama pendiente si la TP-UART no tiene ninguna sin confirmar.
+ * También puede llamarse desde una tarea (con confirmed = 0) para recuperar
+ * las colas si se ha perdido un L_Data.con sin que haya nuevas peticiones.
+ *
+ * @returns Nada
+ */
+void knx_link_tx_event (uint32_t confirmed);
+
+/**
+ * @brief Supervisar el estado de la TP-UART
+ *
+ * Debe llamarse cada KNX_LINK_HEALTH_PERIOD_MS desde una tarea de baja
+ * prioridad. Con el último U_State.ind recibido (@ref knx_phy_get_tpuart_state)
+ * y los contadores de sus bits (knx_stats.h):
+ * - con el aviso de temperatura (TW) activo, limita la transmisión a una
+ *   trama por periodo
+ * - si aparecen nuevos errores PE o TE durante KNX_LINK_HEALTH_MAX_STRIKES
+ *   periodos seguidos, o el nivel de enlace está en STOP, reinicia la TP-UART
+ *   y espera la confirmación
+ * Después pide un nuevo U_State.ind para el siguiente periodo y da paso a
+ * la siguiente trama pendiente (@ref knx_link_tx_event).
+ * Durante un reset en curso sólo recoge su confirmación si ya ha llegado, y
+ * en modo monitor sólo mantiene la base de tiempos de la captura
+ * (@ref knx_monitor_poll).
+ *
+ * @returns Nada
+ */
+void knx_link_health_poll (void);
+
+/**
+ * @brief Obtener una instantánea de los contadores de los niveles físico y de enlace
+ * @param[out] stats Destino de la copia
+ *
+ * La copia es coherente sin deshabilitar interrupciones (ver knx_stats.h).
+ * Sólo debe llamarse desde tareas.
+ *
+ * @returns Nada
+ */
+void knx_link_get_stats (knx_stats_t *stats);
+
+/**
+ * @brief Obtener una copia de las estadísticas de una cola de transmisión
+ * @param[in]  priority Prioridad de la cola (KNX_LINK_PRIORITY_xxx)
+ * @param[out] stats    Destino de la copia
+ *
+ * Sólo debe llamarse desde tareas.
+ *
+ * @returns Nada
+ */
+void knx_link_get_tx_stats (uint8_t priority, knx_link_tx_stats_t *stats);
+
 
 
 /**
@@ -119,6 +373,59 @@ knx_link_comm_state_t knx_link_get_comm_state (void);
 
 
 
+/**
+ * @brief Reiniciar la TP-UART
+ *
+ * Pasa el nivel de enlace a KNX_LINK_INIT_STATE y solicita el reset al nivel
+ * físico (@ref knx_phy_reset_req), sin esperar a la respuesta. Es la única
+ * forma de abandonar el modo monitor. El resultado se recoge con
+ * @ref knx_link_wait_reset_con. Sólo debe llamarse desde tareas.
+ *
+ * @returns 0 No se ha podido solicitar el reset (ya hay uno en curso)
+ * @returns 1 Operación terminada con éxito
+ */
+uint32_t knx_link_reset (void);
+
+/**
+ * @brief Recoger la confirmación del reset de la TP-UART
+ * @param[in] millisec Tiempo máximo de espera en ms (0 para no esperar, osWaitForever)
+ *
+ * Si llega Ph_reset.con() el nivel de enlace pasa a KNX_LINK_NORMAL_STATE
+ * (reset correcto) o a KNX_LINK_STOP_STATE (la TP-UART no responde).
+ * Sólo puede llamarse desde una tarea.
+ *
+ * Ph_reset.con() lo lee una sola tarea a la vez, ya que con
+ * KNX_PHY_RESET_CON_USE_NOTIFY la primitiva admite un único consumidor: la
+ * primera que llama. Si otra tarea llama mientras tanto (sólo una a la vez),
+ * espera a que la primera publique el nuevo estado, que se lo comunica nada
+ * más recibir la confirmación. Si la primera termina su espera sin
+ * confirmación, la segunda pasa a leer Ph_reset.con() durante el resto de la
+ * suya. Con millisec igual a 0 no espera a la que está leyendo.
+ *
+ * @returns Estado del nivel de enlace tras la espera (KNX_LINK_INIT_STATE si
+ *          el reset sigue en curso)
+ */
+knx_link_comm_state_t knx_link_wait_reset_con (uint32_t millisec);
+
+
+
+/**
+ * @brief Pasar a modo monitor del bus
+ *
+ * Vacía la cola de captura del monitor (@ref knx_monitor_start), pasa el nivel de
+ * enlace a KNX_LINK_MONITOR_STATE y ordena a la TP-UART el paso a modo busmonitor.
+ * A partir de ese momento no se envían ni se reconocen tramas: todo el tráfico
+ * del bus se captura con marca de tiempo y se extrae con knx_monitor_peek /
+ * knx_monitor_read. Para volver al modo normal hay que reiniciar la TP-UART
+ * (@ref knx_link_reset).
+ *
+ * @returns 0 El estado actual no es NORMAL o no se ha podido enviar la orden a la TP-UART
+ * @returns 1 Operación terminada con éxito
+ */
+uint32_t knx_link_monitor_start (void);
+
+
+
 /**
  * @brief Inicializar el nivel de enlace
  * @param[in] ind_address DirecciÃ³n individual de este sistema
@@ -129,6 +436,11 @@ knx_link_comm_state_t knx_link_get_comm_state (void);
  * la TP-UART utilizando el servicio correspondiente del nivel fÃ­sico.
  * En la inicializaciÃ³n de los parÃ¡metros no se hace ningÃºn tipo de comprobaciÃ³n de errores
  *
+ * El reset de la TP-UART es asíncrono: el nivel de enlace queda en
+ * KNX_LINK_INIT_STATE hasta que se recoge la confirmación con
+ * @ref knx_link_wait_reset_con. Debe llamarse después de knx_phy_init y de
+ * crear los objetos de FreeRTOS (MX_FREERTOS_Init).
+ *
  * @warning Esta funciÃ³n debe ser la primera utilizada del nivel de enlace por los niveles superiores
  *
  * @returns Nada
@@ -0,0 +1,148 @@
+/**
+ * @file knx_monitor.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Monitor pasivo del bus KNX (modo busmonitor de la TP-UART)
+ *
+ * Con el nivel de enlace en KNX_LINK_MONITOR_STATE (ver @ref knx_link_monitor_start)
+ * la TP-UART entrega todos los octetos del bus (tramas de datos, de polling y
+ * caracteres de reconocimiento) sin reconocer ni filtrar nada. La ISR de
+ * recepción del nivel físico los pasa a @ref knx_monitor_rx_octet, que los
+ * agrupa en tramas, marca cada trama con el instante (en microsegundos, a partir
+ * del contador de ciclos del DWT) de su primer octeto y la escribe directamente
+ * en una cola circular de captura.
+ *
+ * La cola tiene un único productor (la ISR) y un único consumidor (la tarea que
+ * la vacía), por lo que no hay bloqueos. Si no queda hueco la trama entrante se
+ * descarta y se contabiliza; la recepción nunca se detiene.
+ *
+ * Cada trama capturada ocupa en la cola un registro con el mismo formato que
+ * las trazas de debug_repo (ver debug_repo.h):
+ *   KNX_MONITOR_SYNC | longitud (2 bytes) | instante (4 bytes, us) | KNX_MONITOR_EVENT | octetos de la trama
+ * con los campos multibyte en little-endian y la longitud contando los bytes
+ * que la siguen. Así el contenido de la cola puede enviarse tal cual (por la
+ * UART de depuración, USB, etc.) y Tools/debugrepo_decode.py lo presenta como
+ * texto o lo convierte a pcap.
+ *
+ * @{
+ */
+#ifndef __KNX_MONITOR_H
+#define __KNX_MONITOR_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Tamaño de la cola de captura en bytes (potencia de 2) */
+#define KNX_MONITOR_BUFFER_SIZE     8192
+
+/* Silencio máximo entre dos octetos de una misma trama (en microsegundos).
+   Termina las tramas cuya longitud no se conoce (o que se han cortado) */
+#define KNX_MONITOR_GAP_US          2500
+
+/* Formato de los registros de la cola (coincide con DEBUGREPO_TRACE_SYNC y DEBUGREPO_TRACE_KNX_MON) */
+#define KNX_MONITOR_SYNC            0x1E
+#define KNX_MONITOR_EVENT           0x03
+#define KNX_MONITOR_HDR_LEN         8     /**< Bytes de cada registro previos a los octetos de la trama */
+
+/* ----------------------- Tipos de datos públicos ------------------------- */
+
+/**
+ * Tipo estructurado con las estadísticas de la captura (ver @ref knx_monitor_get_stats)
+ */
+struct knx_monitor_stats_s {
+    uint32_t frames;          /**< Tramas capturadas                                          */
+    uint32_t octets;          /**< Octetos recibidos del bus                                  */
+    uint32_t dropped_frames;  /**< Tramas descartadas por estar llena la cola                 */
+    uint32_t dropped_octets;  /**< Octetos de las tramas descartadas                          */
+    uint32_t incomplete;      /**< Tramas terminadas por silencio sin alcanzar su longitud    */
+    uint32_t hwm;             /**< Máxima ocupación observada de la cola (bytes)              */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_monitor_stats_s knx_monitor_stats_t;
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+/**
+ * @brief Vaciar la cola de captura, poner a cero las estadísticas y arrancar la base de tiempos
+ *
+ * La llama @ref knx_link_monitor_start antes de pasar la TP-UART a modo busmonitor
+ *
+ * @returns Nada
+ */
+void knx_monitor_start (void);
+
+/**
+ * @brief Capturar un octeto recibido del bus
+ * @param[in] data Octeto recibido desde la TP-UART
+ *
+ * Es llamada desde la ISR de recepción del nivel físico mientras el nivel de
+ * enlace está en KNX_LINK_MONITOR_STATE
+ *
+ * @returns Nada
+ */
+void knx_monitor_rx_octet (uint8_t data);
+
+/**
+ * @brief Mantener la base de tiempos y cerrar la trama en curso tras un silencio
+ *
+ * El contador de ciclos da la vuelta cada ~25 s a 168 MHz y la base de tiempos
+ * sólo cuenta las vueltas si se consulta al menos una vez por vuelta. Sin
+ * tráfico ni consumidor nadie lo haría, así que debe llamarse periódicamente
+ * desde una tarea mientras dure el modo monitor (lo hace
+ * @ref knx_link_health_poll cada KNX_LINK_HEALTH_PERIOD_MS).
+ *
+ * @returns Nada
+ */
+void knx_monitor_poll (void);
+
+/**
+ * @brief Obtener el bloque contiguo de bytes capturados pendiente de enviar
+ * @param[out] data Inicio del bloque, dentro de la propia cola de captura
+ *
+ * Permite vaciar la cola sin copias, p.ej. con HAL_UART_Transmit_DMA o
+ * CDC_Transmit_FS, llamando a @ref knx_monitor_consume al terminar el envío.
+ * El bloque puede terminar en mitad de un registro (al dar la vuelta la cola):
+ * el siguiente bloque empieza donde termina éste.
+ * También cierra la trama en curso si lleva más de KNX_MONITOR_GAP_US en silencio.
+ * Sólo puede llamarse desde una única tarea (consumidor de la cola).
+ *
+ * @returns Número de bytes del bloque (0 si no hay nada pendiente)
+ */
+uint32_t knx_monitor_peek (const uint8_t **data);
+
+/**
+ * @brief Liberar bytes de la cola de captura ya enviados
+ * @param[in] len Número de bytes a liberar (como mucho los devueltos por @ref knx_monitor_peek)
+ *
+ * @returns Nada
+ */
+void knx_monitor_consume (uint32_t len);
+
+/**
+ * @brief Extraer bytes capturados copiándolos
+ * @param[out] buf    Destino de la copia
+ * @param[in]  maxlen Tamaño de buf
+ *
+ * Equivale a @ref knx_monitor_peek + memcpy + @ref knx_monitor_consume,
+ * dando la vuelta a la cola si hace falta.
+ *
+ * @returns Número de bytes copiados
+ */
+uint32_t knx_monitor_read (uint8_t *buf, uint32_t maxlen);
+
+/**
+ * @brief Obtener una copia coherente de las estadísticas de la captura
+ * @param[out] stats Destino de la copia
+ *
+ * @returns Nada
+ */
+void knx_monitor_get_stats (knx_monitor_stats_t *stats);
+
+#endif /* __KNX_MONITOR_H */
+
+/* @} */
@@ -14,7 +14,7 @@
  *       Cola FreeRTOS pública knx_phy_reset_con
  *   
  * Utilizaremos la capa HAL para la transmisión / recepción a la UART,
- * y un timer TIM en modo básico para el time-out del reset de la TP-UART
+ * y un timer software de FreeRTOS (one-shot) para el time-out del reset de la TP-UART
  *
  * @{
  */
@@ -32,11 +32,80 @@
 
 /* Valores asociados a knx_phy_reset_req() */
 #define KNX_PHY_RESET_REQ_OK        ((uint32_t)1) /**< Solicitud Ph_reset.req() correcta */
-#define KNX_PHY_RESET_REQ_ERROR     ((uint32_t)0) /**< Error en la solicitud Ph_reset.req(), el estado del nivel de enlace no es INIT (NORMAL, STOP, etc.) */
+#define KNX_PHY_RESET_REQ_ERROR     ((uint32_t)0) /**< Error en la solicitud Ph_reset.req(), el estado del nivel de enlace no es INIT (NORMAL, STOP, etc.) o ya hay un reset en curso */
+
+/* Valores asociados a knx_phy_reset_con (parte baja de cada elemento) */
+#define KNX_PHY_RESET_CON_OK        ((uint16_t)1) /**< La TPUART ha respondido con U_Reset.ind */
+#define KNX_PHY_RESET_CON_ERROR     ((uint16_t)0) /**< La TPUART no ha respondido tras KNX_PHY_RESET_MAX_ATTEMPTS intentos */
+
+/* Time-out del primer intento de reset (en ms). Cada reintento duplica el
+   time-out del anterior, hasta KNX_PHY_RESET_TIMEOUT_MAX_MS */
+#define KNX_PHY_RESET_TIMEOUT_MS        10
+#define KNX_PHY_RESET_TIMEOUT_MAX_MS    160
+/* Número máximo de intentos de reset antes de confirmar el error */
+#define KNX_PHY_RESET_MAX_ATTEMPTS      6
+
+/* Para señalizar Ph_data.ind octeto a octeto (en lugar de trama a trama)
+   basta con eliminar la marca de comentario de la definición de la macro */
+//#define KNX_PHY_DATA_IND_PER_OCTET
+
+/* Para medir la carga de la recepción (ciclos por octeto en la ISR, ocupación de
+   knx_phy_data_ind, octetos y tramas perdidos) y poder inyectar tráfico con
+   knx_phy_rx_replay() basta con eliminar la marca de comentario de la definición de la macro */
+//#define KNX_PHY_RX_STATS
+
+/* Para entregar una primitiva con una notificación directa a la tarea que la
+   consume (osSignalSet), en lugar de a través de su cola de STCubeMX, basta con
+   eliminar la marca de comentario de la definición de la macro correspondiente.
+   Los elementos se guardan en un buffer circular propio del nivel físico del
+   mismo tamaño que la cola, y la notificación sólo despierta al consumidor.
+   La cola queda sin uso y puede eliminarse en STCubeMX. En ambos modos los
+   consumidores leen con knx_phy_reset_con_get, knx_phy_data_con_get y
+   knx_phy_data_ind_get, y cada primitiva debe tener una única tarea
+   consumidora que espere en ella */
+//#define KNX_PHY_RESET_CON_USE_NOTIFY
+//#define KNX_PHY_DATA_CON_USE_NOTIFY
+//#define KNX_PHY_DATA_IND_USE_NOTIFY
+
+/* Número de elementos de cada primitiva (los de las colas de STCubeMX, potencia de 2) */
+#define KNX_PHY_RESET_CON_LEN       1
+#define KNX_PHY_DATA_CON_LEN        16
+#define KNX_PHY_DATA_IND_LEN        16
+
+/* Longitud máxima de una trama en octetos (trama extendida con LG = 254) */
+#define KNX_PHY_MAX_FRAME_LEN       263
+
+/* Número de descriptores de trama para la recepción (uno en recepción y los demás
+   pendientes de leer), para tramas estándar y para tramas extendidas (ver knx_pool.h) */
+#define KNX_PHY_RX_STD_FRAMES       4
+#define KNX_PHY_RX_EXT_FRAMES       2
+
+/* Valores asociados al campo ft de knx_phy_frame_t */
+#define KNX_PHY_DATA_FT_ESTANDAR             0
+#define KNX_PHY_DATA_FT_EXTENDIDA            1
+/* Valores asociados al campo at de knx_phy_frame_t */
+#define KNX_PHY_DATA_AT_INDIVIDUAL           0
+#define KNX_PHY_DATA_AT_GRUPO                1
+/* Valores asociados al campo chk de knx_phy_frame_t */
+#define KNX_PHY_DATA_CHK_NOT_CHECKED         0  /**< Checksum no comprobado */
+#define KNX_PHY_DATA_CHK_OK                  1  /**< Checksum correcto      */
+#define KNX_PHY_DATA_CHK_ERROR               2  /**< Checksum incorrecto    */
 
 /* Valores asociados a knx_phy_data_req() */
 #define KNX_PHY_DATA_REQ_OK         ((uint32_t)1) /**< Solicitud Ph_data.req() correcta */
 #define KNX_PHY_DATA_REQ_ERROR      ((uint32_t)0) /**< Error en la solicitud Ph_data.req(), el estado del nivel de enlace no es NORMAL (INIT, STOP, etc.) */
+#define KNX_PHY_DATA_REQ_BUSY       ((uint32_t)2) /**< Solicitud Ph_data.req() rechazada, hay una transmisión a la TPUART en curso */
+
+/* Valores asociados a knx_phy_state_req() */
+#define KNX_PHY_STATE_REQ_OK        ((uint32_t)1) /**< Orden U_State.req enviada a la TPUART */
+#define KNX_PHY_STATE_REQ_ERROR     ((uint32_t)0) /**< Error en la solicitud, el estado del nivel de enlace no es NORMAL o la UART está ocupada */
+
+/* Valores asociados a knx_phy_busmon_req() */
+#define KNX_PHY_BUSMON_REQ_OK       ((uint32_t)1) /**< Orden U_ActivateBusmon enviada a la TPUART */
+#define KNX_PHY_BUSMON_REQ_ERROR    ((uint32_t)0) /**< Error en la solicitud, el estado del nivel de enlace no es MONITOR o la UART está ocupada */
+
+/* Longitud máxima de una trama a transmitir en octetos (el prefijo U_L_DATA_END codifica la longitud en 6 bits) */
+#define KNX_PHY_TX_MAX_FRAME_LEN    63
 
 /* ----------------------- Tipos de datos públicos ------------------------- */
 
@@ -88,7 +157,8 @@ enum knx_phy_data_ind_class_e {
     KNX_PHY_DATA_IND_CLASS_START,   /**< El dato es inicio de trama (CTRL)  */
     KNX_PHY_DATA_IND_CLASS_INNER,   /**< El dato es intermedio              */
     /* Añadido: */
-    KNX_PHY_DATA_IND_CLASS_END      /**< El dato es fin de trama (CHK)      */
+    KNX_PHY_DATA_IND_CLASS_END,     /**< El dato es fin de trama (CHK)      */
+    KNX_PHY_DATA_IND_CLASS_END_CHK_ERROR /**< El dato es fin de trama (CHK), checksum incorrecto */
     /* No utilizados:
     ,
     KNX_PHY_DATA_REQ_CLASS_ACK,
@@ -104,6 +174,65 @@ enum knx_phy_data_ind_class_e {
 typedef enum knx_phy_data_ind_class_e knx_phy_data_ind_class_t;
 
 
+/**
+ * Tipo estructurado descriptor de una trama completa recibida desde la TPUART
+ *
+ * Los campos de cabecera se extraen durante la recepción, de modo que el
+ * nivel de enlace no necesita volver a analizar la trama.
+ * Cada descriptor es un bloque de knx_pool.h con sitio justo para el tipo de
+ * trama que anuncia su CTRL (estándar o extendida).
+ */
+struct knx_phy_frame_s {
+    uint8_t  ft;                            /**< Frame type (KNX_PHY_DATA_FT_ESTANDAR / KNX_PHY_DATA_FT_EXTENDIDA) */
+    uint8_t  at;                            /**< Address type (KNX_PHY_DATA_AT_INDIVIDUAL / KNX_PHY_DATA_AT_GRUPO) */
+    uint8_t  ctrl;                          /**< Campo CTRL                                 */
+    uint8_t  ctrle;                         /**< Campo CTRLE (sólo trama extendida)         */
+    uint16_t sa;                            /**< Source address                             */
+    uint16_t da;                            /**< Destination address                        */
+    uint8_t  chk;                           /**< Estado del checksum (KNX_PHY_DATA_CHK_xxx) */
+    uint8_t  lsdu_pos;                      /**< Posición en bytes del primer octeto LSDU   */
+    uint16_t lsdu_len;                      /**< Octetos de LSDU (LG + 1)                   */
+    uint16_t len;                           /**< Octetos recibidos (CTRL ... CHK)           */
+    uint16_t size;                          /**< Capacidad de bytes (KNX_POOL_STD_FRAME_LEN
+                                                 o KNX_PHY_MAX_FRAME_LEN)                   */
+    uint8_t  bytes[];                       /**< Octetos de la trama                        */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_phy_frame_s knx_phy_frame_t;
+
+
+#ifdef KNX_PHY_RX_STATS
+/**
+ * Tipo estructurado con las estadísticas de la recepción (ver @ref knx_phy_get_rx_stats)
+ */
+struct knx_phy_rx_stats_s {
+    uint32_t octets;          /**< Octetos procesados                                          */
+    uint32_t frames;          /**< Tramas completas recibidas (dirigidas o no a este sistema)  */
+    uint32_t frames_ind;      /**< Tramas señalizadas a través de knx_phy_data_ind             */
+    uint32_t dropped_frames;  /**< Tramas dirigidas perdidas (BUSY, NACK o cola llena)         */
+    uint32_t dropped_octets;  /**< Octetos de trama descartados (sin descriptor o desbordados) */
+    uint32_t resyncs;         /**< Tramas abandonadas por silencio entre octetos               */
+    uint32_t chk_errors;      /**< Tramas completas con checksum incorrecto                    */
+    uint32_t acks_missed;     /**< Reconocimientos no enviados por estar la UART ocupada       */
+    uint32_t acks_deferred;   /**< Reconocimientos intercalados en la subida de una trama      */
+    uint32_t ack_defer_cycles_max; /**< Máximo de ciclos de CPU que esperó uno de ellos         */
+    uint32_t acks_busy;       /**< Tramas dirigidas reconocidas con BUSY (sin descriptor libre)  */
+    uint32_t acks_nack;       /**< Tramas dirigidas reconocidas con NACK (error en la cabecera)  */
+    uint32_t duplicates;      /**< Repeticiones de tramas ya entregadas descartadas            */
+    uint32_t ind_queue_hwm;   /**< Máxima ocupación observada de knx_phy_data_ind              */
+    uint32_t cycles_last;     /**< Ciclos de CPU del último octeto procesado                   */
+    uint32_t cycles_max;      /**< Máximo de ciclos de CPU por octeto                          */
+    uint64_t cycles_total;    /**< Suma de ciclos de CPU (media = cycles_total / octets)       */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_phy_rx_stats_s knx_phy_rx_stats_t;
+#endif
+
+
 /* ----------------- Declaración de funciones públicas --------------------- */
 
 
@@ -127,15 +256,37 @@ void knx_phy_tpuart_tx_cplt(void);
  */
 void knx_phy_tpuart_rx_cplt(void);
 
+/**
+ * Callback de aviso de error de recepción (paridad, trama, ruido o
+ * desbordamiento) de la UART conectada a la TPUART
+ *
+ * Este callback es llamado desde el callback general de error de las
+ * diferentes UARTs del sistema, @code HAL_UART_ErrorCallback. Cuenta los
+ * errores de paridad, trama, ruido y desbordamiento (ver knx_stats.h), marca
+ * la trama en curso como dañada (si aún no se ha reconocido, se responde NACK)
+ * y vuelve a armar la recepción, que la capa HAL detiene en caso de desbordamiento.
+ *
+ * @param[in] error_code Campo ErrorCode del handle de la UART (HAL_UART_ERROR_xxx)
+ */
+void knx_phy_tpuart_rx_error(uint32_t error_code);
+
 /**
  * Callback de aviso de timeout durante el reset de la TPUART
  *
- * Este callback es llamado desde el callback general de gestión de time-out 
- * de los diferentes TIMs del sistema funcionando en modo básico,
- * @code HAL_TIM_PeriodElapsedCallback. 
+ * Este callback es llamado desde el callback del timer software
+ * knx_phy_reset_timer (knx_phy_reset_timer_cb, en el contexto de la tarea de
+ * servicio de timers de FreeRTOS). Reintenta el reset con el doble de time-out
+ * o, agotados los intentos, confirma el error a través de knx_phy_reset_con.
  */
 void knx_phy_tpuart_reset_timeout(void);
 
+/**
+ * @brief Timer one-shot para el time-out del reset de la TPUART
+ *
+ * Timer descrito como knx_phy_reset_timer, el handle asignado por STCubeMX es knx_phy_reset_timerHandle
+ */
+extern osTimerId knx_phy_reset_timerHandle;
+
   
 /* ------------------------ PARTE 2: Primitivas  -------------------------- */
 
@@ -146,8 +297,11 @@ void knx_phy_tpuart_reset_timeout(void);
  * @brief Ph_reset.req() :: Inicializar TPUART
  *
  * Esta función da comienzo a la inicialización la TPUART y 
- * arranca un timer TIM en modo básico para gestionar el caso de time-out 
- * por falta de respuesta de la TPUART 
+ * arranca un timer software one-shot para gestionar el caso de time-out 
+ * por falta de respuesta de la TPUART. No espera a la respuesta: la ISR de
+ * recepción confirma el reset en cuanto llega U_Reset.ind y, si no llega,
+ * el time-out reintenta con espera exponencial acotada (ver
+ * KNX_PHY_RESET_TIMEOUT_MS). El resultado llega por knx_phy_reset_con.
  *
  * @returns KNX_PHY_RESET_REQ_OK En caso de solicitud correcta (el estado actual del nivel de enlace es INIT)
  * @returns KNX_PHY_RESET_REQ_ERROR En caso de solicitud incorrecta (el estado actual del nivel de enlace no es INIT)
@@ -158,9 +312,27 @@ uint32_t knx_phy_reset_req (void);
  * @brief Ph_reset.con() :: Confirmación de la inicialización de la TPUART
  *
  * Cola descrita como knx_reset_con, el handle asignado por STCubeMX es knx_reset_conHandle
+ * (o notificación directa con KNX_PHY_RESET_CON_USE_NOTIFY). Se lee con
+ * @ref knx_phy_reset_con_get.
+ *
+ * Cada elemento de esta cola es un uint16_t que empaqueta dos uint8_t:
+ * - La parte alta es el número de intentos realizados
+ * - La parte baja es el resultado (KNX_PHY_RESET_CON_OK / KNX_PHY_RESET_CON_ERROR)
  */
 extern osMessageQId knx_phy_reset_conHandle;
 
+/**
+ * @brief Esperar un elemento de Ph_reset.con()
+ * @param[in] millisec Tiempo máximo de espera (0 no espera, osWaitForever sin límite)
+ *
+ * Sólo puede llamarse desde una tarea. Con KNX_PHY_RESET_CON_USE_NOTIFY la
+ * tarea que espera (millisec distinto de 0) pasa a ser la que se notifica.
+ *
+ * @returns Igual que osMessageGet: status osEventMessage y el elemento en value.v,
+ *          osEventTimeout si ha vencido la espera u osOK si millisec es 0 y no hay ninguno
+ */
+osEvent knx_phy_reset_con_get (uint32_t millisec);
+
 
 /* ----------------------- SECCIÓN 2.B: Ph_data  -------------------------- */
 
@@ -172,13 +344,36 @@ extern osMessageQId knx_phy_reset_conHandle;
  *
  * @returns KNX_PHY_DATA_REQ_OK En caso de solicitud correcta (el estado actual del nivel de enlace es NORMAL)
  * @returns KNX_PHY_DATA_REQ_ERROR En caso de solicitud incorrecta (el estado actual del nivel de enlace no es NORMAL)
+ * @returns KNX_PHY_DATA_REQ_BUSY En caso de haber una transmisión a la TPUART en curso
  */
 uint32_t knx_phy_data_req (knx_phy_data_req_class_t p_req_class, uint8_t p_data);
 
+/**
+ * @brief Ph_data.req() :: Enviar una trama completa a TPUART
+ * @param[in] frame Octetos de la trama sin el checksum (CTRL ... último octeto de LSDU)
+ * @param[in] len   Número de octetos de frame (como máximo KNX_PHY_TX_MAX_FRAME_LEN - 1)
+ *
+ * Equivale a una secuencia de @ref knx_phy_data_req (START, INNER..., END), pero
+ * construye de una vez la secuencia de prefijos U_L_DATA y octetos y la envía
+ * a la TPUART mediante DMA, por tramos de un prefijo y su octeto para que el
+ * U_AckInformation de una trama recibida mientras tanto pueda intercalarse
+ * entre dos tramos. El checksum se calcula en la misma pasada y se añade como
+ * último octeto. La confirmación Ph_data.con() es única para toda
+ * la trama (KNX_PHY_DATA_CON_STATUS_END con el checksum).
+ * El contenido de frame se copia, por lo que puede reutilizarse al retornar.
+ *
+ * @returns KNX_PHY_DATA_REQ_OK En caso de solicitud correcta
+ * @returns KNX_PHY_DATA_REQ_ERROR En caso de solicitud incorrecta (el estado actual del nivel de enlace no es NORMAL o longitud no válida)
+ * @returns KNX_PHY_DATA_REQ_BUSY En caso de haber una transmisión a la TPUART en curso
+ */
+uint32_t knx_phy_frame_req (const uint8_t *frame, uint8_t len);
+
 /**
  * @brief Ph_data.con() :: Confirmación del envío de octeto a la TPUART
  *
  * Cola descrita como knx_phy_data_con, el handle asignado por STCubeMX es knx_phy_data_conHandle
+ * (o notificación directa con KNX_PHY_DATA_CON_USE_NOTIFY). Se lee con
+ * @ref knx_phy_data_con_get.
  *
  * Cada elemento de esta cola es un uint16_t y empaqueta dos uint8_t:
  * - La parte alta es el knx_phy_data_con_status_t
@@ -190,23 +385,139 @@ uint32_t knx_phy_data_req (knx_phy_data_req_class_t p_req_class, uint8_t p_data)
  */
 extern osMessageQId knx_phy_data_conHandle;
 
+/**
+ * @brief Esperar un elemento de Ph_data.con()
+ * @param[in] millisec Tiempo máximo de espera (0 no espera, osWaitForever sin límite)
+ *
+ * Igual que @ref knx_phy_reset_con_get, con KNX_PHY_DATA_CON_USE_NOTIFY.
+ *
+ * @returns Igual que osMessageGet
+ */
+osEvent knx_phy_data_con_get (uint32_t millisec);
+
 /**
  * @brief Ph_data.ind() :: Señalización de recepción de octeto desde la TPUART
  *
  * Cola descrita como knx_phy_data_ind, el handle asignado por STCubeMX es knx_phy_data_indHandle
+ * (o notificación directa con KNX_PHY_DATA_IND_USE_NOTIFY). Se lee con
+ * @ref knx_phy_data_ind_get.
  *
- * Cada elemento de esta cola es un uint16_t y empaqueta dos uint8_t:
- * - La parte alta es el knx_phy_data_ind_class_t
- * - La parte baja es el dado recibido desde la TPUART
+ * Cada elemento de esta cola es un uint32_t, cuyo contenido depende del modo de señalización:
  *
- * Asumiendo las variables ind_class (tipo @ref knx_phy_data_ind_class_t) y p_data (tipo uint8_t), 
- * el empaquetamiento se realiza con
- * <tt> ((((uint16_t)ind_class) << 8) & 0xFF00) | (((uint16_t)p_data) & 0x00FF)  </tt>
+ * - Trama a trama (por defecto): el elemento es un puntero a un @ref knx_phy_frame_t
+ *   con una trama completa dirigida a este sistema. La trama se ensambla en la ISR
+ *   de recepción, por lo que hay un único elemento por trama. El descriptor pertenece
+ *   al receptor hasta que lo devuelve con @ref knx_phy_data_ind_release().
+ *
+ * - Octeto a octeto (KNX_PHY_DATA_IND_PER_OCTET): el elemento empaqueta dos uint8_t:
+ *   - La parte alta es el knx_phy_data_ind_class_t
+ *   - La parte baja es el dado recibido desde la TPUART
+ *
+ *   Asumiendo las variables ind_class (tipo @ref knx_phy_data_ind_class_t) y p_data (tipo uint8_t), 
+ *   el empaquetamiento se realiza con
+ *   <tt> ((((uint16_t)ind_class) << 8) & 0xFF00) | (((uint16_t)p_data) & 0x00FF)  </tt>
  */
 extern osMessageQId knx_phy_data_indHandle;
 
+/**
+ * @brief Esperar un elemento de Ph_data.ind()
+ * @param[in] millisec Tiempo máximo de espera (0 no espera, osWaitForever sin límite)
+ *
+ * Igual que @ref knx_phy_reset_con_get, con KNX_PHY_DATA_IND_USE_NOTIFY.
+ *
+ * @returns Igual que osMessageGet
+ */
+osEvent knx_phy_data_ind_get (uint32_t millisec);
+
+/**
+ * @brief Devolver un descriptor de trama recibido a través de knx_phy_data_ind
+ * @param[in] frame Descriptor a devolver
+ *
+ * Una vez devuelto, el descriptor puede ser reutilizado por la ISR de recepción
+ * en cualquier momento, por lo que no debe volver a accederse a él.
+ * Puede llamarse desde una tarea o desde una ISR.
+ *
+ * @returns Nada
+ */
+void knx_phy_data_ind_release (knx_phy_frame_t *frame);
+
+
+#ifdef KNX_PHY_RX_STATS
+/**
+ * @brief Obtener una copia coherente de las estadísticas de la recepción
+ * @param[out] stats Destino de la copia
+ *
+ * @returns Nada
+ */
+void knx_phy_get_rx_stats (knx_phy_rx_stats_t *stats);
+
+/**
+ * @brief Poner a cero las estadísticas de la recepción
+ *
+ * @returns Nada
+ */
+void knx_phy_reset_rx_stats (void);
+
+/**
+ * @brief Inyectar un octeto en la recepción como si llegase de la TPUART
+ * @param[in] data Octeto recibido
+ * @param[in] tick Instante de recepción (en ticks de la capa HAL)
+ *
+ * Recorre exactamente el mismo camino que @ref knx_phy_tpuart_rx_cplt (FSM,
+ * filtro de direcciones, reconocimiento y señalización), de modo que permite
+ * reproducir tráfico capturado o sintético al ritmo deseado y medir su coste.
+ * Debe llamarse con la interrupción de la UART de la TPUART deshabilitada, o
+ * desde un contexto que no pueda ser interrumpido por ella.
+ *
+ * @returns Nada
+ */
+void knx_phy_rx_replay (uint8_t data, uint32_t tick);
+#endif
+
+
+/* ------------------- SECCIÓN 2.B bis: Estado de la TPUART  ------------------ */
+
+
+/**
+ * @brief Consultar el estado de la TPUART
+ *
+ * Envía la orden U_State.req. La respuesta U_State.ind (igual que las que la
+ * TPUART envía por iniciativa propia) la reconoce la ISR de recepción entre
+ * tramas, sin pasar por el autómata de recepción de tramas: cuenta sus bits
+ * (ver knx_stats.h) y la guarda para @ref knx_phy_get_tpuart_state.
+ *
+ * @returns KNX_PHY_STATE_REQ_OK En caso de solicitud correcta
+ * @returns KNX_PHY_STATE_REQ_ERROR En caso de solicitud incorrecta (el estado del nivel de enlace no es NORMAL o hay una transmisión en curso)
+ */
+uint32_t knx_phy_state_req (void);
+
+/**
+ * @brief Obtener el último U_State.ind recibido de la TPUART
+ *
+ * @returns Bits de estado (KNX_TPUART_U_STATE_SC | RE | TE | PE | TW), 0 si no se ha recibido ninguno
+ */
+uint8_t knx_phy_get_tpuart_state (void);
+
+
+/* ----------------------- SECCIÓN 2.C: Busmonitor  ----------------------- */
+
+
+/**
+ * @brief Pasar la TPUART a modo busmonitor
+ *
+ * Envía la orden U_ActivateBusmon. Debe llamarse con el nivel de enlace ya en
+ * KNX_LINK_MONITOR_STATE (ver @ref knx_link_monitor_start): desde ese momento la
+ * ISR de recepción entrega todos los octetos del bus a @ref knx_monitor_rx_octet,
+ * sin análisis de tramas, reconocimientos ni señalización a knx_phy_data_ind.
+ * La TPUART sólo abandona el modo busmonitor con un reset (@ref knx_phy_reset_req).
+ *
+ * @returns KNX_PHY_BUSMON_REQ_OK En caso de solicitud correcta
+ * @returns KNX_PHY_BUSMON_REQ_ERROR En caso de solicitud incorrecta (el estado del nivel de enlace no es MONITOR o hay una transmisión en curso)
+ */
+uint32_t knx_phy_busmon_req (void);
+
 
-/* ----------------------- SECCIÓN 2.C: General  -------------------------- */
+/* ----------------------- SECCIÓN 2.D: General  -------------------------- */
 
 
 /**
@@ -0,0 +1,128 @@
+/**
+ * @file knx_phy_bench.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Latencia de entrega de Ph_Data.ind y Ph_Data.con hasta su tarea consumidora
+ *
+ * Mide, con el contador de ciclos del DWT, el tiempo que pasa desde que el
+ * nivel físico recibe el octeto que completa una primitiva hasta que la
+ * tarea que la consume la obtiene de knx_phy_data_ind_get (knxRxTask) o de
+ * knx_phy_data_con_get (knxTxTask). Los octetos se inyectan con
+ * knx_phy_rx_replay(), que recorre el mismo camino que la ISR de recepción:
+ * - DATA_IND: trama estándar a una dirección de grupo de este sistema; se
+ *   mide la entrega al recibir su último octeto (CHK)
+ * - DATA_CON: señalización L_Data.confirmation positiva de la TP-UART
+ *
+ * La medida incluye el procesado del octeto en la FSM de recepción, la
+ * entrega por cola o por notificación (según KNX_PHY_DATA_IND_USE_NOTIFY y
+ * KNX_PHY_DATA_CON_USE_NOTIFY en knx_phy.h) y el cambio de contexto. Para
+ * comparar ambos mecanismos hay que repetirla con cada configuración.
+ *
+ * Después comprueba que el ACK de una trama recibida mientras se sube otra a
+ * la TP-UART (@ref knx_phy_frame_req) se intercala en la subida en lugar de
+ * perderse, y mide cuánto esperó.
+ *
+ * Las tareas consumidoras avisan de cada entrega con
+ * @ref knx_phy_bench_delivered (ver freertos.c). Necesita KNX_PHY_RX_STATS.
+ * Si no se define la macro KNX_PHY_BENCH el módulo queda vacío.
+ *
+ * @{
+ */
+#ifndef __KNX_PHY_BENCH_H
+#define __KNX_PHY_BENCH_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Para compilar la medida (y lanzarla al arrancar, ver StartAppTask en freertos.c)
+   basta con eliminar la marca de comentario de la definición de la macro */
+//#define KNX_PHY_BENCH
+
+/* Número de mediciones de cada primitiva */
+#define KNX_PHY_BENCH_ITERATIONS    200
+
+/* Pausa entre mediciones (en ms), para que terminen el ACK a la TP-UART y
+   el trabajo de las tareas consumidoras */
+#define KNX_PHY_BENCH_GAP_MS        5
+
+/* Dirección de grupo que se añade a la tabla para las tramas de DATA_IND */
+#define KNX_PHY_BENCH_GRP_ADDRESS   0x0A02
+
+/* ----------------------- Tipos de datos públicos ------------------------- */
+
+/**
+ * Tipo enumerado con las primitivas medidas
+ */
+enum knx_phy_bench_id_e {
+    KNX_PHY_BENCH_DATA_IND,         /**< Ph_Data.ind hasta knxRxTask          */
+    KNX_PHY_BENCH_DATA_CON,         /**< Ph_Data.con hasta knxTxTask          */
+    KNX_PHY_BENCH_NUM_IDS           /**< Número de primitivas (no es una)     */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef enum knx_phy_bench_id_e knx_phy_bench_id_t;
+
+/**
+ * Tipo estructurado con la latencia de entrega de una primitiva (en ciclos de CPU)
+ */
+struct knx_phy_bench_stats_s {
+    uint32_t count;                 /**< Mediciones                             */
+    uint32_t missed;                /**< Inyecciones que no llegaron a la tarea */
+    uint32_t min;                   /**< Latencia mínima                        */
+    uint32_t max;                   /**< Latencia máxima                        */
+    uint64_t total;                 /**< Suma de latencias (media = total / count) */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_phy_bench_stats_s knx_phy_bench_stats_t;
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+#ifdef KNX_PHY_BENCH
+/**
+ * @brief Medir la latencia de entrega de ambas primitivas y enviar el resultado
+ * @param[in] iterations Número de mediciones de cada primitiva
+ *
+ * Debe llamarse desde una tarea de menor prioridad que knxRxTask y knxTxTask,
+ * con el nivel de enlace en estado normal y el bus sin tráfico. Envía a través
+ * de debug_repo una línea por primitiva con el formato
+ * <tt>[knxbench] NOMBRE mode=.. n=.. missed=.. min=.. max=.. mean=..</tt>
+ * (en ciclos), donde mode es queue o notify, y una última con el formato
+ * <tt>[knxbench] ACK_DURING_TX req=.. deferred=.. missed=.. wait_max=.. PASS|FAIL</tt>
+ * (wait_max en ciclos). Esta última transmite una trama real al bus y pone a
+ * cero las estadísticas de la recepción; el nivel de enlace no debe tener
+ * tramas pendientes de transmitir.
+ *
+ * @returns Nada
+ */
+void knx_phy_bench_run (uint32_t iterations);
+
+/**
+ * @brief Avisar de que la tarea consumidora ha obtenido una primitiva
+ * @param[in] id Primitiva
+ *
+ * Debe llamarse nada más volver de knx_phy_data_ind_get o knx_phy_data_con_get.
+ * Sólo registra una medición si hay una inyección de esa primitiva en curso.
+ *
+ * @returns Nada
+ */
+void knx_phy_bench_delivered (knx_phy_bench_id_t id);
+
+/**
+ * @brief Obtener el resultado de la última medida de una primitiva
+ * @param[in]  id    Primitiva
+ * @param[out] stats Destino de la copia
+ *
+ * @returns Nada
+ */
+void knx_phy_bench_get_stats (knx_phy_bench_id_t id, knx_phy_bench_stats_t *stats);
+#endif
+
+#endif /* __KNX_PHY_BENCH_H */
+
+/* @} */
@@ -17,6 +17,8 @@
  * Constantes para el intercambio de información con la TP-UART (órdenes)
  */
 #define KNX_TPUART_COMMAND_U_RESET_REQUEST       0x01   /**< Orden de reset a enviar a la TP-UART                       */
+#define KNX_TPUART_COMMAND_U_STATE_REQUEST       0x02   /**< Orden de consulta del estado (responde con U_State.ind)     */
+#define KNX_TPUART_COMMAND_U_ACTIVATE_BUSMON     0x05   /**< Orden de paso a modo busmonitor (sólo se abandona con reset) */
 #define KNX_TPUART_COMMAND_U_ACKINFO__ADDRESSED  0x11   /**< Orden a la TP-UART para confirmación de ACK (addressed)    */
 #define KNX_TPUART_COMMAND_U_ACKINFO__BUSY       0x12   /**< Orden a la TP-UART para confirmación de ACK (ocupado)      */
 #define KNX_TPUART_COMMAND_U_ACKINFO__NACK       0x14   /**< Orden a la TP-UART para confirmación de ACK (negative ack) */
@@ -35,6 +37,12 @@
                                                              Los 5 bits de mayor peso indican el estado; por orden de MAS a MENOS peso:
                                                              SC - Slave collision, RE - Receive error, TE - Transmitter error, 
                                                              PE - Protocol error, TW - Temperature Warning */
+#define KNX_TPUART_U_STATE_INDICATION_MASK       0x07   /**< Máscara de los 3 bits fijos de U_State.ind                    */
+#define KNX_TPUART_U_STATE_SC                    0x80   /**< U_State.ind: Slave collision                                 */
+#define KNX_TPUART_U_STATE_RE                    0x40   /**< U_State.ind: Receive error (checksum, paridad o bit erróneo)  */
+#define KNX_TPUART_U_STATE_TE                    0x20   /**< U_State.ind: Transmitter error (bit enviado no leído del bus) */
+#define KNX_TPUART_U_STATE_PE                    0x10   /**< U_State.ind: Protocol error (orden no válida del host)        */
+#define KNX_TPUART_U_STATE_TW                    0x08   /**< U_State.ind: Temperature warning                              */
 #define KNX_TPUART_L_DATA_CONFIRMATION_POS       0x8B   /**< Señalización L_Data.confirmation (positiva, trama reconocida)    */
 #define KNX_TPUART_L_DATA_CONFIRMATION_NEG       0x0B   /**< Señalización L_Data.confirmation (negativa, trama no reconocida) */
 
@@ -47,10 +55,10 @@
  */
 #define KNX_DATA_FRAME_CTRL_FT_MASK      0x80  /**< Máscara del campo FT (Frame Type)    */
 #define KNX_DATA_FRAME_CTRL_FT_SHIFT        7  /**< Desplazamiento del campo FT          */
-#define KNX_DATA_FRAME_CTRL_FT__0        0x00  /**< Valor de FT = 0 (trama estándar)     */
-#define KNX_DATA_FRAME_CTRL_FT__1        0x80  /**< Valor de FT = 1 (trama extendida)    */
-#define KNX_DATA_FRAME_CTRL_FT__STANDARD 0x00  /**< Valor de FT para trama estándar (0)  */
-#define KNX_DATA_FRAME_CTRL_FT__EXTENDED 0x80  /**< Valor de FT para trama extendida (1) */
+#define KNX_DATA_FRAME_CTRL_FT__0        0x00  /**< Valor de FT = 0 (trama extendida)    */
+#define KNX_DATA_FRAME_CTRL_FT__1        0x80  /**< Valor de FT = 1 (trama estándar)     */
+#define KNX_DATA_FRAME_CTRL_FT__STANDARD 0x80  /**< Valor de FT para trama estándar (1)  */
+#define KNX_DATA_FRAME_CTRL_FT__EXTENDED 0x00  /**< Valor de FT para trama extendida (0) */
 
 /*
  * Campo REP (Repeated frame)
@@ -150,8 +158,8 @@
 /*
  * Campo EXT FRAME FMT (Extended Frame Format)
  */
-#define KNX_EXT_FRAME_CTRLE_HOP_MASK     0x0F  /**< Máscara del campo EXT FRAME FMT (Extended Frame Format) en CTRLE (trama extendida) */
-#define KNX_EXT_FRAME_CTRLE_HOP_SHIFT       0  /**< Desplazamiento del campo EXT FRAME FMT en CTRLE (trama extendida)                  */
+#define KNX_EXT_FRAME_CTRLE_EFF_MASK     0x0F  /**< Máscara del campo EXT FRAME FMT (Extended Frame Format) en CTRLE (trama extendida) */
+#define KNX_EXT_FRAME_CTRLE_EFF_SHIFT       0  /**< Desplazamiento del campo EXT FRAME FMT en CTRLE (trama extendida)                  */
 
 
 /* @} */
@@ -0,0 +1,162 @@
+/**
+ * @file knx_pool.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Pilas de bloques de tamaño fijo para los descriptores de trama
+ *
+ * Cada pila reparte bloques de un único tamaño sacados de un array estático
+ * (ver @ref KNX_POOL_STORAGE). Reservar y liberar cuestan O(1) y no usan
+ * secciones críticas: la lista de bloques libres es una pila de Treiber
+ * actualizada con LDREX/STREX, por lo que pueden usarse indistintamente desde
+ * tareas y desde ISR. En el Cortex-M toda entrada o salida de excepción anula
+ * la reserva exclusiva, de modo que la pila no sufre el problema ABA.
+ *
+ * Cada pila lleva la cuenta de los bloques en uso, su máximo histórico
+ * (high-water mark) y las peticiones rechazadas por estar agotada, para poder
+ * dimensionarla según la carga real del bus.
+ *
+ * Los niveles físico y de enlace tienen cada uno una pila para tramas estándar
+ * (hasta KNX_POOL_STD_FRAME_LEN octetos) y otra para tramas extendidas
+ * (hasta KNX_POOL_EXT_FRAME_LEN octetos).
+ *
+ * @{
+ */
+#ifndef __KNX_POOL_H
+#define __KNX_POOL_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Octetos de una trama estándar (LG = 15) y de una extendida (LG = 254) */
+#define KNX_POOL_STD_FRAME_LEN      23
+#define KNX_POOL_EXT_FRAME_LEN      263
+
+/* Número máximo de pilas (ver @ref knx_pool_get) */
+#define KNX_POOL_MAX_POOLS          8
+
+/* Alineamiento de los bloques en bytes */
+#define KNX_POOL_ALIGN              8
+
+/* Tamaño de bloque efectivo (redondeado a KNX_POOL_ALIGN) */
+#define KNX_POOL_BLOCK_SIZE(size)   ((((size) + KNX_POOL_ALIGN - 1) / KNX_POOL_ALIGN) * KNX_POOL_ALIGN)
+
+/**
+ * @brief Declarar el almacenamiento de una pila
+ * @param name  Nombre del array
+ * @param size  Tamaño de cada bloque en bytes
+ * @param count Número de bloques
+ */
+#define KNX_POOL_STORAGE(name, size, count) \
+    static uint64_t name[((count) * KNX_POOL_BLOCK_SIZE(size)) / sizeof(uint64_t)]
+
+/* ----------------------- Tipos de datos públicos ------------------------- */
+
+/**
+ * Tipo estructurado con una pila de bloques de tamaño fijo.
+ * Sus campos sólo deben accederse a través de las funciones de este módulo
+ */
+struct knx_pool_s {
+    volatile uint32_t free;     /**< Índice + 1 del primer bloque libre (0 = agotada)       */
+    volatile uint32_t used;     /**< Bloques en uso                                         */
+    volatile uint32_t hwm;      /**< Máximo histórico de bloques en uso                     */
+    volatile uint32_t failures; /**< Peticiones rechazadas por estar agotada                */
+    uint8_t *storage;           /**< Bloques                                                */
+    uint32_t block_size;        /**< Tamaño de cada bloque (múltiplo de KNX_POOL_ALIGN)     */
+    uint32_t count;             /**< Número de bloques                                      */
+    const char *name;           /**< Nombre para los informes                               */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_pool_s knx_pool_t;
+
+/**
+ * Tipo estructurado con una copia de los contadores de una pila
+ */
+struct knx_pool_stats_s {
+    const char *name;           /**< Nombre de la pila          */
+    uint32_t block_size;        /**< Tamaño de cada bloque      */
+    uint32_t count;             /**< Número de bloques          */
+    uint32_t used;              /**< Bloques en uso             */
+    uint32_t hwm;               /**< Máximo histórico en uso    */
+    uint32_t failures;          /**< Peticiones rechazadas      */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_pool_stats_s knx_pool_stats_t;
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+/**
+ * @brief Inicializar una pila con todos sus bloques libres
+ * @param[out] pool    Pila a inicializar
+ * @param[in]  name    Nombre para los informes
+ * @param[in]  storage Almacenamiento declarado con @ref KNX_POOL_STORAGE
+ * @param[in]  size    Tamaño de cada bloque en bytes (el mismo que en KNX_POOL_STORAGE)
+ * @param[in]  count   Número de bloques (el mismo que en KNX_POOL_STORAGE)
+ *
+ * La primera vez que se inicializa, la pila se registra para @ref knx_pool_get.
+ * No debe llamarse con bloques de la pila en uso.
+ *
+ * @returns Nada
+ */
+void knx_pool_init (knx_pool_t *pool, const char *name, void *storage, uint32_t size, uint32_t count);
+
+/**
+ * @brief Reservar un bloque (desde tarea o ISR)
+ * @param[in] pool Pila
+ *
+ * @returns Bloque reservado, o NULL si la pila está agotada
+ */
+void *knx_pool_alloc (knx_pool_t *pool);
+
+/**
+ * @brief Liberar un bloque (desde tarea o ISR)
+ * @param[in] pool  Pila de la que se reservó
+ * @param[in] block Bloque a liberar (NULL no hace nada)
+ *
+ * @returns Nada
+ */
+void knx_pool_free (knx_pool_t *pool, void *block);
+
+/**
+ * @brief Comprobar si un bloque pertenece a una pila
+ * @param[in] pool  Pila
+ * @param[in] block Bloque
+ *
+ * @returns 1 si block es uno de los bloques de pool, 0 en otro caso
+ */
+uint32_t knx_pool_owns (const knx_pool_t *pool, const void *block);
+
+/**
+ * @brief Obtener una copia de los contadores de una pila
+ * @param[in]  pool  Pila
+ * @param[out] stats Destino de la copia
+ *
+ * @returns Nada
+ */
+void knx_pool_get_stats (const knx_pool_t *pool, knx_pool_stats_t *stats);
+
+/**
+ * @brief Poner a cero el máximo histórico y las peticiones rechazadas de una pila
+ * @param[in] pool Pila
+ *
+ * @returns Nada
+ */
+void knx_pool_reset_stats (knx_pool_t *pool);
+
+/**
+ * @brief Obtener una de las pilas registradas
+ * @param[in] index Índice (0 .. número de pilas - 1)
+ *
+ * @returns Pila, o NULL si index no corresponde a ninguna
+ */
+knx_pool_t *knx_pool_get (uint32_t index);
+
+#endif /* __KNX_POOL_H */
+
+/* @} */
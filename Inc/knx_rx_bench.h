@@ -0,0 +1,100 @@
+/**
+ * @file knx_rx_bench.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Medida de la carga de la recepción KNX con tráfico sintético
+ *
+ * Genera una mezcla cíclica de tramas estándar y extendidas, dirigidas a
+ * direcciones de grupo e individuales (unas para este sistema y otras no), y
+ * las inyecta con knx_phy_rx_replay() al ritmo que tendrían en el bus TP1
+ * (9600 bit/s) para varias cargas hasta la saturación de la línea. Tras cada
+ * carga envía a través de debug_repo una línea con el formato
+ *
+ * <tt>[rxbench] load=.. mode=.. frames=.. ind=.. cyc_frame=.. cyc_octet_max=..
+ * ind_hwm=.. std_hwm=.. ext_hwm=.. drop_frames=.. drop_octets=.. busy=.. nack=.. missed=..</tt>
+ * - load: carga en % del tiempo de la línea
+ * - mode: frame u octet (ver KNX_PHY_DATA_IND_PER_OCTET en knx_phy.h)
+ * - frames, ind: tramas completas procesadas y señalizadas por Ph_Data.ind
+ * - cyc_frame, cyc_octet_max: ciclos de CPU medios por trama y máximo por octeto
+ * - ind_hwm: máxima ocupación de knx_phy_data_ind
+ * - std_hwm, ext_hwm: máxima ocupación de las pilas de descriptores de recepción
+ * - drop_frames, drop_octets: tramas dirigidas y octetos perdidos
+ * - busy, nack, missed: reconocimientos BUSY, NACK y no enviados
+ *
+ * Cada trama se inyecta de una vez, con el planificador suspendido y la
+ * interrupción de la UART de la TP-UART deshabilitada, de modo que, igual que
+ * en la ISR, las tareas que despierta no se ejecutan hasta terminar la trama.
+ * Entre tramas las tareas consumidoras (knxRxTask) vacían las colas como con
+ * tráfico real. Debe ejecutarse con el nivel de enlace en estado normal y con
+ * el bus sin tráfico, ya que los octetos que llegasen de la TP-UART durante la
+ * inyección de una trama se mezclarían con ella.
+ *
+ * Además, @ref knx_rx_bench_check_chk comprueba la detección de tramas
+ * corruptas: inyecta tramas estándar y extendidas dirigidas a este sistema con
+ * un bit cambiado en la cabecera, en la LSDU o en CHK (y sin cambiar, como
+ * referencia) y verifica lo que entrega Ph_Data.ind en el modo configurado
+ * (campo chk del descriptor, o clase del último octeto en el modo octeto a
+ * octeto) y el contador chk_errors de la recepción. Envía una línea por caso
+ *
+ * <tt>[rxchk] ft=.. flip=.. mode=.. got=.. want=.. chk_errors=.. PASS|FAIL</tt>
+ *
+ * y una final <tt>[rxchk] cases=.. fail=..</tt>.
+ *
+ * Necesita KNX_PHY_RX_STATS. Si no se define la macro KNX_RX_BENCH el módulo
+ * queda vacío.
+ *
+ * @{
+ */
+#ifndef __KNX_RX_BENCH_H
+#define __KNX_RX_BENCH_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+#include "cmsis_os.h"   // Para osMessageQId
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Para compilar la medida (y lanzarla al arrancar, ver StartAppTask en freertos.c)
+   basta con eliminar la marca de comentario de la definición de la macro */
+//#define KNX_RX_BENCH
+
+/* Número de tramas inyectadas en cada carga (múltiplo de las 8 de la mezcla).
+   Con 160 la medida completa dura unos 55 s */
+#define KNX_RX_BENCH_FRAMES         160
+
+/* Dirección de grupo que se añade a la tabla para generar tráfico dirigido */
+#define KNX_RX_BENCH_GRP_ADDRESS    0x0A01
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+#ifdef KNX_RX_BENCH
+/**
+ * @brief Inyectar tráfico sintético con cargas crecientes y enviar el resultado
+ * @param[in] frames Número de tramas inyectadas en cada carga
+ *
+ * Debe llamarse desde una tarea de menor prioridad que knxRxTask, una vez
+ * que el nivel de enlace ha recibido la confirmación del reset. Las
+ * estadísticas de la recepción y de las pilas de descriptores se ponen a cero
+ * al empezar cada carga.
+ *
+ * @returns Nada
+ */
+void knx_rx_bench_run (uint32_t frames);
+
+/**
+ * @brief Comprobar la detección de tramas con checksum incorrecto
+ * @param[in] queue Cola a la que knxRxTask reenvía lo que entrega Ph_Data.ind
+ *
+ * Mismas condiciones que @ref knx_rx_bench_run. Además, nadie más debe leer
+ * de queue mientras dura la comprobación. Las tramas recibidas se devuelven
+ * a su pila.
+ *
+ * @returns Número de casos que fallan (0 si todos son correctos)
+ */
+uint32_t knx_rx_bench_check_chk (osMessageQId queue);
+#endif
+
+#endif /* __KNX_RX_BENCH_H */
+
+/* @} */
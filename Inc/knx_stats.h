@@ -0,0 +1,158 @@
+/**
+ * @file knx_stats.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Contadores de los niveles físico y de enlace KNX
+ *
+ * Los contadores se agrupan en bloques con un único escritor cada uno:
+ * - rx: la ISR de la UART conectada a la TP-UART (recepción, errores de la
+ *   UART, confirmaciones y reconocimientos enviados)
+ * - tx: el planificador de transmisión del nivel de enlace, que sólo los
+ *   actualiza dentro de su sección crítica
+ *
+ * Cada bloque lleva un contador de secuencia (seqlock): el escritor lo hace
+ * impar antes de tocar los contadores y par al terminar, y el lector repite
+ * la copia si la secuencia era impar o ha cambiado entre medias. Así
+ * @ref knx_stats_read obtiene una instantánea coherente de cada bloque sin
+ * deshabilitar interrupciones y sin retrasar nunca al escritor.
+ *
+ * Los contadores sólo crecen (módulo 2^32): para medir tasas se restan dos
+ * instantáneas.
+ *
+ * @{
+ */
+#ifndef __KNX_STATS_H
+#define __KNX_STATS_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Número de prioridades KNX (igual a KNX_LINK_PRIORITIES) */
+#define KNX_STATS_PRIORITIES        4
+
+/**
+ * @brief Incrementar un contador del bloque rx (sólo desde la ISR de la UART)
+ * @param field Campo de knx_stats_rx_t (p.ej. chk_errors o frames[prio])
+ */
+#define KNX_STATS_RX_INC(field)     do { knx_stats_rx_begin()->field++; knx_stats_rx_end(); } while (0)
+
+/**
+ * @brief Incrementar un contador del bloque tx (sólo dentro de la sección crítica de transmisión)
+ * @param field Campo de knx_stats_tx_t
+ */
+#define KNX_STATS_TX_INC(field)     do { knx_stats_tx_begin()->field++; knx_stats_tx_end(); } while (0)
+
+/* ----------------------- Tipos de datos públicos ------------------------- */
+
+/**
+ * Tipo estructurado con los contadores que actualiza la ISR de la UART
+ */
+struct knx_stats_rx_s {
+    uint32_t frames[KNX_STATS_PRIORITIES]; /**< Tramas de datos completas vistas en el bus, por prioridad */
+    uint32_t acks;              /**< U_AckInformation ADDRESSED enviados (ACK)              */
+    uint32_t nacks;             /**< U_AckInformation con NACK enviados                     */
+    uint32_t busys;             /**< U_AckInformation con BUSY enviados                     */
+    uint32_t chk_errors;        /**< Tramas de datos con checksum incorrecto                */
+    uint32_t parity_errors;     /**< Errores de paridad de la UART                          */
+    uint32_t framing_errors;    /**< Errores de trama (stop bit) de la UART                 */
+    uint32_t noise_errors;      /**< Errores de ruido de la UART                            */
+    uint32_t overrun_errors;    /**< Desbordamientos de la UART                             */
+    uint32_t con_pos;           /**< L_Data.con positivos de la TP-UART                     */
+    uint32_t con_neg;           /**< L_Data.con negativos de la TP-UART                     */
+    uint32_t state_inds;        /**< U_State.ind de la TP-UART                              */
+    uint32_t state_sc;          /**< U_State.ind con SC (slave collision)                   */
+    uint32_t state_re;          /**< U_State.ind con RE (receive error)                     */
+    uint32_t state_te;          /**< U_State.ind con TE (transmitter error)                 */
+    uint32_t state_pe;          /**< U_State.ind con PE (protocol error)                    */
+    uint32_t state_tw;          /**< U_State.ind con TW (temperature warning)               */
+    uint32_t duplicates;        /**< Repeticiones de tramas ya entregadas descartadas       */
+    uint32_t ind_overflows;     /**< Tramas perdidas por estar llena knx_phy_data_ind       */
+    uint32_t con_overflows;     /**< Confirmaciones perdidas por estar llena knx_phy_data_con */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_stats_rx_s knx_stats_rx_t;
+
+/**
+ * Tipo estructurado con los contadores que actualiza el planificador de transmisión
+ */
+struct knx_stats_tx_s {
+    uint32_t frames[KNX_STATS_PRIORITIES]; /**< Tramas entregadas a la TP-UART, por prioridad */
+    uint32_t queue_overflows;   /**< L_Data.req rechazados por estar llena su cola          */
+    uint32_t con_timeouts;      /**< Tramas sin L_Data.con en KNX_LINK_TX_CON_TIMEOUT_MS    */
+    uint32_t throttled;         /**< Entregas retrasadas por el aviso de temperatura (TW)   */
+    uint32_t health_resets;     /**< Resets de la TP-UART por errores repetidos (PE / TE)   */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_stats_tx_s knx_stats_tx_t;
+
+/**
+ * Tipo estructurado con una instantánea de todos los contadores
+ */
+struct knx_stats_s {
+    knx_stats_rx_t rx;          /**< Recepción y TP-UART        */
+    knx_stats_tx_t tx;          /**< Transmisión                */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_stats_s knx_stats_t;
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+/**
+ * @brief Empezar a actualizar el bloque rx
+ *
+ * Sólo puede llamarse desde la ISR de la UART conectada a la TP-UART (o desde
+ * knx_phy_rx_replay, que no debe coincidir con la recepción real), y siempre
+ * seguida de @ref knx_stats_rx_end
+ *
+ * @returns Contadores del bloque rx
+ */
+knx_stats_rx_t *knx_stats_rx_begin (void);
+
+/**
+ * @brief Terminar de actualizar el bloque rx
+ *
+ * @returns Nada
+ */
+void knx_stats_rx_end (void);
+
+/**
+ * @brief Empezar a actualizar el bloque tx
+ *
+ * Sólo puede llamarse dentro de la sección crítica del planificador de
+ * transmisión, y siempre seguida de @ref knx_stats_tx_end
+ *
+ * @returns Contadores del bloque tx
+ */
+knx_stats_tx_t *knx_stats_tx_begin (void);
+
+/**
+ * @brief Terminar de actualizar el bloque tx
+ *
+ * @returns Nada
+ */
+void knx_stats_tx_end (void);
+
+/**
+ * @brief Obtener una instantánea coherente de los contadores
+ * @param[out] stats Destino de la copia
+ *
+ * No deshabilita interrupciones: repite la copia de un bloque si su escritor
+ * lo ha modificado mientras tanto. Sólo debe llamarse desde tareas (desde una
+ * ISR que interrumpiera al escritor no terminaría nunca).
+ *
+ * @returns Nada
+ */
+void knx_stats_read (knx_stats_t *stats);
+
+#endif /* __KNX_STATS_H */
+
+/* @} */
@@ -49,6 +49,8 @@
 
 void SysTick_Handler(void);
 void EXTI0_IRQHandler(void);
+void DMA1_Stream3_IRQHandler(void);
+void DMA1_Stream6_IRQHandler(void);
 void USART2_IRQHandler(void);
 void USART3_IRQHandler(void);
 void OTG_FS_IRQHandler(void);
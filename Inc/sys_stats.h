@@ -0,0 +1,67 @@
+/**
+ * @file sys_stats.h
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Informe periódico del uso de CPU, pila y memoria dinámica
+ *
+ * @ref sys_stats_report envía a través de debug_repo una instantánea del
+ * sistema con una línea de texto por elemento, pensada para ser procesada
+ * automáticamente (una palabra clave y pares clave=valor separados por
+ * espacios):
+ *
+ * <tt>[sysstats] BEGIN t=.. dt=.. tasks=..</tt>
+ * - t: instante del informe (ms desde el arranque)
+ * - dt: duración del intervalo medido en cuentas del contador de run-time
+ *   stats (ver configureTimerForRunTimeStats en freertos.c)
+ * - tasks: número de tareas
+ *
+ * <tt>[sysstats] TASK NOMBRE prio=.. state=.. cpu=NN.NN hwm=..</tt>
+ * - prio: prioridad actual de FreeRTOS
+ * - state: R (en ejecución o lista), B (bloqueada), S (suspendida), D (borrada)
+ * - cpu: porcentaje de CPU usado durante el intervalo, con dos decimales
+ * - hwm: mínimo histórico de pila libre (uxTaskGetStackHighWaterMark) en palabras
+ *
+ * <tt>[sysstats] HEAP size=.. free=.. min=..</tt>
+ * - tamaño, bytes libres y mínimo histórico de bytes libres de la memoria de FreeRTOS
+ *
+ * <tt>[sysstats] POOL NOMBRE count=.. used=.. hwm=.. fail=..</tt>
+ * - contadores de cada pila de bloques registrada (ver knx_pool.h)
+ *
+ * <tt>[sysstats] END</tt>
+ *
+ * El porcentaje de CPU se calcula sobre el intervalo transcurrido desde el
+ * informe anterior (el primero, desde el arranque), no sobre toda la vida
+ * del sistema, para que las tendencias reflejen la carga actual.
+ *
+ * @{
+ */
+#ifndef __SYS_STATS_H
+#define __SYS_STATS_H
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+#include <stdint.h>     // Para los tipos uintXX_t
+
+/* --------------------------- Macros públicas ----------------------------- */
+
+/* Periodo del informe en ms (ver StartSysStatsTask en freertos.c) */
+#define SYS_STATS_PERIOD_MS         5000
+
+/* Número máximo de tareas del informe (si hay más se envía una línea ERROR) */
+#define SYS_STATS_MAX_TASKS         12
+
+/* ----------------- Declaración de funciones públicas --------------------- */
+
+/**
+ * @brief Enviar el informe del sistema a través de debug_repo
+ *
+ * Sólo puede llamarse desde una única tarea, ya que guarda los contadores de
+ * ejecución del informe anterior para calcular el uso de CPU del intervalo.
+ *
+ * @returns Nada
+ */
+void sys_stats_report (void);
+
+#endif /* __SYS_STATS_H */
+
+/* @} */
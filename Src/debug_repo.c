@@ -8,6 +8,7 @@
 
 #include <string.h>
 #include <LowLevelIOInterface.h>
+#include "task.h"
 #include "helpers.h"
 #include "debug_repo.h"
 
@@ -31,31 +32,79 @@
 
 #define DEBUGREPO_HANDLERS_NUMLEVELS         ((1<<__NVIC_PRIO_BITS) + 2)
 
-struct s_debugrepo {
-	/* Indices de lectura/escritura         */
-	uint32_t head, tail;
-	/* Estadísticas */
+#ifdef DEBUGREPO_USE_DMA
+  #define DEBUGREPO_UART_TRANSMIT(buf, len)  HAL_UART_Transmit_DMA(&DEBUGREPO_UART_HANDLE, (uint8_t *)(buf), (len))
+#else
+  #define DEBUGREPO_UART_TRANSMIT(buf, len)  HAL_UART_Transmit_IT(&DEBUGREPO_UART_HANDLE, (uint8_t *)(buf), (len))
+#endif
+
+/* Señal (notificación de tarea) con la que se avisa a la tarea de extracción */
+#define DEBUGREPO_SIGNAL_PENDING             ((int32_t)0x01)
+
+#define DEBUGREPO_SIZE_MASK                  (DEBUGREPO_SIZE - 1)
+#define DEBUGREPO_HANDLERS_SIZE_MASK         (DEBUGREPO_HANDLERS_SIZE - 1)
+#if ((DEBUGREPO_SIZE & DEBUGREPO_SIZE_MASK) != 0) || ((DEBUGREPO_HANDLERS_SIZE & DEBUGREPO_HANDLERS_SIZE_MASK) != 0)
+#error "DEBUGREPO_SIZE y DEBUGREPO_HANDLERS_SIZE deben ser potencias de 2"
+#endif
+#if ((DEBUGREPO_RECORDS & (DEBUGREPO_RECORDS - 1)) != 0) || ((DEBUGREPO_HANDLERS_RECORDS & (DEBUGREPO_HANDLERS_RECORDS - 1)) != 0)
+#error "DEBUGREPO_RECORDS y DEBUGREPO_HANDLERS_RECORDS deben ser potencias de 2"
+#endif
+
+/* Cabecera de cada registro (mensaje) almacenado: longitud en bytes y tipo */
+#define DEBUGREPO_REC_LEN_MASK               ((uint16_t)0x0FFF)
+#define DEBUGREPO_REC_TYPE_SHIFT             12
+#define DEBUGREPO_REC_TEXT                   ((uint16_t)0)  /* Texto, se envía tal cual               */
+#define DEBUGREPO_REC_BIN                    ((uint16_t)1)  /* Binario, se envía en hexadecimal       */
+#define DEBUGREPO_REC_TRACE                  ((uint16_t)2)  /* Traza, se envía en binario con su trama */
+#define DEBUGREPO_REC_HEADER(type, len)      ((uint16_t)(((type) << DEBUGREPO_REC_TYPE_SHIFT) | ((len) & DEBUGREPO_REC_LEN_MASK)))
+#define DEBUGREPO_REC_TYPE(header)           ((uint16_t)((header) >> DEBUGREPO_REC_TYPE_SHIFT))
+#define DEBUGREPO_REC_LEN(header)            ((uint16_t)((header) & DEBUGREPO_REC_LEN_MASK))
+
+/* Cola circular con un único productor y un único consumidor (la tarea _debugrepoTask).
+   head y rec_head sólo los modifica el productor y tail y rec_tail sólo el consumidor,
+   por lo que no hace falta exclusión mutua. Los índices avanzan sin límite y se reducen
+   con la máscara correspondiente al acceder; el número de bytes almacenados es siempre
+   head - tail y el de registros rec_head - rec_tail.
+   Los datos de los registros se almacenan seguidos en buffer y sus cabeceras en records,
+   de modo que localizar un registro no exige recorrer sus datos */
+struct s_debugrepo_ring {
+	/* Indices de escritura (productor) y lectura (consumidor) */
+	volatile uint32_t head, tail;
+	/* Tamaño del buffer menos uno (el tamaño es potencia de 2) */
+	uint32_t mask;
+	/* Indices de escritura y lectura de las cabeceras de registro */
+	volatile uint32_t rec_head, rec_tail;
+	/* Número de cabeceras menos uno (el número es potencia de 2) */
+	uint32_t rec_mask;
+	/* Estadísticas (total_items e insert_errors sólo las modifica el productor) */
 	t_debugrepo_stats stats;
 	/* Buffer de almacenamiento             */
-	uint8_t  buffer[DEBUGREPO_SIZE];
+	uint8_t  *buffer;
+	/* Cabeceras de registro (DEBUGREPO_REC_HEADER) */
+	uint16_t *records;
+};
+typedef struct s_debugrepo_ring t_debugrepo_ring;
+
+struct s_debugrepo {
+	/* Una cola por tarea productora; la última es compartida por las tareas
+	   que no tienen cola propia (y por el código previo al arranque del kernel) */
+	t_debugrepo_ring rings[DEBUGREPO_TASKS_NUMSLOTS];
+	/* Tarea propietaria de cada cola (0 = libre) */
+	osThreadId owners[DEBUGREPO_TASKS_NUMSLOTS - 1];
+	/* Siguiente cola a consultar por el consumidor (reparto equitativo) */
+	uint32_t next;
     /* Semáforo de sincronización con USART (HAL driver) */
 	osSemaphoreId sem;
-    /* Mutex de acceso en exclusión mutua   */
+    /* Mutex de acceso en exclusión mutua a la cola compartida */
     osMutexId mutex;
 	/* Task handle de la tarea que extrae los mensajes y los envía a través de la USART */
 	osThreadId task;
 };
 typedef struct s_debugrepo t_debugrepo;
 
-struct s_debugrepo_handler {
-	/* Indices de lectura/escritura         */
-	uint32_t head, tail;
-	/* Estadísticas */
-	t_debugrepo_stats stats;
-	/* Buffer de almacenamiento             */
-	uint8_t  buffer[DEBUGREPO_HANDLERS_SIZE];
-};
-typedef struct s_debugrepo_handler t_debugrepo_handler;
+/* Cola de cada nivel de prioridad de interrupción: las ISR de un mismo nivel
+   no se interrumpen entre sí, por lo que hay un único productor activo */
+typedef t_debugrepo_ring t_debugrepo_handler;
 
 //*****************************************************************************
 // Parte privada
@@ -80,7 +129,17 @@ static void _write_threaded_write(t_write_threaded *wth, const unsigned char * b
 
 static t_debugrepo _repo;
 static t_debugrepo_handler _repo_handlers[DEBUGREPO_HANDLERS_NUMLEVELS];
-static char _msg2send[DEBUGREPO_MSG_MAXLEN];
+static uint8_t _repo_buffers[DEBUGREPO_TASKS_NUMSLOTS][DEBUGREPO_SIZE];
+static uint8_t _repo_handlers_buffers[DEBUGREPO_HANDLERS_NUMLEVELS][DEBUGREPO_HANDLERS_SIZE];
+static uint16_t _repo_records[DEBUGREPO_TASKS_NUMSLOTS][DEBUGREPO_RECORDS];
+static uint16_t _repo_handlers_records[DEBUGREPO_HANDLERS_NUMLEVELS][DEBUGREPO_HANDLERS_RECORDS];
+static char _binraw[DEBUGREPO_MSG_MAXLEN];
+#ifdef DEBUGREPO_USE_DMA
+/* Registros en envío por DMA directamente desde una cola; se liberan en debugrepoUARTCallback */
+static t_debugrepo_ring * volatile _dma_ring;
+static uint32_t _dma_bytes, _dma_records;
+#endif
+static char _msg2send[DEBUGREPO_MSG_MAXLEN + 1];
 
 #ifdef DEBUGREPO_USE_DELAY
 static void _short_delay(void);
@@ -92,14 +151,22 @@ static int _getHandlerPrioLevel (void);
 static void _debugrepoGetStats (t_debugrepo_stats *stats);
 static void _debugrepoGetHandlerStats (uint32_t prio_level, t_debugrepo_stats *stats);
 static void _debugrepoInitStats (t_debugrepo_stats *stats);
-static int _debugrepoInsertChar_nomutex (uint8_t dato);
-static int _debugrepoExtractChar_nomutex (uint8_t *dato);
-static int _debugrepoHandlerInsertChar (uint32_t prio_level, uint8_t dato);
-static int _debugrepoHandlerExtractChar (uint32_t prio_level, uint8_t *dato);
-static int _debugrepoInsertHandlerMsgBlocking(const char *msg, uint16_t len);
-static int _debugrepoInsertHandlerMsgNonBlocking(uint32_t prio_level, const char *msg, uint16_t len);
-static int _debugrepoInsertMsgLen (const char *msg, uint16_t len);
-static int _debugrepoHandlerExtractMsg (uint32_t prio_level, char msg[], int maxlen);
+static void _debugrepoRingInit (t_debugrepo_ring *ring, uint8_t *buffer, uint32_t size, uint16_t *records, uint32_t num_records);
+static void _debugrepoRingGetStats (t_debugrepo_ring *ring, t_debugrepo_stats *stats);
+static int _debugrepoRingInsert (t_debugrepo_ring *ring, uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len);
+static void _debugrepoRingCopyIn (t_debugrepo_ring *ring, uint32_t pos, const char *data, uint16_t len);
+static int _debugrepoRingExtractMsg (t_debugrepo_ring *ring, char msg[], int maxlen);
+static int _debugrepoRingNextToSend (t_debugrepo_ring *ring, const char **msg);
+#ifdef DEBUGREPO_USE_DMA
+static int _debugrepoRingPeekDirect (t_debugrepo_ring *ring, const char **msg);
+#endif
+static t_debugrepo_ring *_debugrepoGetTaskRing (void);
+static int _debugrepoInsertRecord (uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len);
+static int _debugrepoFormatBin (const char *data, uint16_t len, char msg[], int maxlen);
+static int _debugrepoFrameTrace (char msg[], uint16_t len);
+static int _debugrepoInsertHandlerMsgBlocking(uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len);
+static int _debugrepoInsertHandlerMsgNonBlocking(uint32_t prio_level, uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len);
+static int _debugrepoInsertMsgLen (uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len);
 static void _debugrepoTask(void const * argument);
 //*****************************************************************************
 
@@ -210,116 +277,344 @@ void debugrepoInit (void)
   
   /* Initialize handlers repositories */
   for (i = 0; i < DEBUGREPO_HANDLERS_NUMLEVELS; i++) {
-    _repo_handlers[i].head = _repo_handlers[i].tail = 0;
-    _debugrepoInitStats(&_repo_handlers[i].stats);
+    _debugrepoRingInit(&_repo_handlers[i], _repo_handlers_buffers[i], DEBUGREPO_HANDLERS_SIZE,
+                       _repo_handlers_records[i], DEBUGREPO_HANDLERS_RECORDS);
   }
   
-  /* Initialize thread mode / tasks repository */
-  _repo.head = _repo.tail = 0;
-  _debugrepoInitStats(&_repo.stats);
+  /* Initialize thread mode / tasks repositories */
+  for (i = 0; i < DEBUGREPO_TASKS_NUMSLOTS; i++) {
+    _debugrepoRingInit(&_repo.rings[i], _repo_buffers[i], DEBUGREPO_SIZE,
+                       _repo_records[i], DEBUGREPO_RECORDS);
+  }
+  for (i = 0; i < DEBUGREPO_TASKS_NUMSLOTS - 1; i++) {
+    _repo.owners[i] = 0;
+  }
+  _repo.next = 0;
   osSemaphoreDef(_debugreposem);
   _repo.sem = osSemaphoreCreate(osSemaphore(_debugreposem), 1);
   osMutexDef(_debugrepomutex);
   _repo.mutex = osMutexCreate(osMutex(_debugrepomutex));
-  osThreadDef(_debugrepotask, _debugrepoTask, osPriorityNormal, 0, 128);
+  osThreadDef(_debugrepotask, _debugrepoTask, DEBUGREPO_TASK_PRIORITY, 0, DEBUGREPO_TASK_STACK_SIZE);
   _repo.task = osThreadCreate(osThread(_debugrepotask), NULL);
 }
 
 
 
 
+static void _debugrepoRingInit (t_debugrepo_ring *ring, uint8_t *buffer, uint32_t size, uint16_t *records, uint32_t num_records)
+{
+    ring->head = ring->tail = 0;
+    ring->mask = size - 1;
+    ring->buffer = buffer;
+    ring->rec_head = ring->rec_tail = 0;
+    ring->rec_mask = num_records - 1;
+    ring->records = records;
+    _debugrepoInitStats(&ring->stats);
+}
+
+//*****************************************************************************
+//
+// Copiar len bytes en el buffer de una cola a partir de la posición pos
+// (reducida con la máscara), dando la vuelta al final del buffer si hace falta
+//
+//*****************************************************************************
+static void _debugrepoRingCopyIn (t_debugrepo_ring *ring, uint32_t pos, const char *data, uint16_t len)
+{
+    uint32_t first;
+
+    if (len == 0) {
+        return;
+    }
+    pos &= ring->mask;
+    first = ring->mask + 1 - pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&ring->buffer[pos], data, first);
+    memcpy(ring->buffer, &data[first], len - first);
+}
+
 //*****************************************************************************
 //
-// Insertar un caracter sin esperar a tener el mutex (asume que ya lo tenemos)
+// Insertar un registro completo en una cola (sólo desde su productor)
 //
-// En caso de que la tail esté llena no se entail el dato y se incrementan
-// las estadísticas de errores de inserción.
+// El registro está formado por un prefijo (pre_len bytes, puede ser 0) y un
+// mensaje, que se escriben directamente en el buffer con (como mucho) dos
+// memcpy cada uno, antes y después de su final. Se añade la cabecera del
+// registro, y sólo después se publica al consumidor actualizando rec_head.
+// En caso de que no haya hueco para todo el registro no se inserta nada y se
+// incrementan las estadísticas de errores de inserción.
 // En caso de éxito se incrementan las estadísticas de total de datos insertados.
 //
-// Retorna 0 si error (tail llena), 1 si la operación termina con éxito
+// Retorna 0 si error (cola llena o registro demasiado largo), 1 si la operación termina con éxito
 //*****************************************************************************
-static int _debugrepoInsertChar_nomutex (uint8_t dato)
+static int _debugrepoRingInsert (t_debugrepo_ring *ring, uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len)
 {
-    if (DEBUGREPO_SIZE <= _repo.stats.items) {
-        _repo.stats.insert_errors++;
+    uint32_t head = ring->head;
+    uint32_t rec_head = ring->rec_head;
+    uint32_t total = (uint32_t)pre_len + len;
+
+    if ((total > DEBUGREPO_REC_LEN_MASK) ||
+        ((ring->mask + 1) - (head - ring->tail) < total) ||
+        ((ring->rec_mask + 1) == (rec_head - ring->rec_tail))) {
+        ring->stats.insert_errors++;
         return 0;
     }
+    _debugrepoRingCopyIn(ring, head, pre, pre_len);
+    _debugrepoRingCopyIn(ring, head + pre_len, msg, len);
+    ring->records[rec_head & ring->rec_mask] = DEBUGREPO_REC_HEADER(type, total);
     // Alargar el tiempo necesario para la operación forzará la aparición de conflictos de acceso
     DELAY;
-    _repo.stats.total_items++;
-    DELAY;
-    _repo.stats.items++;
-    DELAY;
-    _repo.buffer[_repo.head] = dato;
-    DELAY;
-    _repo.head = (_repo.head + 1) % DEBUGREPO_SIZE;
-    DELAY;
+    ring->head = head + total;
+    // Datos y cabecera deben estar escritos antes de que el consumidor vea el nuevo registro
+    __DMB();
+    ring->rec_head = rec_head + 1;
+    ring->stats.total_items += total;
     return 1;
 }
 
-static int _debugrepoHandlerInsertChar (uint32_t prio_level, uint8_t dato)
+//*****************************************************************************
+//
+// Extraer un registro completo de una cola (sólo desde el consumidor)
+//
+// La cabecera da directamente la longitud, por lo que el registro se copia
+// con (como mucho) dos memcpy. Los registros binarios se copian primero a
+// _binraw y se formatean en hexadecimal sobre msg; las trazas se copian tras
+// los DEBUGREPO_TRACE_FRAME_LEN bytes de inicio de su trama.
+// Un registro que no cabe en msg se descarta para no bloquear la cola.
+//
+// Retorna lo mismo que debugrepoExtractMsg
+//*****************************************************************************
+static int _debugrepoRingExtractMsg (t_debugrepo_ring *ring, char msg[], int maxlen)
 {
-    if (DEBUGREPO_HANDLERS_SIZE <= _repo_handlers[prio_level].stats.items) {
-        _repo_handlers[prio_level].stats.insert_errors++;
+    uint32_t tail = ring->tail;
+    uint32_t rec_tail = ring->rec_tail;
+    uint32_t pos = tail & ring->mask;
+    uint32_t first;
+    uint16_t header, len, type;
+    char *to;
+    int result;
+
+    if (ring->rec_head == rec_tail) {
         return 0;
     }
-    _repo_handlers[prio_level].stats.total_items++;
-    _repo_handlers[prio_level].stats.items++;
-    _repo_handlers[prio_level].buffer[_repo_handlers[prio_level].head] = dato;
-    _repo_handlers[prio_level].head = (_repo_handlers[prio_level].head + 1) % DEBUGREPO_HANDLERS_SIZE;
-    return 1;
+    // Leer rec_head antes que los datos que publica
+    __DMB();
+    header = ring->records[rec_tail & ring->rec_mask];
+    len = DEBUGREPO_REC_LEN(header);
+    type = DEBUGREPO_REC_TYPE(header);
+
+    // Los textos se copian tal cual, las trazas tras su marca de trama y los
+    // bloques binarios a _binraw para formatearlos después
+    if (type == DEBUGREPO_REC_TEXT) {
+        to = msg;
+        result = (len < maxlen) ? 0 : -1;
+    } else if (type == DEBUGREPO_REC_TRACE) {
+        to = &msg[DEBUGREPO_TRACE_FRAME_LEN];
+        result = ((len + DEBUGREPO_TRACE_FRAME_LEN) < maxlen) ? 0 : -1;
+    } else {
+        to = _binraw;
+        result = 0;
+    }
+    // Si result es -1 el mensaje que se debe extraer no cabe en el array que se
+    // ha pasado como argumento y se descarta
+    if (result == 0) {
+        first = ring->mask + 1 - pos;
+        if (first > len) {
+            first = len;
+        }
+        memcpy(to, &ring->buffer[pos], first);
+        memcpy(&to[first], ring->buffer, len - first);
+        if (type == DEBUGREPO_REC_TEXT) {
+            msg[len] = '\0';
+            result = len;
+        } else if (type == DEBUGREPO_REC_TRACE) {
+            result = _debugrepoFrameTrace(msg, len);
+        } else {
+            result = _debugrepoFormatBin(_binraw, len, msg, maxlen);
+        }
+    }
+
+    // Los datos deben estar leídos antes de devolver el hueco al productor
+    __DMB();
+    ring->tail = tail + len;
+    ring->rec_tail = rec_tail + 1;
+    return result;
 }
 
+#ifdef DEBUGREPO_USE_DMA
 //*****************************************************************************
 //
-// Extraer un caracter sin esperar a tener el mutex (asume que ya lo tenemos)
+// Preparar el envío directo (sin copia) de registros de texto de una cola
 //
-// En caso de que la tail esté vacía no se desentail nada ni se modifica
-// el parámetro dato.
+// Agrupa todos los registros de texto consecutivos cuyos datos están seguidos
+// en el buffer (sin dar la vuelta) en un único bloque. Los registros no se
+// liberan hasta que termina la transmisión (debugrepoUARTCallback).
 //
-// Retorna 0 si error (tail vacía), 1 si la operación termina con éxito
+// Retorna la longitud del bloque (y su inicio en msg), o 0 si el siguiente
+// registro debe extraerse copiándolo (binario o partido en dos segmentos)
 //*****************************************************************************
-static int _debugrepoExtractChar_nomutex (uint8_t *dato)
+static int _debugrepoRingPeekDirect (t_debugrepo_ring *ring, const char **msg)
 {
-    if (0 == _repo.stats.items) {
+    uint32_t rec_tail = ring->rec_tail;
+    uint32_t rec_head = ring->rec_head;
+    uint32_t pos = ring->tail & ring->mask;
+    uint32_t rec, total = 0;
+    uint16_t header;
+
+    // Leer rec_head antes que los datos que publica
+    __DMB();
+    for (rec = rec_tail; rec != rec_head; rec++) {
+        header = ring->records[rec & ring->rec_mask];
+        if ((DEBUGREPO_REC_TYPE(header) != DEBUGREPO_REC_TEXT) ||
+            ((pos + total + DEBUGREPO_REC_LEN(header)) > (ring->mask + 1))) {
+            break;
+        }
+        total += DEBUGREPO_REC_LEN(header);
+    }
+    if (total == 0) {
+        // Liberar directamente los registros vacíos que pudiera haber
+        ring->rec_tail = rec;
         return 0;
     }
-    // Alargar el tiempo necesario para la operación forzará la aparición de conflictos de acceso
-    DELAY;
-    _repo.stats.items--;
-    DELAY;
-    *dato = _repo.buffer[_repo.tail];
-    DELAY;
-    _repo.tail = (_repo.tail + 1) % DEBUGREPO_SIZE;
-    DELAY;
-    return 1;
+    _dma_ring = ring;
+    _dma_bytes = total;
+    _dma_records = rec - rec_tail;
+    *msg = (const char *)&ring->buffer[pos];
+    return (int)total;
 }
+#endif
 
-static int _debugrepoHandlerExtractChar (uint32_t prio_level, uint8_t *dato) {
-    if (0 == _repo_handlers[prio_level].stats.items) {
-        return 0;
+//*****************************************************************************
+//
+// Obtener el siguiente bloque a enviar de una cola (sólo desde el consumidor)
+//
+// Con DEBUGREPO_USE_DMA se envían sin copia los registros de texto consecutivos;
+// en otro caso (o si el siguiente registro no lo permite) se extrae un registro
+// sobre _msg2send.
+//
+// Retorna lo mismo que debugrepoExtractMsg, y en msg el inicio del bloque
+//*****************************************************************************
+static int _debugrepoRingNextToSend (t_debugrepo_ring *ring, const char **msg)
+{
+#ifdef DEBUGREPO_USE_DMA
+    int len = _debugrepoRingPeekDirect(ring, msg);
+    if (len > 0) {
+        return len;
     }
-    _repo_handlers[prio_level].stats.items--;
-    *dato = _repo_handlers[prio_level].buffer[_repo_handlers[prio_level].tail];
-    _repo_handlers[prio_level].tail = (_repo_handlers[prio_level].tail + 1) % DEBUGREPO_HANDLERS_SIZE;
-    return 1;
+#endif
+    *msg = _msg2send;
+    return _debugrepoRingExtractMsg(ring, _msg2send, sizeof(_msg2send));
+}
+
+//*****************************************************************************
+//
+// Formatear un bloque binario como texto: "XX(c) XX XX(c) ...\r\n"
+//
+// Retorna la longitud del texto generado (sin contar el '\0' final)
+//*****************************************************************************
+static int _debugrepoFormatBin (const char *data, uint16_t len, char msg[], int maxlen)
+{
+  unsigned int from_idx, to_idx;
+
+  for (from_idx=0, to_idx=0; (from_idx < len) && (to_idx < maxlen); from_idx++) {
+    if (to_idx+6 < maxlen) {
+      if (from_idx > 0) {
+        msg[to_idx++] = ' ';
+      }
+      msg[to_idx++] = asHex((data[from_idx] >> 4) & 0x0F);
+      msg[to_idx++] = asHex(data[from_idx] & 0x0F);
+      if ((data[from_idx] >= 32) && (data[from_idx] < 127)) {
+        msg[to_idx++] = '(';
+        msg[to_idx++] = data[from_idx];
+        msg[to_idx++] = ')';
+      }
+    }
+  }
+  if ((to_idx + 3) >= maxlen) {
+    to_idx -= 3;
+  }
+  msg[to_idx++] = '\r';
+  msg[to_idx++] = '\n';
+  msg[to_idx] = '\0';
+  return to_idx;
+}
+
+//*****************************************************************************
+//
+// Completar la trama de una traza cuyos len bytes (marca de tiempo, evento y
+// datos) ya están en msg a partir de DEBUGREPO_TRACE_FRAME_LEN:
+// DEBUGREPO_TRACE_SYNC, longitud (16 bits, little-endian) y los datos
+//
+// Retorna la longitud de la trama
+//*****************************************************************************
+static int _debugrepoFrameTrace (char msg[], uint16_t len)
+{
+  msg[0] = DEBUGREPO_TRACE_SYNC;
+  msg[1] = (char)(len & 0xFF);
+  msg[2] = (char)(len >> 8);
+  msg[len + DEBUGREPO_TRACE_FRAME_LEN] = '\0';
+  return len + DEBUGREPO_TRACE_FRAME_LEN;
 }
 
+static void _debugrepoRingGetStats (t_debugrepo_ring *ring, t_debugrepo_stats *stats)
+{
+    stats->items = ring->head - ring->tail;
+    stats->total_items = ring->stats.total_items;
+    stats->insert_errors = ring->stats.insert_errors;
+}
 
 static void _debugrepoGetStats (t_debugrepo_stats *stats)
 {
-    MUTEX_WAIT;
-    stats->items = _repo.stats.items;
-    stats->total_items = _repo.stats.total_items;
-    stats->insert_errors = _repo.stats.insert_errors;
-    MUTEX_RELEASE;
+    t_debugrepo_stats ring_stats;
+    int i;
+
+    _debugrepoInitStats(stats);
+    for (i = 0; i < DEBUGREPO_TASKS_NUMSLOTS; i++) {
+        _debugrepoRingGetStats(&_repo.rings[i], &ring_stats);
+        stats->items += ring_stats.items;
+        stats->total_items += ring_stats.total_items;
+        stats->insert_errors += ring_stats.insert_errors;
+    }
 }
 
 static void _debugrepoGetHandlerStats (uint32_t prio_level, t_debugrepo_stats *stats)
 {
-    stats->items = _repo_handlers[prio_level].stats.items;
-    stats->total_items = _repo_handlers[prio_level].stats.total_items;
-    stats->insert_errors = _repo_handlers[prio_level].stats.insert_errors;
+    _debugrepoRingGetStats(&_repo_handlers[prio_level], stats);
+}
+
+//*****************************************************************************
+//
+// Obtener la cola de la tarea en ejecución
+//
+// La primera vez que una tarea inserta un mensaje se le asigna una cola libre
+// (sección crítica breve y sólo una vez por tarea). Si no quedan colas libres,
+// o el kernel aún no está en marcha, se utiliza la cola compartida.
+//*****************************************************************************
+static t_debugrepo_ring *_debugrepoGetTaskRing (void)
+{
+    osThreadId self;
+    int i, found = -1;
+
+    if (!osKernelRunning()) {
+        return &_repo.rings[DEBUGREPO_TASKS_NUMSLOTS - 1];
+    }
+    self = osThreadGetId();
+    for (i = 0; i < DEBUGREPO_TASKS_NUMSLOTS - 1; i++) {
+        if (_repo.owners[i] == self) {
+            return &_repo.rings[i];
+        }
+    }
+    taskENTER_CRITICAL();
+    for (i = 0; i < DEBUGREPO_TASKS_NUMSLOTS - 1; i++) {
+        if (_repo.owners[i] == 0) {
+            _repo.owners[i] = self;
+            found = i;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return (found >= 0) ? &_repo.rings[found] : &_repo.rings[DEBUGREPO_TASKS_NUMSLOTS - 1];
 }
 
 
@@ -422,7 +717,7 @@ size_t __write_redirected(int handle, const unsigned char * buffer, size_t size)
   if (_inHandlerMode()) {
 #ifdef DEBUGREPO_WRITE_THREADED_HANDLERS
     if (_isHandlerFinal()) {
-        _debugrepoInsertHandlerMsgBlocking((const char *)buffer, size);
+        _debugrepoInsertHandlerMsgBlocking(DEBUGREPO_REC_TEXT, NULL, 0, (const char *)buffer, size);
     } else {
       prio_level = _getHandlerPrioLevel();
       if ((prio_level < 0) || (prio_level >= DEBUGREPO_HANDLERS_NUMLEVELS)) {
@@ -431,7 +726,7 @@ size_t __write_redirected(int handle, const unsigned char * buffer, size_t size)
       handler_mode = 1;
     }
 #else
-    _debugrepoInsertHandlerMsgBlocking((const char *)buffer, size);
+    _debugrepoInsertHandlerMsgBlocking(DEBUGREPO_REC_TEXT, NULL, 0, (const char *)buffer, size);
     return size;
 #endif    
   } else {
@@ -468,55 +763,97 @@ int debugrepoInsertMsg (const char *msg)
     return debugrepoInsertMsgLen(msg, (uint16_t)len);
 }
 
-static char _binmsg[DEBUGREPO_MSG_MAXLEN];
+//*****************************************************************************
+// Insertar un bloque binario de len bytes
+//
+// Se almacena tal cual; la conversión a texto hexadecimal la hace la tarea
+// consumidora al enviarlo.
+//
+// Retorna 0 si error (repo lleno o bloque de más de DEBUGREPO_MSG_MAXLEN bytes),
+// 1 si operación terminada con éxito
+//*****************************************************************************
 int debugrepoInsertBinMsgLen (const char *msg, uint16_t len) {
-  unsigned int from_idx, to_idx;
-
-  for (from_idx=0, to_idx=0; (from_idx < len) && (to_idx < DEBUGREPO_MSG_MAXLEN); from_idx++) {
-    if (to_idx+6 < DEBUGREPO_MSG_MAXLEN) {
-      if (from_idx > 0) {
-        _binmsg[to_idx++] = ' ';
-      }
-      _binmsg[to_idx++] = asHex((msg[from_idx] >> 4) & 0x0F);
-      _binmsg[to_idx++] = asHex(msg[from_idx] & 0x0F);
-      if ((msg[from_idx] >= 32) && (msg[from_idx] < 128)) {
-        _binmsg[to_idx++] = '(';
-        _binmsg[to_idx++] = msg[from_idx];
-        _binmsg[to_idx++] = ')';
-      }
-    }
+  if (len > DEBUGREPO_MSG_MAXLEN) {
+    return 0;
   }
-  if ((to_idx + 3) >= DEBUGREPO_MSG_MAXLEN) {
-    to_idx -= 3;
+  return _debugrepoInsertRecord(DEBUGREPO_REC_BIN, NULL, 0, msg, len);
+}
+
+//*****************************************************************************
+// Insertar una traza: marca de tiempo (HAL_GetTick, ms), identificador de
+// evento y len bytes de datos
+//
+// Se almacena y se envía en binario, sin formatear, dentro de una trama que
+// empieza por DEBUGREPO_TRACE_SYNC (ver debug_repo.h); la herramienta
+// Tools/debugrepo_decode.py la separa del texto y la presenta en el PC.
+//
+// Retorna 0 si error (repo lleno o más de DEBUGREPO_TRACE_MAXLEN bytes),
+// 1 si operación terminada con éxito
+//*****************************************************************************
+int debugrepoInsertTrace (uint8_t event_id, const void *data, uint16_t len) {
+  char hdr[DEBUGREPO_TRACE_HDR_LEN];
+  uint32_t ts = HAL_GetTick();
+
+  if (len > DEBUGREPO_TRACE_MAXLEN) {
+    return 0;
   }
-  _binmsg[to_idx++] = '\r';
-  _binmsg[to_idx++] = '\n';
-  _binmsg[to_idx++] = '\0';
-  return debugrepoInsertMsgLen (_binmsg, to_idx);
+  hdr[0] = (char)(ts & 0xFF);
+  hdr[1] = (char)((ts >> 8) & 0xFF);
+  hdr[2] = (char)((ts >> 16) & 0xFF);
+  hdr[3] = (char)(ts >> 24);
+  hdr[4] = (char)event_id;
+  return _debugrepoInsertRecord(DEBUGREPO_REC_TRACE, hdr, DEBUGREPO_TRACE_HDR_LEN, (const char *)data, len);
 }
 
-    
+//*****************************************************************************
+// Insertar un mensaje de texto de len bytes (no necesita terminar en '\0')
+//
+// Retorna 0 si error (repo lleno, mensaje no almacenado), 
+// 1 si operación terminada con éxito
+//*****************************************************************************
 int debugrepoInsertMsgLen (const char *msg, uint16_t len) {
+  return _debugrepoInsertRecord(DEBUGREPO_REC_TEXT, NULL, 0, msg, len);
+}
+
+static int _debugrepoInsertRecord (uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len) {
   int prio_level;
   
   if (_inHandlerMode()) {
     if (_isHandlerFinal()) {
-      return _debugrepoInsertHandlerMsgBlocking(msg, len);
+      return _debugrepoInsertHandlerMsgBlocking(type, pre, pre_len, msg, len);
     } else {
       prio_level = _getHandlerPrioLevel();
       if ((prio_level < 0) || (prio_level >= DEBUGREPO_HANDLERS_NUMLEVELS)) {
         return 0;
       }
-      return _debugrepoInsertHandlerMsgNonBlocking((uint32_t)prio_level, msg, len);
+      return _debugrepoInsertHandlerMsgNonBlocking((uint32_t)prio_level, type, pre, pre_len, msg, len);
     }
   } else {
-    return _debugrepoInsertMsgLen(msg, len);
+    return _debugrepoInsertMsgLen(type, pre, pre_len, msg, len);
   }
 }
 
-static int _debugrepoInsertHandlerMsgBlocking(const char *msg, uint16_t len) {
+static int _debugrepoInsertHandlerMsgBlocking(uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len) {
+  static char binmsg[DEBUGREPO_MSG_MAXLEN];
+  char frame[DEBUGREPO_TRACE_FRAME_LEN];
   int i;
 
+  if (type == DEBUGREPO_REC_BIN) {
+    len = _debugrepoFormatBin(msg, len, binmsg, DEBUGREPO_MSG_MAXLEN);
+    msg = binmsg;
+  } else if (type == DEBUGREPO_REC_TRACE) {
+    frame[0] = DEBUGREPO_TRACE_SYNC;
+    frame[1] = (char)((pre_len + len) & 0xFF);
+    frame[2] = (char)((pre_len + len) >> 8);
+    for (i=0; i < DEBUGREPO_TRACE_FRAME_LEN; i++) {
+      _debugrepoWaitUntilUARTFlag(UART_FLAG_TXE);
+      DEBUGREPO_UART_HANDLE.Instance->DR = frame[i] & 0x00FF;
+    }
+  }
+  for (i=0; i < pre_len; i++) {
+    _debugrepoWaitUntilUARTFlag(UART_FLAG_TXE);
+    DEBUGREPO_UART_HANDLE.Instance->DR = pre[i] & 0x00FF;
+  }
   for (i=0; i < len; i++) {
     _debugrepoWaitUntilUARTFlag(UART_FLAG_TXE);
     DEBUGREPO_UART_HANDLE.Instance->DR = msg[i] & 0x00FF;
@@ -524,161 +861,65 @@ static int _debugrepoInsertHandlerMsgBlocking(const char *msg, uint16_t len) {
   return 1;
 }
 
-static int _debugrepoInsertHandlerMsgNonBlocking(uint32_t prio_level, const char *msg, uint16_t len) {
-  int i;
-  
-  if ((DEBUGREPO_HANDLERS_SIZE - _repo_handlers[prio_level].stats.items) < len) {
-    return 0;
-  }
-  for (i = 0; i < len; i++) {
-    if (!_debugrepoHandlerInsertChar(prio_level, (uint8_t)msg[i])) {
-      return 0;
-    }
-  }
-  return 1;
+static int _debugrepoInsertHandlerMsgNonBlocking(uint32_t prio_level, uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len) {
+  return _debugrepoRingInsert(&_repo_handlers[prio_level], type, pre, pre_len, msg, len);
 }
 
-static int _debugrepoInsertMsgLen (const char *msg, uint16_t len) {
-  int i;
-  
-    /* Esperar a que haya suficiente espacio para todo el mensaje.
-        Para esperar:
-        1) Liberar el mutex de acceso 
-        2) Esperar unos pocos ticks (para dar tiempo a la tarea consumidora a 
-           extraer algunos datos) 
-        3) Retomar el mutex de acceso para volver a consultar
-    */
+//*****************************************************************************
+// Insertar un mensaje desde una tarea
+//
+// Cada tarea escribe en su propia cola sin bloquear a las demás; sólo las
+// tareas que comparten la última cola se serializan con el mutex.
+// Si no hay hueco el mensaje se descarta (sin esperar) y queda registrado
+// en las estadísticas como error de inserción.
+//*****************************************************************************
+static int _debugrepoInsertMsgLen (uint16_t type, const char *pre, uint16_t pre_len, const char *msg, uint16_t len) {
+  t_debugrepo_ring *ring = _debugrepoGetTaskRing();
+  int result;
+
+  if (ring != &_repo.rings[DEBUGREPO_TASKS_NUMSLOTS - 1]) {
+    result = _debugrepoRingInsert(ring, type, pre, pre_len, msg, len);
+  } else {
     MUTEX_WAIT;
-    do {
-        if ((DEBUGREPO_SIZE - _repo.stats.items) < len) {
-            // De momento no hay hueco suficiente para el mensaje => 
-			// devolver mutex, esperar, y retomar mutex
-            MUTEX_RELEASE;
-            vTaskDelay(DEBUGREPO_INSERT_DELAY_TICKS);
-            MUTEX_WAIT;
-        } else {
-            /* Ojo, salimos del bucle dentro de la sección crítica */
-            break;
-        }
-    } while (1);
-  
-    /* Insertar el mensaje caracter a caracter; 
-        en caso de error (por repositorio lleno, no debería ocurrir en circunstancias normaler), 
-		el error de insercion queda registrado en las estadisticas. 
-       Nota: no debería haber error ya que 
-       nos hemos asegurado que hay suficiente hueco antes de empezar la inserción ...
-    */
-    for (i = 0; msg[i] != '\0'; i++) {
-        if (!_debugrepoInsertChar_nomutex((uint8_t)msg[i])) {
-            // Oops, error de inserción => liberar mutex y terminar
-            MUTEX_RELEASE;
-            return 0;
-        }
-        // Alargar el tiempo necesario para la operación forzará la aparición de conflictos de acceso
-        DELAY;
-    }
+    result = _debugrepoRingInsert(ring, type, pre, pre_len, msg, len);
     MUTEX_RELEASE;
-    return 1;
+  }
+#ifdef DEBUGREPO_USE_NOTIFY
+  if ((result > 0) && (_repo.task != 0)) {
+    osSignalSet(_repo.task, DEBUGREPO_SIGNAL_PENDING);
+  }
+#endif
+  return result;
 }
 
 //*****************************************************************************
 //
-// Extraer un mensaje completo (hasta '\n' inclusive) 
+// Extraer un mensaje completo (un registro; los binarios ya formateados como texto
+// y las trazas con su trama binaria, ver debugrepoInsertTrace)
 //
 // Retorna:
 // a) >0 La longitud del mensaje extraido, 
 // b) 0 si no hay mensaje que extraer, 
 // c) -1 si el mensaje almacenado en el repositorio no cabe en el array que se pasa como parámetro
-// d) -2 si los datos almacenados en el repositorio no contienen un mensaje completo (finalizado en '\n')
+//    (el mensaje se descarta)
 //*****************************************************************************
 int debugrepoExtractMsg (char msg[], int maxlen)
 {
-    int len, tail;
-    
-    MUTEX_WAIT;
-    if (0 == _repo.stats.items) {
-        // No hay mensaje que extraer
-        MUTEX_RELEASE;
-        return 0;
-    }
-
-    // Calcular la longitud del mensaje a extraer.
-    // Por seguridad, comprobar que no excedemos el tamaño máximo posible (DEBUGREPO_SIZE)
-    for (len = 1, tail = _repo.tail; ('\n' != _repo.buffer[tail]) && (DEBUGREPO_SIZE >= len); len++) {
-        tail = (tail + 1) % DEBUGREPO_SIZE;
-        // Alargar el tiempo necesario para la operación forzará la aparición de conflictos de acceso
-        DELAY;
-    }
-    if (DEBUGREPO_SIZE <= len) {
-        // Hay datos, pero el mensaje no termina con '\n'
-        MUTEX_RELEASE;
-        return -2;
-    }
-    if (len >= maxlen) {
-        // El mensaje que se debe extraer de la tail no cabe en el array que se ha pasado como argumento
-        MUTEX_RELEASE;
-        return -1;
-    }
-
-    // Extraer el mensaje y copiarlo a msg caracter a caracter
-    len = 0;
-    while (_repo.stats.items > 0) {
-        _debugrepoExtractChar_nomutex ((uint8_t *)&msg[len]);
-        if (msg[len++] == '\n') {
-            // Cuando copiamos el '\n' hemos terminado
-            break;
-        }
-        if (len+1 == maxlen) {
-            // Por seguridad comprobamos que la longitud no excede el máximo permitido
-            break;
-        }
-    }
-    // Rellenamos con '\0' para finalizar la cadena
-    msg[len] = '\0';
-    
-    MUTEX_RELEASE;
-    return len;
-}
-
-static int _debugrepoHandlerExtractMsg (uint32_t prio_level, char msg[], int maxlen)
-{
-    int len, tail;
-    
-    if (0 == _repo_handlers[prio_level].stats.items) {
-        return 0;
-    }
-
-    // Calcular la longitud del mensaje a extraer.
-    // Por seguridad, comprobar que no excedemos el tamaño máximo posible (DEBUGREPO_HANDLERS_SIZE)
-    for (len = 1, tail = _repo_handlers[prio_level].tail; ('\n' != _repo_handlers[prio_level].buffer[tail]) && (DEBUGREPO_HANDLERS_SIZE >= len); len++) {
-        tail = (tail + 1) % DEBUGREPO_HANDLERS_SIZE;
-    }
-    if (DEBUGREPO_HANDLERS_SIZE <= len) {
-        return -2;
-    }
-    if (len >= maxlen) {
-        return -1;
-    }
-
-    // Extraer el mensaje y copiarlo a msg caracter a caracter
-    len = 0;
-    while (_repo_handlers[prio_level].stats.items > 0) {
-        _debugrepoHandlerExtractChar (prio_level, (uint8_t *)&msg[len]);
-        if (msg[len++] == '\n') {
-            // Cuando copiamos el '\n' hemos terminado
-            break;
-        }
-        if (len+1 == maxlen) {
-            // Por seguridad comprobamos que la longitud no excede el máximo permitido
+    int i, result = 0;
+    uint32_t idx;
+
+    // Recorrer las colas empezando por la siguiente a la última servida
+    for (i = 0; i < DEBUGREPO_TASKS_NUMSLOTS; i++) {
+        idx = (_repo.next + i) % DEBUGREPO_TASKS_NUMSLOTS;
+        result = _debugrepoRingExtractMsg(&_repo.rings[idx], msg, maxlen);
+        if (result != 0) {
+            _repo.next = (idx + 1) % DEBUGREPO_TASKS_NUMSLOTS;
             break;
         }
     }
-    // Rellenamos con '\0' para finalizar la cadena
-    msg[len] = '\0';
-    return len;
+    return result;
 }
 
-
 static char DEBUGREPO_STATS_HEADER_MSG[] =   "[debugrepoTask] Stats info            :: Total items | current items | insert errors\r\n";
 static char DEBUGREPO_STATS_TASKS_MSG[] =    "[debugrepoTask]            Tasks msgs ::    NNNNNNNN |      NNNNNNNN |      NNNNNNNN\r\n";
 static char DEBUGREPO_STATS_HANDLERS_MSG[] = "[debugrepoTask] Handlers  (prio PPPP) ::    NNNNNNNN |      NNNNNNNN |      NNNNNNNN\r\n";
@@ -734,6 +975,8 @@ static void _formatStatsMsg(t_debugrepo_stats *pstats, t_format_info* pformat, c
 
 static void _debugrepoTask(void const * argument) {
   int i, extract_res = 0;
+  uint32_t idx;
+  const char *msg;
 #ifdef DEBUGREPO_SEND_STATS
   t_debugrepo_stats stats;
   int stats_header_sent = 0;
@@ -750,12 +993,12 @@ static void _debugrepoTask(void const * argument) {
     if (count == DEBUGREPO_SEND_STATS_EVERY) {
       count = 0;
       osSemaphoreWait(_repo.sem, osWaitForever);
-      HAL_UART_Transmit_IT(&DEBUGREPO_UART_HANDLE, (uint8_t *)DEBUGREPO_STATS_HEADER_MSG, DEBUGREPO_STATS_HEADER_MSG_LEN);
+      DEBUGREPO_UART_TRANSMIT(DEBUGREPO_STATS_HEADER_MSG, DEBUGREPO_STATS_HEADER_MSG_LEN);
       stats_header_sent = 1;
       _debugrepoGetStats(&stats);
       osSemaphoreWait(_repo.sem, osWaitForever);
       _formatStatsMsg(&stats, _tasks_msgs_format_info, DEBUGREPO_STATS_TASKS_MSG, DEBUGREPO_STATS_TASKS_MSG_LEN);
-      HAL_UART_Transmit_IT(&DEBUGREPO_UART_HANDLE, (uint8_t *)DEBUGREPO_STATS_TASKS_MSG, DEBUGREPO_STATS_TASKS_MSG_LEN);
+      DEBUGREPO_UART_TRANSMIT(DEBUGREPO_STATS_TASKS_MSG, DEBUGREPO_STATS_TASKS_MSG_LEN);
     }
 #endif    
 #ifdef DEBUGREPO_SEND_STATS
@@ -764,7 +1007,7 @@ static void _debugrepoTask(void const * argument) {
       handler_count = 0;
       if (!stats_header_sent) {
         osSemaphoreWait(_repo.sem, osWaitForever);
-        HAL_UART_Transmit_IT(&DEBUGREPO_UART_HANDLE, (uint8_t *)DEBUGREPO_STATS_HEADER_MSG, DEBUGREPO_STATS_HEADER_MSG_LEN);
+        DEBUGREPO_UART_TRANSMIT(DEBUGREPO_STATS_HEADER_MSG, DEBUGREPO_STATS_HEADER_MSG_LEN);
       }
       for (i=0; i < DEBUGREPO_HANDLERS_NUMLEVELS; i++) {
         _debugrepoGetHandlerStats(i, &stats);
@@ -773,38 +1016,51 @@ static void _debugrepoTask(void const * argument) {
         //formatInt(&_msg2send[_handlers_msgs_format_info[0].pos], DEBUGREPO_STATS_HANDLERS_MSG_LEN-_handlers_msgs_format_info[0].pos, -i, _handlers_msgs_format_info[0].len, _handlers_msgs_format_info[0].pad);
         formatUnsignedInt(&DEBUGREPO_STATS_HANDLERS_MSG[_handlers_msgs_format_info[0].pos], DEBUGREPO_STATS_HANDLERS_MSG_LEN-_handlers_msgs_format_info[0].pos, i, _handlers_msgs_format_info[0].len, _handlers_msgs_format_info[0].pad);
         _formatStatsMsg(&stats, &_handlers_msgs_format_info[1], DEBUGREPO_STATS_HANDLERS_MSG, DEBUGREPO_STATS_HANDLERS_MSG_LEN);
-        HAL_UART_Transmit_IT(&DEBUGREPO_UART_HANDLE, (uint8_t *)DEBUGREPO_STATS_HANDLERS_MSG, DEBUGREPO_STATS_HANDLERS_MSG_LEN);
+        DEBUGREPO_UART_TRANSMIT(DEBUGREPO_STATS_HANDLERS_MSG, DEBUGREPO_STATS_HANDLERS_MSG_LEN);
       }
     }
   #endif    
 #endif    
     osSemaphoreWait(_repo.sem, osWaitForever);
-    for (i=0; i < DEBUGREPO_HANDLERS_NUMLEVELS; i++) {
-      extract_res = _debugrepoHandlerExtractMsg(i, _msg2send, DEBUGREPO_MSG_MAXLEN);
-      if (extract_res > 0) {
-        break;
-      }
+    extract_res = 0;
+    for (i=0; (i < DEBUGREPO_HANDLERS_NUMLEVELS) && (extract_res == 0); i++) {
+      extract_res = _debugrepoRingNextToSend(&_repo_handlers[i], &msg);
       if (extract_res < 0) {
         formatUnsignedInt(&DEBUGREPO_HANDLERS_ERROR_MSG[_handlers_error_msg_format_info[0].pos], DEBUGREPO_HANDLERS_ERROR_MSG_LEN-_handlers_error_msg_format_info[0].pos, i, _handlers_error_msg_format_info[0].len, _handlers_error_msg_format_info[0].pad);
         formatInt(&DEBUGREPO_HANDLERS_ERROR_MSG[_handlers_error_msg_format_info[1].pos], DEBUGREPO_HANDLERS_ERROR_MSG_LEN-_handlers_error_msg_format_info[1].pos, extract_res, _handlers_error_msg_format_info[1].len, _handlers_error_msg_format_info[1].pad);
+        msg = DEBUGREPO_HANDLERS_ERROR_MSG;
         extract_res = DEBUGREPO_HANDLERS_ERROR_MSG_LEN;
-        break;
       }
     }
-    
-    if (extract_res == 0) {
-      extract_res = debugrepoExtractMsg(_msg2send, DEBUGREPO_MSG_MAXLEN);
+    // Recorrer las colas de tareas empezando por la siguiente a la última servida
+    for (i=0; (i < DEBUGREPO_TASKS_NUMSLOTS) && (extract_res == 0); i++) {
+      idx = (_repo.next + i) % DEBUGREPO_TASKS_NUMSLOTS;
+      extract_res = _debugrepoRingNextToSend(&_repo.rings[idx], &msg);
+      if (extract_res != 0) {
+        _repo.next = (idx + 1) % DEBUGREPO_TASKS_NUMSLOTS;
+      }
+      if (extract_res < 0) {
+        formatInt(&DEBUGREPO_ERROR_MSG[_error_msg_format_info[0].pos], DEBUGREPO_ERROR_MSG_LEN-_error_msg_format_info[0].pos, extract_res, _error_msg_format_info[0].len, _error_msg_format_info[0].pad);
+        msg = DEBUGREPO_ERROR_MSG;
+        extract_res = DEBUGREPO_ERROR_MSG_LEN;
+      }
     }
     if (extract_res == 0) {
       osSemaphoreRelease(_repo.sem);
+#ifdef DEBUGREPO_USE_NOTIFY
+      osSignalWait(DEBUGREPO_SIGNAL_PENDING, DEBUGREPO_EXTRACT_DELAY_TICKS);
+#else
       osDelay(DEBUGREPO_EXTRACT_DELAY_TICKS);
+#endif
       continue;
     }
-    if (extract_res < 0) {
-      formatInt(&DEBUGREPO_ERROR_MSG[_error_msg_format_info[0].pos], DEBUGREPO_ERROR_MSG_LEN-_error_msg_format_info[0].pos, extract_res, _error_msg_format_info[1].len, _error_msg_format_info[1].pad);
-      extract_res = DEBUGREPO_ERROR_MSG_LEN;
+    if (DEBUGREPO_UART_TRANSMIT(msg, extract_res) != HAL_OK) {
+#ifdef DEBUGREPO_USE_DMA
+      // Los registros enviados sin copia se quedan en la cola para el siguiente intento
+      _dma_ring = NULL;
+#endif
+      osSemaphoreRelease(_repo.sem);
     }
-    HAL_UART_Transmit_IT(&DEBUGREPO_UART_HANDLE, (uint8_t *)_msg2send, extract_res);
 #ifdef DEBUGREPO_SEND_STATS
     count++;
   #ifdef DEBUGREPO_SEND_HANDLERS_STATS
@@ -816,6 +1072,15 @@ static void _debugrepoTask(void const * argument) {
 
 void debugrepoUARTCallback(UART_HandleTypeDef *huart) {
   if (huart == &DEBUGREPO_UART_HANDLE) {
+#ifdef DEBUGREPO_USE_DMA
+    // Transmisión sin copia terminada: devolver el hueco de los registros enviados
+    if (_dma_ring != NULL) {
+      _dma_ring->tail += _dma_bytes;
+      __DMB();
+      _dma_ring->rec_tail += _dma_records;
+      _dma_ring = NULL;
+    }
+#endif
     osSemaphoreRelease(_repo.sem);
   }
 }
@@ -52,31 +52,51 @@
 #include "cmsis_os.h"
 
 /* USER CODE BEGIN Includes */     
+#include "knx_phy.h"
+#include "knx_link.h"
+#include "debug_repo.h"
+#include "sys_stats.h"
+#include "knx_phy_bench.h"
+#include "knx_rx_bench.h"
 
 /* USER CODE END Includes */
 
 /* Variables -----------------------------------------------------------------*/
-osThreadId defaultTaskHandle;
-osThreadId myTask02Handle;
-osThreadId myTask03Handle;
-osThreadId myTask04Handle;
-osThreadId myTask05Handle;
-osThreadId myTask06Handle;
-osMessageQId myQueue01Handle;
-osMutexId myMutex01Handle;
-osSemaphoreId myBinarySem01Handle;
+osThreadId appTaskHandle;
+osThreadId knxRxTaskHandle;
+osThreadId knxTxTaskHandle;
+osThreadId knxHealthTaskHandle;
+osThreadId sysStatsTaskHandle;
+osMessageQId knx_phy_reset_conHandle;
+osMessageQId knx_phy_data_conHandle;
+osMessageQId knx_phy_data_indHandle;
+osMessageQId knx_app_indHandle;
+osTimerId knx_phy_reset_timerHandle;
 
 /* USER CODE BEGIN Variables */
 
+/* Parámetros KNX de este sistema (dirección individual 1.1.1, sin polling) */
+#define APP_KNX_IND_ADDRESS         0x1101
+#define APP_KNX_POLL_GRP_ADDRESS    0x0000
+#define APP_KNX_POLL_SLOT_NUMBER    0
+
+/* Frecuencia del contador de las estadísticas de ejecución (run-time stats) */
+#define RUN_TIME_STATS_HZ           100000UL
+
+/* Estado del contador de las estadísticas de ejecución (ver getRunTimeCounterValue) */
+static uint32_t run_time_cyccnt_last;
+static uint32_t run_time_cycles;
+static uint32_t run_time_count;
+
 /* USER CODE END Variables */
 
 /* Function prototypes -------------------------------------------------------*/
-void StartDefaultTask(void const * argument);
-void StartTask02(void const * argument);
-void StartTask03(void const * argument);
-void Send_Task(void const * argument);
-void Receive_Task(void const * argument);
-void Mutex_Task(void const * argument);
+void StartAppTask(void const * argument);
+void StartKnxRxTask(void const * argument);
+void StartKnxTxTask(void const * argument);
+void StartKnxHealthTask(void const * argument);
+void StartSysStatsTask(void const * argument);
+void knx_phy_reset_timer_cb(void const * argument);
 
 extern void MX_USB_HOST_Init(void);
 void MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
@@ -86,6 +106,43 @@ void MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
 /* USER CODE END FunctionPrototypes */
 
 /* Hook prototypes */
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
+
+/* USER CODE BEGIN 1 */
+/* Functions needed when configGENERATE_RUN_TIME_STATS is on */
+void configureTimerForRunTimeStats(void)
+{
+  // Contador de ciclos del núcleo (DWT), sin ocupar ningún temporizador
+  // Sólo se habilita: lo comparten isr_prof, knx_phy y knx_monitor, así que
+  // se parte del valor actual en lugar de ponerlo a cero
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  run_time_cyccnt_last = DWT->CYCCNT;
+  run_time_cycles = 0;
+  run_time_count = 0;
+}
+
+unsigned long getRunTimeCounterValue(void)
+{
+  uint32_t cycles_per_count = SystemCoreClock / RUN_TIME_STATS_HZ;
+  uint32_t now = DWT->CYCCNT;
+  uint32_t counts;
+
+  // CYCCNT da la vuelta cada 2^32 ciclos (25 s a 168 MHz): se acumula la
+  // diferencia desde la última lectura y se reduce a RUN_TIME_STATS_HZ, con
+  // lo que el contador de FreeRTOS tarda en dar la vuelta casi 12 horas.
+  // FreeRTOS lo lee en cada cambio de contexto (y con el planificador
+  // suspendido al pedir las estadísticas), por lo que no hay lecturas
+  // concurrentes y el intervalo entre dos lecturas es muy inferior a 25 s.
+  run_time_cycles += now - run_time_cyccnt_last;
+  run_time_cyccnt_last = now;
+  counts = run_time_cycles / cycles_per_count;
+  run_time_cycles -= counts * cycles_per_count;
+  run_time_count += counts;
+  return run_time_count;
+}
+/* USER CODE END 1 */
 
 /* Init FreeRTOS */
 
@@ -94,207 +151,210 @@ void MX_FREERTOS_Init(void) {
        
   /* USER CODE END Init */
 
-  /* Create the mutex(es) */
-  /* definition and creation of myMutex01 */
-  osMutexDef(myMutex01);
-  myMutex01Handle = osMutexCreate(osMutex(myMutex01));
-
   /* USER CODE BEGIN RTOS_MUTEX */
   /* add mutexes, ... */
   /* USER CODE END RTOS_MUTEX */
 
-  /* Create the semaphores(s) */
-  /* definition and creation of myBinarySem01 */
-  osSemaphoreDef(myBinarySem01);
-  myBinarySem01Handle = osSemaphoreCreate(osSemaphore(myBinarySem01), 1);
-
   /* USER CODE BEGIN RTOS_SEMAPHORES */
   /* add semaphores, ... */
   /* USER CODE END RTOS_SEMAPHORES */
 
+  /* Create the timer(s) */
+  /* definition and creation of knx_phy_reset_timer */
+  osTimerDef(knx_phy_reset_timer, knx_phy_reset_timer_cb);
+  knx_phy_reset_timerHandle = osTimerCreate(osTimer(knx_phy_reset_timer), osTimerOnce, NULL);
+
   /* USER CODE BEGIN RTOS_TIMERS */
   /* start timers, add new ones, ... */
   /* USER CODE END RTOS_TIMERS */
 
   /* Create the thread(s) */
-  /* definition and creation of defaultTask */
-  osThreadDef(defaultTask, StartDefaultTask, osPriorityNormal, 0, 128);
-  defaultTaskHandle = osThreadCreate(osThread(defaultTask), NULL);
-
-  /* definition and creation of myTask02 */
-  osThreadDef(myTask02, StartTask02, osPriorityNormal, 0, 128);
-  myTask02Handle = osThreadCreate(osThread(myTask02), NULL);
+  /* definition and creation of appTask */
+  osThreadDef(appTask, StartAppTask, osPriorityBelowNormal, 0, 256);
+  appTaskHandle = osThreadCreate(osThread(appTask), NULL);
 
-  /* definition and creation of myTask03 */
-  osThreadDef(myTask03, StartTask03, osPriorityNormal, 0, 128);
-  myTask03Handle = osThreadCreate(osThread(myTask03), NULL);
+  /* definition and creation of knxRxTask */
+  osThreadDef(knxRxTask, StartKnxRxTask, osPriorityHigh, 0, 192);
+  knxRxTaskHandle = osThreadCreate(osThread(knxRxTask), NULL);
 
-  /* definition and creation of myTask04 */
-  osThreadDef(myTask04, Send_Task, osPriorityNormal, 0, 128);
-  myTask04Handle = osThreadCreate(osThread(myTask04), NULL);
+  /* definition and creation of knxTxTask */
+  osThreadDef(knxTxTask, StartKnxTxTask, osPriorityAboveNormal, 0, 192);
+  knxTxTaskHandle = osThreadCreate(osThread(knxTxTask), NULL);
 
-  /* definition and creation of myTask05 */
-  osThreadDef(myTask05, Receive_Task, osPriorityNormal, 0, 128);
-  myTask05Handle = osThreadCreate(osThread(myTask05), NULL);
+  /* definition and creation of knxHealthTask */
+  osThreadDef(knxHealthTask, StartKnxHealthTask, osPriorityLow, 0, 256);
+  knxHealthTaskHandle = osThreadCreate(osThread(knxHealthTask), NULL);
 
-  /* definition and creation of myTask06 */
-  osThreadDef(myTask06, Mutex_Task, osPriorityNormal, 0, 128);
-  myTask06Handle = osThreadCreate(osThread(myTask06), NULL);
+  /* definition and creation of sysStatsTask */
+  osThreadDef(sysStatsTask, StartSysStatsTask, osPriorityLow, 0, 256);
+  sysStatsTaskHandle = osThreadCreate(osThread(sysStatsTask), NULL);
 
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
   /* USER CODE END RTOS_THREADS */
 
   /* Create the queue(s) */
-  /* definition and creation of myQueue01 */
-/* what about the sizeof here??? cd native code */
-  osMessageQDef(myQueue01, 16, uint16_t);
-  myQueue01Handle = osMessageCreate(osMessageQ(myQueue01), NULL);
+  /* definition and creation of knx_phy_reset_con */
+  osMessageQDef(knx_phy_reset_con, 1, uint16_t);
+  knx_phy_reset_conHandle = osMessageCreate(osMessageQ(knx_phy_reset_con), NULL);
+
+  /* definition and creation of knx_phy_data_con */
+  osMessageQDef(knx_phy_data_con, 16, uint16_t);
+  knx_phy_data_conHandle = osMessageCreate(osMessageQ(knx_phy_data_con), NULL);
+
+  /* definition and creation of knx_phy_data_ind */
+  osMessageQDef(knx_phy_data_ind, 16, uint32_t);
+  knx_phy_data_indHandle = osMessageCreate(osMessageQ(knx_phy_data_ind), NULL);
+
+  /* definition and creation of knx_app_ind */
+  osMessageQDef(knx_app_ind, 8, uint32_t);
+  knx_app_indHandle = osMessageCreate(osMessageQ(knx_app_ind), NULL);
 
   /* USER CODE BEGIN RTOS_QUEUES */
   /* add queues, ... */
   /* USER CODE END RTOS_QUEUES */
 }
 
-/* StartDefaultTask function */
-void StartDefaultTask(void const * argument)
+/* StartAppTask function */
+void StartAppTask(void const * argument)
 {
   /* init code for USB_HOST */
   MX_USB_HOST_Init();
 
-  /* USER CODE BEGIN StartDefaultTask */
-
-  //uint8_t myTxData[] = "Led PD14 alight \n \r";
+  /* USER CODE BEGIN StartAppTask */
+  osEvent event;
+#ifndef KNX_PHY_DATA_IND_PER_OCTET
+  knx_phy_frame_t *frame;
+#endif
+
+  // Arranque de la pila KNX (los objetos de FreeRTOS ya están creados)
+  debugrepoInit();
+  knx_phy_init();
+  knx_link_init(APP_KNX_IND_ADDRESS, APP_KNX_POLL_GRP_ADDRESS, APP_KNX_POLL_SLOT_NUMBER);
+  // Si no llega la confirmación, la tarea de supervisión la recoge más tarde
+  knx_link_wait_reset_con(KNX_LINK_HEALTH_RESET_WAIT_MS);
+#ifdef KNX_PHY_BENCH
+  // Latencia de entrega de Ph_Data.ind y Ph_Data.con (ver knx_phy_bench.h)
+  knx_phy_bench_run(KNX_PHY_BENCH_ITERATIONS);
+#endif
+#ifdef KNX_RX_BENCH
+  // Detección de tramas corruptas y carga de la recepción con tráfico
+  // sintético (ver knx_rx_bench.h)
+  knx_rx_bench_check_chk(knx_app_indHandle);
+  knx_rx_bench_run(KNX_RX_BENCH_FRAMES);
+#endif
 
   /* Infinite loop */
   for(;;)
   {
-	  /*
-	  HAL_GPIO_TogglePin(GPIOD, GPIO_PIN_14);
-
-	  if(IS_GPIO_PIN(14))
-	  {
-         HAL_UART_Transmit(&huart6, myTxData, 30, 10);
-         HAL_Delay(1000);
-      }
-      if(IS_GPIO_PIN(13))
-      {
-         HAL_UART_Transmit(&huart6, myTxData13, 30, 10);
-         HAL_Delay(1000);
-      }
-
-	  vTaskDelay(500);
-	  */
+    // Tramas recibidas que reenvía knxRxTask
+    event = osMessageGet(knx_app_indHandle, osWaitForever);
+    if (event.status != osEventMessage)
+    {
+      continue;
+    }
+#ifndef KNX_PHY_DATA_IND_PER_OCTET
+    frame = (knx_phy_frame_t *)event.value.p;
+    debugrepoInsertTrace(DEBUGREPO_TRACE_KNX_RX, frame->bytes, frame->len);
+    knx_phy_data_ind_release(frame);
+#endif
   }
-  /* USER CODE END StartDefaultTask */
+  /* USER CODE END StartAppTask */
 }
 
-/* StartTask02 function */
-void StartTask02(void const * argument)
+/* StartKnxRxTask function */
+void StartKnxRxTask(void const * argument)
 {
-  /* USER CODE BEGIN StartTask02 */
-
-  //uint8_t myTxData2[] = "Led PD15 alight \n \r";
+  /* USER CODE BEGIN StartKnxRxTask */
+  osEvent event;
 
   /* Infinite loop */
   for(;;)
   {
-	  /*
-	  HAL_GPIO_TogglePin(GPIOD, GPIO_PIN_15);
-	  vTaskDelay(500);
-	  */
+    // Ph_Data.ind: sólo se bloquea esperando tramas, sin sondeo ni retardos,
+    // para vaciar knx_phy_data_ind antes de que la ISR de recepción la llene
+    event = knx_phy_data_ind_get(osWaitForever);
+    if (event.status != osEventMessage)
+    {
+      continue;
+    }
+#ifdef KNX_PHY_BENCH
+    knx_phy_bench_delivered(KNX_PHY_BENCH_DATA_IND);
+#endif
+    if (osMessagePut(knx_app_indHandle, event.value.v, 0) != osOK)
+    {
+      // Aplicación saturada: la trama se pierde pero el descriptor vuelve a la pila
+#ifndef KNX_PHY_DATA_IND_PER_OCTET
+      knx_phy_data_ind_release((knx_phy_frame_t *)event.value.p);
+#endif
+    }
   }
-  /* USER CODE END StartTask02 */
+  /* USER CODE END StartKnxRxTask */
 }
 
-/* StartTask03 function */
-void StartTask03(void const * argument)
+/* StartKnxTxTask function */
+void StartKnxTxTask(void const * argument)
 {
-  /* USER CODE BEGIN StartTask03 */
-  GPIO_PinState myButton = GPIO_PIN_SET;
-  int semw_status;
+  /* USER CODE BEGIN StartKnxTxTask */
+  osEvent event;
+  uint8_t data;
 
   /* Infinite loop */
   for(;;)
   {
-    semw_status = (osStatus)osSemaphoreWait(myBinarySem01Handle, 0);
-    if(osOK == semw_status)
+    // Ph_Data.con: vaciar las confirmaciones (la planificación de la
+    // transmisión se hace en las ISR, ver knx_link_tx_event)
+    event = knx_phy_data_con_get(osWaitForever);
+    if (event.status != osEventMessage)
     {
-    	HAL_GPIO_WritePin(GPIOD, GPIO_PIN_14, myButton);
-    	if(GPIO_PIN_SET == myButton)
-    	{
-    		myButton = GPIO_PIN_RESET;
-    	}
-    	else
-    	{
-    		myButton = GPIO_PIN_SET;
-    	}
+      continue;
+    }
+#ifdef KNX_PHY_BENCH
+    knx_phy_bench_delivered(KNX_PHY_BENCH_DATA_CON);
+#endif
+    if (((event.value.v >> 8) & 0xFF) == KNX_PHY_DATA_CON_STATUS_LDATA_CONFIRM)
+    {
+      data = (uint8_t)(event.value.v & 0xFF);
+      debugrepoInsertTrace(DEBUGREPO_TRACE_KNX_TX, &data, 1);
     }
-    //vTaskDelay(500);
   }
-  /* USER CODE END StartTask03 */
+  /* USER CODE END StartKnxTxTask */
 }
 
-/* Send_Task function */
-void Send_Task(void const * argument)
+/* StartKnxHealthTask function */
+void StartKnxHealthTask(void const * argument)
 {
-  /* USER CODE BEGIN Send_Task */
-
-  uint32_t data = GPIO_PIN_SET;
-
+  /* USER CODE BEGIN StartKnxHealthTask */
   /* Infinite loop */
   for(;;)
   {
-
-	osMessagePut(myQueue01Handle, data, osWaitForever); // To send a message to the queue
-	vTaskDelay(500);
-
-	if(data == GPIO_PIN_SET)
-	{
-	    data = GPIO_PIN_RESET;
-    }
-	else
-	{
-	    data = GPIO_PIN_SET;
-	}
-
+    // Supervisión de la TP-UART (U_State.ind, aviso TW y errores PE/TE)
+    osDelay(KNX_LINK_HEALTH_PERIOD_MS);
+    knx_link_health_poll();
   }
-  /* USER CODE END Send_Task */
+  /* USER CODE END StartKnxHealthTask */
 }
 
-/* Receive_Task function */
-void Receive_Task(void const * argument)
+/* StartSysStatsTask function */
+void StartSysStatsTask(void const * argument)
 {
-  /* USER CODE BEGIN Receive_Task */
-
-	osEvent event;
-	uint16_t message;
-
+  /* USER CODE BEGIN StartSysStatsTask */
   /* Infinite loop */
   for(;;)
   {
-	  event = osMessageGet(myQueue01Handle, 0);// wait for message
-	  if (event.status == osEventMessage)
-	  {
-	      message = *(uint16_t *)event.value.p;
-	      HAL_GPIO_WritePin(GPIOD, GPIO_PIN_15, message);
-	  }
-
-      vTaskDelay(100);
+    // Uso de CPU por tarea, pila libre y memoria dinámica (ver sys_stats.h)
+    osDelay(SYS_STATS_PERIOD_MS);
+    sys_stats_report();
   }
-  /* USER CODE END Receive_Task */
+  /* USER CODE END StartSysStatsTask */
 }
 
-/* Mutex_Task function */
-void Mutex_Task(void const * argument)
+/* knx_phy_reset_timer_cb function */
+void knx_phy_reset_timer_cb(void const * argument)
 {
-  /* USER CODE BEGIN Mutex_Task */
-  /* Infinite loop */
-  for(;;)
-  {
-    osDelay(1);
-  }
-  /* USER CODE END Mutex_Task */
+  /* USER CODE BEGIN knx_phy_reset_timer_cb */
+  knx_phy_tpuart_reset_timeout();
+  /* USER CODE END knx_phy_reset_timer_cb */
 }
 
 /* USER CODE BEGIN Application */
@@ -126,3 +126,24 @@ char *formatInt(char buffer[], unsigned int buffer_length, int value, unsigned i
     return _formatUInt(buffer, buffer_length, (unsigned int)value, formatted_length, padding, NULL);
   }
 }
+
+char *appendString(char *p, char *end, const char *str) {
+  if (p == NULL) {
+    return NULL;
+  }
+  while (*str != '\0') {
+    if (p >= end) {
+      return NULL;
+    }
+    *p++ = *str++;
+  }
+  return p;
+}
+
+char *appendUnsignedInt(char *p, char *end, const char *label, unsigned int value) {
+  p = appendString(p, end, label);
+  if ((p == NULL) || (p >= end)) {
+    return NULL;
+  }
+  return formatUnsignedInt(p, end - p, value, 0, ' ');
+}
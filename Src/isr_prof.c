@@ -0,0 +1,284 @@
+/**
+ * @file isr_prof.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Medida del tiempo de ejecución de las rutinas de interrupción
+ *
+ * Ver isr_prof.h. Todo el contenido de este fichero queda excluido de la
+ * compilación si no se define la macro ISR_PROF.
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>     // Para los tipos uintXX_t
+#include <stddef.h>     // Para offsetof
+#include <string.h>     // Para memset, memcpy
+#include "isr_prof.h"   // Para las declaraciones públicas de este módulo
+
+#ifdef ISR_PROF
+
+#include "helpers.h"    // Para appendString y appendUnsignedInt
+#include "debug_repo.h" // Para el envío de las estadísticas
+
+/* --------------------------- Macros privadas ---------------------------- */
+
+#define ISR_PROF_RING_MASK          (ISR_PROF_RING_SIZE - 1)
+
+#if (ISR_PROF_RING_SIZE & ISR_PROF_RING_MASK) != 0
+#error "ISR_PROF_RING_SIZE debe ser potencia de 2"
+#endif
+
+/* Longitud máxima de una línea de isr_prof_report() */
+#define ISR_PROF_REPORT_MAXLEN      (64 + 11 * (7 + ISR_PROF_HIST_BINS))
+
+/* ----------------------- Tipos de datos privados ------------------------ */
+
+/**
+ * Tipo estructurado con una muestra de ejecución de una ISR
+ */
+struct isr_prof_sample_s {
+    uint32_t start;                 /**< DWT->CYCCNT a la entrada */
+    uint32_t cycles;                /**< Duración en ciclos       */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct isr_prof_sample_s isr_prof_sample_t;
+
+/**
+ * Tipo estructurado con la cola de muestras de una ISR.
+ * head sólo lo escribe la ISR y tail sólo la tarea consumidora; ambos
+ * índices avanzan sin límite y se reducen con ISR_PROF_RING_MASK al acceder
+ */
+struct isr_prof_ring_s {
+    volatile uint32_t head;                             /**< Índice de escritura (ISR)         */
+    volatile uint32_t tail;                             /**< Índice de lectura (tarea)         */
+    volatile uint32_t overruns;                         /**< Muestras perdidas (escrito por la ISR) */
+    isr_prof_sample_t samples[ISR_PROF_RING_SIZE];      /**< Muestras                          */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct isr_prof_ring_s isr_prof_ring_t;
+
+/* ------------------------- Variables privadas --------------------------- */
+
+/**
+ * Cola de muestras de cada ISR
+ */
+static isr_prof_ring_t isr_prof_rings[ISR_PROF_NUM_IDS];
+
+/**
+ * Estadísticas acumuladas de cada ISR (sólo accedidas por la tarea consumidora)
+ */
+static isr_prof_stats_t isr_prof_stats[ISR_PROF_NUM_IDS];
+
+/**
+ * Instante de entrada de la última muestra procesada de cada ISR, para el periodo
+ */
+static uint32_t isr_prof_last_start[ISR_PROF_NUM_IDS];
+
+/**
+ * Nombres de las ISR en isr_prof_report(), en el orden de isr_prof_id_t
+ */
+static const char * const isr_prof_names[ISR_PROF_NUM_IDS] = {
+    "USART3_IRQ",
+    "KNX_RX_CPLT",
+    "KNX_TX_CPLT",
+    "KNX_RESET_TIMEOUT"
+};
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+/**
+ * @brief Reiniciar las estadísticas de una ISR
+ * @param[out] stats Estadísticas a reiniciar
+ */
+static void isr_prof_init_stats (isr_prof_stats_t *stats);
+
+/**
+ * @brief Índice del intervalo del histograma correspondiente a una duración
+ * @param[in] cycles Duración en ciclos
+ *
+ * @returns floor(log2(cycles)), saturado a ISR_PROF_HIST_BINS - 1 (0 para 0 y 1 ciclos)
+ */
+static uint32_t isr_prof_hist_bin (uint32_t cycles);
+
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+static void isr_prof_init_stats (isr_prof_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->min = UINT32_MAX;
+	stats->period_min = UINT32_MAX;
+}
+
+static uint32_t isr_prof_hist_bin (uint32_t cycles)
+{
+	uint32_t bin;
+
+	if (cycles < 2)
+	{
+		return 0;
+	}
+	bin = 31 - __CLZ(cycles);
+	return (bin < ISR_PROF_HIST_BINS) ? bin : (ISR_PROF_HIST_BINS - 1);
+}
+
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+void isr_prof_init (void)
+{
+	uint32_t i;
+
+	memset(isr_prof_rings, 0, sizeof(isr_prof_rings));
+	for (i = 0; i < ISR_PROF_NUM_IDS; i++)
+	{
+		isr_prof_init_stats(&isr_prof_stats[i]);
+		isr_prof_last_start[i] = 0;
+	}
+
+	// Sólo se habilita el contador: ponerlo a cero falsearía las medidas en
+	// curso de sus otros usuarios (run-time stats, knx_phy, knx_monitor)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void isr_prof_record (isr_prof_id_t id, uint32_t start, uint32_t end)
+{
+	isr_prof_ring_t *ring = &isr_prof_rings[id];
+	uint32_t head = ring->head;
+
+	if ((head - ring->tail) >= ISR_PROF_RING_SIZE)
+	{
+		ring->overruns++;
+		return;
+	}
+	ring->samples[head & ISR_PROF_RING_MASK].start = start;
+	ring->samples[head & ISR_PROF_RING_MASK].cycles = end - start;
+	// La muestra debe estar escrita antes de publicarla al consumidor
+	__DMB();
+	ring->head = head + 1;
+}
+
+void isr_prof_process (void)
+{
+	uint32_t id, head, tail;
+	isr_prof_ring_t *ring;
+	isr_prof_stats_t *stats;
+	isr_prof_sample_t sample;
+
+	for (id = 0; id < ISR_PROF_NUM_IDS; id++)
+	{
+		ring = &isr_prof_rings[id];
+		stats = &isr_prof_stats[id];
+		head = ring->head;
+		__DMB();
+		for (tail = ring->tail; tail != head; tail++)
+		{
+			sample = ring->samples[tail & ISR_PROF_RING_MASK];
+			if (stats->count > 0)
+			{
+				uint32_t period = sample.start - isr_prof_last_start[id];
+				if (period < stats->period_min)
+				{
+					stats->period_min = period;
+				}
+				if (period > stats->period_max)
+				{
+					stats->period_max = period;
+				}
+			}
+			isr_prof_last_start[id] = sample.start;
+			stats->count++;
+			stats->total += sample.cycles;
+			if (sample.cycles < stats->min)
+			{
+				stats->min = sample.cycles;
+			}
+			if (sample.cycles > stats->max)
+			{
+				stats->max = sample.cycles;
+			}
+			stats->hist[isr_prof_hist_bin(sample.cycles)]++;
+		}
+		// La muestra debe estar leída antes de devolver su hueco a la ISR
+		__DMB();
+		ring->tail = tail;
+		stats->overruns = ring->overruns;
+	}
+}
+
+void isr_prof_get_stats (isr_prof_id_t id, isr_prof_stats_t *stats)
+{
+	isr_prof_process();
+	*stats = isr_prof_stats[id];
+}
+
+void isr_prof_report (void)
+{
+	static char line[ISR_PROF_REPORT_MAXLEN];
+	char *end = &line[ISR_PROF_REPORT_MAXLEN - 3];
+	char *p;
+	uint32_t id, i, mean;
+	isr_prof_stats_t *stats;
+
+	isr_prof_process();
+	for (id = 0; id < ISR_PROF_NUM_IDS; id++)
+	{
+		stats = &isr_prof_stats[id];
+		mean = (stats->count > 0) ? (uint32_t)(stats->total / stats->count) : 0;
+		p = appendString(line, end, "[isrprof] ");
+		p = appendString(p, end, isr_prof_names[id]);
+		p = appendUnsignedInt(p, end, " n=", stats->count);
+		p = appendUnsignedInt(p, end, " min=", (stats->count > 0) ? stats->min : 0);
+		p = appendUnsignedInt(p, end, " max=", stats->max);
+		p = appendUnsignedInt(p, end, " mean=", mean);
+		p = appendUnsignedInt(p, end, " pmin=", (stats->count > 1) ? stats->period_min : 0);
+		p = appendUnsignedInt(p, end, " pmax=", stats->period_max);
+		p = appendUnsignedInt(p, end, " ovr=", stats->overruns);
+		p = appendUnsignedInt(p, end, " hist=", stats->hist[0]);
+		for (i = 1; i < ISR_PROF_HIST_BINS; i++)
+		{
+			p = appendUnsignedInt(p, end, ",", stats->hist[i]);
+		}
+		if (p == NULL)
+		{
+			continue;
+		}
+		*p++ = '\r';
+		*p++ = '\n';
+		*p = '\0';
+		debugrepoInsertMsg(line);
+	}
+}
+
+void isr_prof_dump (void)
+{
+	static char msg[2 + sizeof(isr_prof_stats_t)];
+	uint32_t id;
+	const size_t hist_pos = offsetof(isr_prof_stats_t, hist);
+
+	isr_prof_process();
+	for (id = 0; id < ISR_PROF_NUM_IDS; id++)
+	{
+		// Dos mensajes por ISR (campos escalares e histograma) para que la
+		// representación hexadecimal no exceda DEBUGREPO_MSG_MAXLEN
+		msg[0] = (char)id;
+		msg[1] = 0;
+		memcpy(&msg[2], &isr_prof_stats[id], hist_pos);
+		debugrepoInsertBinMsgLen(msg, (uint16_t)(2 + hist_pos));
+		msg[1] = 1;
+		memcpy(&msg[2], isr_prof_stats[id].hist, sizeof(isr_prof_stats[id].hist));
+		debugrepoInsertBinMsgLen(msg, (uint16_t)(2 + sizeof(isr_prof_stats[id].hist)));
+	}
+}
+
+#endif /* ISR_PROF */
+
+/* @} */
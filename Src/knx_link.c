@@ -21,23 +21,88 @@
 /* ---------------- #includes necesarios para este fichero ----------------- */
 
 #include <stdint.h>     // Para los tipos uintXX_t
+#include <string.h>     // Para memset
 #include "knx_link.h"   // Para las declaraciones pÃºblicas de este mÃ³dulo
+#include "knx_phy.h"    // Para knx_phy_reset_req, knx_phy_busmon_req y knx_phy_frame_req
+#include "knx_phy_support.h" // Para las constantes de las tramas KNX
+#include "knx_monitor.h" // Para knx_monitor_start y knx_monitor_poll
+#include "knx_pool.h"   // Para las pilas de descriptores de trama
+#include "knx_stats.h"  // Para los contadores de los niveles físico y de enlace
+#include "task.h"       // Para las secciones críticas de las colas de transmisión
 
 /* --------------------------- Macros privadas ---------------------------- */
 
-#define KNX_LINK_MAX_GRP_ADDRESSES  100
+/* Implementaciones disponibles de la tabla de direcciones de grupo */
+#define KNX_LINK_GRP_TABLE_ARRAY    0   /**< Array sin ordenar, búsqueda lineal O(n)          */
+#define KNX_LINK_GRP_TABLE_BITMAP   1   /**< Mapa de 64K bits (8 KB) indexado por la dirección,
+                                             búsqueda O(1)                                     */
+#define KNX_LINK_GRP_TABLE_SORTED   2   /**< Array ordenado sin duplicados, búsqueda binaria
+                                             O(log2(n))                                        */
 
-#define KNX_LINK_MAX_LSDU    255
+/* Implementación de la tabla de direcciones de grupo utilizada */
+#define KNX_LINK_GRP_TABLE          KNX_LINK_GRP_TABLE_SORTED
+
+#define KNX_LINK_MAX_GRP_ADDRESSES  1024
+
+/* Número de palabras de 32 bits del mapa de bits (una por cada 32 direcciones de grupo) */
+#define KNX_LINK_GRP_BITMAP_WORDS   ((0xFFFFU + 1U) / 32U)
+
+/* Posición de la LSDU en knx_link_tx_frame_t.bytes: tras la cabecera más larga (trama extendida) */
+#define KNX_LINK_TX_LSDU_POS        7
+
+/* Señal con la que la tarea que lee Ph_reset.con() avisa del resultado del
+   reset a la que espera detrás de ella (distinta de las de knx_phy.c) */
+#define KNX_LINK_SIGNAL_RESET_CON   ((int32_t)0x80)
+
+/* Máximo de octetos de LSDU que caben en una trama estándar (LG de 4 bits) */
+#define KNX_LINK_STD_MAX_LSDU       16
+
+/* Tamaño de bytes en los descriptores para tramas estándar (la cabecera
+   reserva siempre el octeto extra de la extendida) y extendidas. El checksum
+   no se guarda: lo añade knx_phy_frame_req */
+#define KNX_LINK_TX_STD_FRAME_LEN   (KNX_LINK_TX_LSDU_POS + KNX_LINK_STD_MAX_LSDU)
+#define KNX_LINK_TX_EXT_FRAME_LEN   (KNX_LINK_TX_LSDU_POS + KNX_LINK_TX_MAX_LSDU)
+
+#if (KNX_LINK_TX_MAX_FRAME_LEN > KNX_PHY_TX_MAX_FRAME_LEN) || (KNX_LINK_TX_MAX_LSDU + 8 > KNX_LINK_TX_MAX_FRAME_LEN) || \
+    (KNX_LINK_TX_EXT_FRAME_LEN >= KNX_LINK_TX_MAX_FRAME_LEN)
+#error "Las tramas de knx_link_tx_frame_t deben caber en knx_phy_frame_req"
+#endif
+
+#if (KNX_STATS_PRIORITIES != KNX_LINK_PRIORITIES)
+#error "KNX_STATS_PRIORITIES debe coincidir con KNX_LINK_PRIORITIES"
+#endif
 
 /* ----------------------- Tipos de datos privados ------------------------ */
 
+/**
+ * Tipo estructurado con la cola de transmisión de una prioridad
+ */
+struct knx_link_tx_queue_s {
+    knx_link_tx_frame_t *frames[KNX_LINK_TX_QUEUE_LEN]; /**< Tramas pendientes (circular)          */
+    uint32_t head;                                      /**< Posición de la más antigua            */
+    knx_link_tx_stats_t stats;                          /**< Estadísticas (stats.depth = ocupación) */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_link_tx_queue_s knx_link_tx_queue_t;
+
 /**
  * Tipo estructurado para la gestiÃ³n de direcciones de grupo
  */
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_BITMAP)
+struct knx_link_grp_addresses_s {
+    uint32_t used;                                      /**< Entradas en uso                          */
+    uint32_t bitmap[KNX_LINK_GRP_BITMAP_WORDS];         /**< Bit n a 1 si la dirección n está en la tabla */
+};
+#else
 struct knx_link_grp_addresses_s {
     uint32_t used;                                      /**< Entradas en uso      */
-    uint16_t addresses[KNX_LINK_MAX_GRP_ADDRESSES];   /**< Entradas almacenadas */
+    uint16_t addresses[KNX_LINK_MAX_GRP_ADDRESSES];   /**< Entradas almacenadas
+                                                             (en orden creciente con
+                                                             KNX_LINK_GRP_TABLE_SORTED) */
 };
+#endif
 /**
  * RedefiniciÃ³n con typedef para usar una Ãºnica palabra
  */
@@ -55,47 +120,20 @@ struct knx_link_poll_address_s {
  */
 typedef struct knx_link_poll_address_s knx_link_poll_address_t;
 
-
-
-
-// written by me from there
-
-struct knx_link_dest_address_s {
-   uint16_t address;
-   uint8_t address_type; /* flag 0/1, other values are illegal */
-};
-
-typedef struct knx_link_dest_address_s knx_link_dest_address_t;
-
-
-struct knx_link_lsdu_s {
-   uint8_t lsdu_3bits_used; /* flag 0/1 */
-   uint8_t lsdu_3bits; /* actual lsdu bits if prev flag is 1 */
-   uint8_t lsdu_length;
-   uint8_t lsdu_bytes[KNX_LINK_MAX_LSDU];
-
-   // lsdu_3bits_used only for standard frame
-   // lsdu_bytes[] : don't need to check the length because lsdu_length type is uint8_t
-   // lsdu_3bits is 0 or 1 : for standard frame it's 1 and otherwise 0 ? error if >= 2 ?
-
-   // lsdu_3bits_used : 0 or 1 for standard frame
-   // lsdu_3bits_used : 0 for extended frame
-
-};
-
-typedef struct knx_link_lsdu_s knx_link_lsdu_t;
-
-
-struct knx_link_data_req_params_s {
-   uint8_t confirmation_status; /* Used for confirmation primitive only  */
-   uint16_t source_address; /* Used for indication primitive only */
-   uint8_t repetitions;
-   uint8_t priority;
-   knx_link_dest_address_t dest_address;
-   knx_link_lsdu_t lsdu;
+/**
+ * Tipo estructurado con una entrada de la caché de tramas recibidas
+ */
+struct knx_link_rx_dup_s {
+    uint32_t addresses;             /**< SA (16 bits altos) y DA (16 bits bajos)        */
+    uint32_t tick;                  /**< Instante de la última entrega (ms)             */
+    uint8_t  ctrl;                  /**< CTRL con REP = 1 (0 = entrada libre)           */
+    uint8_t  chk;                   /**< CHK que tendría la trama con REP = 1           */
 };
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_link_rx_dup_s knx_link_rx_dup_t;
 
-typedef struct knx_link_data_req_params_s knx_link_data_req_params_t;
 
 /* ------------------------- Variables privadas --------------------------- */
 
@@ -112,10 +150,22 @@ static uint16_t knx_link_ind_address = 0xFF;
  * DirecciÃ³n de polling de este sistema
  */
 static knx_link_poll_address_t knx_link_poll_address;
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_SORTED)
+/**
+ * Tablas de direcciones de grupo de este sistema
+ *
+ * La ISR de recepción consulta sólo la publicada en knx_link_grp_table. Las
+ * altas se preparan en la otra copia y se publican al terminar cambiando el
+ * puntero, de forma que la ISR nunca ve una tabla a medio desplazar u ordenar
+ */
+static knx_link_grp_addresses_t knx_link_grp_tables[2];
+static knx_link_grp_addresses_t * volatile knx_link_grp_table = &knx_link_grp_tables[0];
+#else
 /**
  * Tabla de direcciones de grupo de este sistema
  */
 static knx_link_grp_addresses_t knx_link_grp_addresses;
+#endif
 /**
  * Estado del nivel de enlace de KNX
  *
@@ -125,14 +175,45 @@ static knx_link_grp_addresses_t knx_link_grp_addresses;
  * de @ref knx_link_init_comm_state()
  */
 static knx_link_comm_state_t knx_link_comm_state = KNX_LINK_ILLEGAL_STATE;
-
-// written by me from here
-
-static knx_link_dest_address_t knx_link_dest_address;
-
-static knx_link_lsdu_t knx_link_lsdu;
-
-static knx_link_data_req_params_t knx_link_data_req_params;
+/**
+ * Descriptores de trama para L_Data.req, para tramas estándar y para tramas extendidas
+ */
+KNX_POOL_STORAGE(knx_link_tx_std_storage, sizeof(knx_link_tx_frame_t) + KNX_LINK_TX_STD_FRAME_LEN, KNX_LINK_TX_STD_FRAMES);
+KNX_POOL_STORAGE(knx_link_tx_ext_storage, sizeof(knx_link_tx_frame_t) + KNX_LINK_TX_EXT_FRAME_LEN, KNX_LINK_TX_EXT_FRAMES);
+static knx_pool_t knx_link_tx_std_pool;
+static knx_pool_t knx_link_tx_ext_pool;
+/**
+ * Colas de transmisión, indexadas por prioridad (KNX_LINK_PRIORITY_SYSTEM = 0
+ * es la más prioritaria)
+ */
+static knx_link_tx_queue_t knx_link_tx_queues[KNX_LINK_PRIORITIES];
+/**
+ * Caché de tramas recibidas entregadas (sólo la usa la ISR de recepción)
+ */
+static knx_link_rx_dup_t knx_link_rx_dups[KNX_LINK_RX_DUP_ENTRIES];
+/**
+ * Prioridad + 1 de la trama entregada a la TP-UART pendiente de L_Data.con
+ * (0 si no hay ninguna) e instante (ms) en que se entregó
+ */
+static uint8_t knx_link_tx_in_flight;
+static uint32_t knx_link_tx_sent_tick;
+/**
+ * Transmisión limitada a una trama cada KNX_LINK_HEALTH_PERIOD_MS (aviso TW de la TP-UART)
+ */
+static volatile uint8_t knx_link_tx_throttle;
+/**
+ * Estado de la supervisión de la TP-UART: contadores PE y TE del periodo
+ * anterior y periodos seguidos con errores nuevos
+ */
+static uint32_t knx_link_health_pe;
+static uint32_t knx_link_health_te;
+static uint32_t knx_link_health_strikes;
+/**
+ * Tarea que está leyendo Ph_reset.con() y tarea que espera de ella el
+ * resultado del reset (NULL si ninguna). Se modifican en sección crítica
+ */
+static osThreadId volatile knx_link_reset_con_reader;
+static osThreadId volatile knx_link_reset_con_waiter;
 
 
 /* ----------------- DeclaraciÃ³n de funciones privadas -------------------- */
@@ -191,23 +272,87 @@ static void knx_link_init_comm_state (void);
  */
 static void knx_link_set_comm_state (knx_link_comm_state_t new_state); 
 
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_SORTED)
+/**
+ * @brief Ordenar y eliminar duplicados de una tabla de direcciones de grupo
+ * @param[in,out] table Tabla (no publicada)
+ *
+ * Ordena en orden creciente las entradas en uso de la tabla (heapsort,
+ * sin recursión ni memoria adicional) y elimina las direcciones repetidas,
+ * actualizando el número de entradas en uso.
+ *
+ * @returns Nada
+ */
+static void knx_link_sort_grp_addresses (knx_link_grp_addresses_t *table);
 
-// written by me from here
-// auxiliary functions
-// can embed all validity checks around these elements (da, at, lsdu)
-
-
-int knx_link_check_da (knx_link_dest_address_t *ptr_da);
-
-int knx_link_check_lsdu_std (knx_link_lsdu_t *ptr_lsdu); // Check lsdu fields for validity on a standard frame
+/**
+ * @brief Preparar la copia no publicada de la tabla de direcciones de grupo
+ *
+ * Copia en ella las entradas en uso de la tabla publicada. Las altas se
+ * hacen siempre desde una única tarea, así que nadie más la modifica.
+ *
+ * @returns Copia sobre la que aplicar las altas
+ */
+static knx_link_grp_addresses_t *knx_link_grp_shadow (void);
 
-int knx_link_check_lsdu_ext (knx_link_lsdu_t *ptr_lsdu); // Check lsdu fields for validity on a extended frame
+/**
+ * @brief Publicar una tabla de direcciones de grupo para la ISR de recepción
+ * @param[in] table Tabla preparada con @ref knx_link_grp_shadow
+ *
+ * @returns Nada
+ */
+static void knx_link_grp_publish (knx_link_grp_addresses_t *table);
+#endif
 
+/**
+ * @brief Inicializar las pilas de descriptores libres para L_Data.req
+ *
+ * Esta funciÃ³n sÃ³lo es llamada desde @ref knx_link_init durante
+ * la inicializaciÃ³n del nivel de enlace
+ *
+ * @returns Nada
+ */
+static void knx_link_init_tx_pool (void);
 
-int knx_link_data_req_std (knx_link_data_req_params_t *ptr_req);
+/**
+ * @brief Completar la cabecera de una trama a enviar
+ * @param[in]  frame Descriptor con los parámetros y la LSDU ya escritos
+ * @param[out] len   Longitud de la trama sin el checksum (CTRL ... último octeto de LSDU)
+ *
+ * Escribe la cabecera justo delante de la LSDU, sin moverla: la trama
+ * estándar empieza en bytes[1] y la extendida en bytes[0]
+ *
+ * @returns Inicio de la trama dentro de frame->bytes
+ */
+static const uint8_t *knx_link_tx_build (knx_link_tx_frame_t *frame, uint8_t *len);
 
-int knx_link_data_req_ext (knx_link_data_req_params_t *ptr_req);
+/**
+ * @brief Entregar a la TP-UART la siguiente trama pendiente
+ *
+ * Si la TP-UART no tiene ninguna trama sin confirmar (o la última lleva más
+ * de KNX_LINK_TX_CON_TIMEOUT_MS sin L_Data.con), entrega la más antigua de
+ * la cola de mayor prioridad con tramas pendientes. Si la TP-UART está
+ * ocupada la trama sigue en su cola hasta el siguiente aviso.
+ * Debe llamarse dentro de una sección crítica.
+ *
+ * @returns Nada
+ */
+static void knx_link_tx_dispatch (void);
 
+/**
+ * @brief Buscar una trama en la caché de tramas recibidas
+ * @param[in] ctrl Campo CTRL de la trama
+ * @param[in] sa   Source address
+ * @param[in] da   Destination address
+ * @param[in] chk  Octeto CHK de la trama
+ * @param[in] now  Instante de recepción en ms
+ *
+ * CTRL y CHK se normalizan a los de la trama original (REP = 1): el emisor
+ * sólo cambia REP al repetir, y con él el bit 5 de CHK.
+ *
+ * @returns Entrada vigente de la trama, o NULL si no está
+ */
+static knx_link_rx_dup_t *knx_link_rx_dup_find (uint8_t ctrl, uint16_t sa, uint16_t da, uint8_t chk, uint32_t now);
 
 
 
@@ -226,8 +371,16 @@ static void knx_link_init_poll_address (uint16_t grp_address, uint16_t slot_numb
 
 void knx_link_init_grp_addresses (void)
 {
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_SORTED)
+	knx_link_grp_tables[0].used = 0;
+	knx_link_grp_tables[1].used = 0;
+	knx_link_grp_table = &knx_link_grp_tables[0];
+#else
 	knx_link_grp_addresses.used = 0;
-	// knx_link_grp_addresses.addresses[0];
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_BITMAP)
+	memset(knx_link_grp_addresses.bitmap, 0, sizeof(knx_link_grp_addresses.bitmap));
+#endif
+#endif
 }
 
 static void knx_link_init_comm_state (void)
@@ -240,84 +393,205 @@ static void knx_link_set_comm_state (knx_link_comm_state_t new_state)
 	knx_link_comm_state = new_state;
 }
 
-
-// written by me from here
-
-int knx_link_check_da (knx_link_dest_address_t *ptr_da)
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_SORTED)
+static void knx_link_sort_grp_addresses (knx_link_grp_addresses_t *table)
 {
-	if(ptr_da -> address_type >= 2)
+	uint16_t *a = table->addresses;
+	uint32_t n = table->used;
+	uint32_t start, end, root, child, i, j;
+	uint16_t tmp;
+
+	// Construir el montículo (máximo en a[0])
+	for (start = n / 2; start-- > 0; )
 	{
-		return 0;
+		for (root = start; (child = 2 * root + 1) < n; root = child)
+		{
+			if ((child + 1 < n) && (a[child] < a[child + 1]))
+			{
+				child++;
+			}
+			if (a[root] >= a[child])
+			{
+				break;
+			}
+			tmp = a[root]; a[root] = a[child]; a[child] = tmp;
+		}
 	}
-	else
+	// Extraer sucesivamente el máximo al final de la zona ordenada
+	for (end = n; end-- > 1; )
 	{
-		return 1;
+		tmp = a[0]; a[0] = a[end]; a[end] = tmp;
+		for (root = 0; (child = 2 * root + 1) < end; root = child)
+		{
+			if ((child + 1 < end) && (a[child] < a[child + 1]))
+			{
+				child++;
+			}
+			if (a[root] >= a[child])
+			{
+				break;
+			}
+			tmp = a[root]; a[root] = a[child]; a[child] = tmp;
+		}
+	}
+	// Eliminar duplicados (quedan consecutivos tras ordenar)
+	for (i = 0, j = 0; i < n; i++)
+	{
+		if ((j == 0) || (a[j - 1] != a[i]))
+		{
+			a[j++] = a[i];
+		}
 	}
+	table->used = j;
 }
 
+static knx_link_grp_addresses_t *knx_link_grp_shadow (void)
+{
+	const knx_link_grp_addresses_t *published = knx_link_grp_table;
+	knx_link_grp_addresses_t *table = (published == &knx_link_grp_tables[0]) ? &knx_link_grp_tables[1] : &knx_link_grp_tables[0];
+
+	memcpy(table->addresses, published->addresses, published->used * sizeof(table->addresses[0]));
+	table->used = published->used;
+	return table;
+}
 
-int knx_link_check_lsdu_std (knx_link_lsdu_t *ptr_lsdu)		// Check lsdu fields for validity on a standard frame
+static void knx_link_grp_publish (knx_link_grp_addresses_t *table)
 {
-	if(ptr_lsdu -> lsdu_3bits_used >= 2)
-	{
-		return 0;
-	}
-	else
-	{
-		return 1;
-	}
+	// La ISR termina cualquier búsqueda antes de que esta tarea vuelva a
+	// ejecutarse, así que tras el cambio nadie lee ya la tabla anterior
+	taskENTER_CRITICAL();
+	knx_link_grp_table = table;
+	taskEXIT_CRITICAL();
 }
+#endif
 
 
-int knx_link_check_lsdu_ext (knx_link_lsdu_t *ptr_lsdu) 	// Check lsdu fields for validity on a extended frame
+static void knx_link_init_tx_pool (void)
 {
-	if(ptr_lsdu -> lsdu_3bits_used != 0)	// error because lsdu_3bits_used is not used for extended frame
+	knx_pool_init(&knx_link_tx_std_pool, "link_tx_std", knx_link_tx_std_storage,
+	              sizeof(knx_link_tx_frame_t) + KNX_LINK_TX_STD_FRAME_LEN, KNX_LINK_TX_STD_FRAMES);
+	knx_pool_init(&knx_link_tx_ext_pool, "link_tx_ext", knx_link_tx_ext_storage,
+	              sizeof(knx_link_tx_frame_t) + KNX_LINK_TX_EXT_FRAME_LEN, KNX_LINK_TX_EXT_FRAMES);
+	memset(knx_link_tx_queues, 0, sizeof(knx_link_tx_queues));
+	knx_link_tx_in_flight = 0;
+	memset(knx_link_rx_dups, 0, sizeof(knx_link_rx_dups));
+}
+
+static const uint8_t *knx_link_tx_build (knx_link_tx_frame_t *frame, uint8_t *len)
+{
+	uint8_t *start;
+	uint8_t *addr;
+	uint8_t ctrl;
+	uint16_t sa = knx_link_get_ind_address();
+
+	ctrl = KNX_DATA_FRAME_CTRL_FIXED_VALUE | KNX_DATA_FRAME_CTRL_REP__NONREPEATED |
+	       ((frame->priority << KNX_DATA_FRAME_CTRL_PRIO_SHIFT) & KNX_DATA_FRAME_CTRL_PRIO_MASK);
+	if (frame->lsdu_len <= KNX_LINK_STD_MAX_LSDU)
 	{
-		return 0;
+		// Trama estándar: CTRL SA SA DA DA AT/LSDU/LG
+		start = &frame->bytes[KNX_LINK_TX_LSDU_POS - 6];
+		start[0] = ctrl | KNX_DATA_FRAME_CTRL_FT__STANDARD;
+		start[5] = ((frame->at == KNX_LINK_AT_GROUP) ? KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_GROUP : KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_INDIVIDUAL) |
+		           ((frame->hop_count << KNX_STD_FRAME_ATLSDULG_LSDU_SHIFT) & KNX_STD_FRAME_ATLSDULG_LSDU_MASK) |
+		           ((frame->lsdu_len - 1) & KNX_STD_FRAME_ATLSDULG_LG_MASK);
+		addr = &start[1];
 	}
 	else
 	{
-		return 1;
+		// Trama extendida: CTRL CTRLE SA SA DA DA LG
+		start = &frame->bytes[KNX_LINK_TX_LSDU_POS - 7];
+		start[0] = ctrl | KNX_DATA_FRAME_CTRL_FT__EXTENDED;
+		start[1] = ((frame->at == KNX_LINK_AT_GROUP) ? KNX_EXT_FRAME_CTRLE_AT_SHIFT__DA_GROUP : KNX_EXT_FRAME_CTRLE_AT_SHIFT__DA_INDIVIDUAL) |
+		           ((frame->hop_count << KNX_EXT_FRAME_CTRLE_HOP_SHIFT) & KNX_EXT_FRAME_CTRLE_HOP_MASK);
+		start[6] = frame->lsdu_len - 1;
+		addr = &start[2];
 	}
+	addr[0] = (uint8_t)(sa >> 8);
+	addr[1] = (uint8_t)sa;
+	addr[2] = (uint8_t)(frame->da >> 8);
+	addr[3] = (uint8_t)frame->da;
+
+	// CHK lo calcula knx_phy_frame_req al intercalar los prefijos U_L_DATA
+	*len = (uint8_t)(&frame->lsdu[frame->lsdu_len] - start);
+	return start;
 }
 
-/*
-int knx_link_data_req_std (knx_link_data_req_params_t *ptr_req)
+static void knx_link_tx_dispatch (void)
 {
-	// The Control field shall indicate the type of the request Frame: L_Data_Standard Frame L_Data_Extended Frame
-	// Bytes 2 and 3 : for the priority (standard, urgent, normal, low)
-
-	if(ptr_req -> lsdu.lsdu_3bits_used >= 2)   // can be 0 or 1 for standard frame
+	knx_link_tx_queue_t *queue;
+	knx_link_tx_frame_t *frame;
+	const uint8_t *start;
+	uint8_t len;
+	uint32_t prio, latency;
+	uint32_t now = osKernelSysTick();
+
+	if (knx_link_tx_in_flight != 0)
 	{
-		return 0;	// error because lsdu_3bits_used must be 0 or 1 for standard frame
+		if ((now - knx_link_tx_sent_tick) < KNX_LINK_TX_CON_TIMEOUT_MS)
+		{
+			return;
+		}
+		// La confirmación se ha perdido (p.ej. reset de la TP-UART): no bloquear las colas
+		knx_link_tx_queues[knx_link_tx_in_flight - 1].stats.con_timeouts++;
+		KNX_STATS_TX_INC(con_timeouts);
+		knx_link_tx_in_flight = 0;
 	}
-	else
+	for (prio = 0; prio < KNX_LINK_PRIORITIES; prio++)
 	{
-		return 1;
+		queue = &knx_link_tx_queues[prio];
+		if (queue->stats.depth == 0)
+		{
+			continue;
+		}
+		if (knx_link_tx_throttle && ((now - knx_link_tx_sent_tick) < KNX_LINK_HEALTH_PERIOD_MS))
+		{
+			// Aviso de temperatura: la siguiente la entregará knx_link_health_poll
+			KNX_STATS_TX_INC(throttled);
+			return;
+		}
+		frame = queue->frames[queue->head];
+		start = knx_link_tx_build(frame, &len);
+		if (knx_phy_frame_req(start, len) != KNX_PHY_DATA_REQ_OK)
+		{
+			// TP-UART ocupada (o en reset): la trama sigue la primera de su cola
+			return;
+		}
+		queue->head = (queue->head + 1) % KNX_LINK_TX_QUEUE_LEN;
+		queue->stats.depth--;
+		queue->stats.sent++;
+		KNX_STATS_TX_INC(frames[prio]);
+		latency = now - frame->tick;
+		queue->stats.latency_last = latency;
+		queue->stats.latency_total += latency;
+		if (latency > queue->stats.latency_max)
+		{
+			queue->stats.latency_max = latency;
+		}
+		knx_link_tx_in_flight = (uint8_t)(prio + 1);
+		knx_link_tx_sent_tick = now;
+		// knx_phy_frame_req ya ha copiado la trama con sus prefijos U_L_DATA
+		knx_link_data_req_free(frame);
+		return;
 	}
-
-	// For the control field : if bit7 (frame type) == 1 --> standard frame
-
-	// if all is ok, send confirmation status
 }
 
-int knx_link_data_req_ext (knx_link_data_req_params_t *ptr_req)
+static knx_link_rx_dup_t *knx_link_rx_dup_find (uint8_t ctrl, uint16_t sa, uint16_t da, uint8_t chk, uint32_t now)
 {
-	// confirmation_status, source_address, repetitions, priority, dest_address, lsdu
+	uint32_t addresses = (((uint32_t)sa) << 16) | da;
+	uint32_t i;
 
-	// framing error, parity error, bit error
-
-	if(ptr_req -> lsdu.lsdu_3bits_used != 0)
+	chk ^= (ctrl & KNX_DATA_FRAME_CTRL_REP_MASK) ^ KNX_DATA_FRAME_CTRL_REP__NONREPEATED;
+	ctrl |= KNX_DATA_FRAME_CTRL_REP__NONREPEATED;
+	for (i = 0; i < KNX_LINK_RX_DUP_ENTRIES; i++)
 	{
-		return 0;	// error because lsdu_3bits_used must not be used for standard frame
-	}
-	else
-	{
-		return 1;
+		if ((knx_link_rx_dups[i].addresses == addresses) && (knx_link_rx_dups[i].ctrl == ctrl) &&
+		    (knx_link_rx_dups[i].chk == chk) && ((now - knx_link_rx_dups[i].tick) < KNX_LINK_RX_DUP_EXPIRY_MS))
+		{
+			return &knx_link_rx_dups[i];
+		}
 	}
-
+	return NULL;
 }
-*/
 
 
 /* ---------------- ImplementaciÃ³n de funciones pÃºblicas ------------------ */
@@ -344,13 +618,123 @@ uint16_t knx_link_get_poll_slot_number (void)
 
 
 
+#if (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_BITMAP)
+
 uint32_t knx_link_add_grp_address (uint16_t grp_address)
 {
+	uint32_t mask = ((uint32_t)1) << (grp_address & 0x1F);
 
-	// check if the max number of addresses is not reached 'KNX_LINK_MAX_GRP_ADDRESSES  100'
-	if(sizeof(knx_link_grp_addresses.used)<100)
+	// El mapa de bits cubre todo el espacio de direcciones: nunca falta memoria
+	if ((knx_link_grp_addresses.bitmap[grp_address >> 5] & mask) == 0)
 	{
-		knx_link_grp_addresses.addresses[(knx_link_grp_addresses.used)+1] = grp_address;	// add the group address
+		knx_link_grp_addresses.bitmap[grp_address >> 5] |= mask;
+		knx_link_grp_addresses.used++;
+	}
+	return 1;
+}
+
+uint32_t knx_link_exists_grp_address (uint16_t grp_address)
+{
+	// Un único acceso a memoria, independiente del número de direcciones almacenadas
+	return (knx_link_grp_addresses.bitmap[grp_address >> 5] >> (grp_address & 0x1F)) & 1U;
+}
+
+uint32_t knx_link_add_grp_addresses (const uint16_t *list, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		knx_link_add_grp_address(list[i]);
+	}
+	return 1;
+}
+
+#elif (KNX_LINK_GRP_TABLE == KNX_LINK_GRP_TABLE_SORTED)
+
+uint32_t knx_link_add_grp_address (uint16_t grp_address)
+{
+	knx_link_grp_addresses_t *table;
+	uint32_t i;
+
+	if (knx_link_exists_grp_address(grp_address))
+	{
+		return 1;
+	}
+	if (knx_link_grp_table->used >= KNX_LINK_MAX_GRP_ADDRESSES)
+	{
+		return 0;
+	}
+	// Desplazar las entradas mayores para mantener la tabla ordenada
+	table = knx_link_grp_shadow();
+	for (i = table->used; (i > 0) && (table->addresses[i - 1] > grp_address); i--)
+	{
+		table->addresses[i] = table->addresses[i - 1];
+	}
+	table->addresses[i] = grp_address;
+	table->used++;
+	knx_link_grp_publish(table);
+	return 1;
+}
+
+uint32_t knx_link_add_grp_addresses (const uint16_t *list, size_t n)
+{
+	knx_link_grp_addresses_t *table = knx_link_grp_shadow();
+	uint32_t result = 1;
+	size_t i;
+
+	// Añadir al final sin ordenar; las que no caben se descartan
+	for (i = 0; i < n; i++)
+	{
+		if (table->used >= KNX_LINK_MAX_GRP_ADDRESSES)
+		{
+			// Puede que al eliminar duplicados quede hueco: compactar y reintentar
+			knx_link_sort_grp_addresses(table);
+			if (table->used >= KNX_LINK_MAX_GRP_ADDRESSES)
+			{
+				result = 0;
+				break;
+			}
+		}
+		table->addresses[table->used++] = list[i];
+	}
+	// Ordenar y eliminar duplicados una única vez para todo el lote
+	knx_link_sort_grp_addresses(table);
+	knx_link_grp_publish(table);
+	return result;
+}
+
+uint32_t knx_link_exists_grp_address (uint16_t grp_address)
+{
+	const knx_link_grp_addresses_t *table = knx_link_grp_table;
+	const uint16_t *base = table->addresses;
+	uint32_t n = table->used;
+	uint32_t half;
+
+	if (n == 0)
+	{
+		return 0;
+	}
+	// Búsqueda binaria sin saltos dependientes de los datos: el número de
+	// iteraciones sólo depende de n (ceil(log2(n))) y la selección de la
+	// mitad se resuelve con una asignación condicional
+	while (n > 1)
+	{
+		half = n >> 1;
+		base = (base[half] <= grp_address) ? &base[half] : base;
+		n -= half;
+	}
+	return (*base == grp_address) ? 1 : 0;
+}
+
+#else
+
+uint32_t knx_link_add_grp_address (uint16_t grp_address)
+{
+	// check if the max number of addresses is not reached 'KNX_LINK_MAX_GRP_ADDRESSES'
+	if(knx_link_grp_addresses.used < KNX_LINK_MAX_GRP_ADDRESSES)
+	{
+		knx_link_grp_addresses.addresses[knx_link_grp_addresses.used] = grp_address;	// add the group address
 		knx_link_grp_addresses.used++;
 		return 1;	// it's ok
 	}
@@ -362,20 +746,223 @@ uint32_t knx_link_add_grp_address (uint16_t grp_address)
 
 uint32_t knx_link_exists_grp_address (uint16_t grp_address)
 {
-	// make a loop to check each address
+	uint32_t i;
 
-	for(int i = 0; i < (knx_link_grp_addresses.used)+1; i++){
-
-		if(knx_link_grp_addresses.addresses == grp_address)  // if the address is stock
+	// make a loop to check each address
+	for(i = 0; i < knx_link_grp_addresses.used; i++)
+	{
+		if(knx_link_grp_addresses.addresses[i] == grp_address)  // if the address is stock
 		{
 			return 1;
 		}
+	}
+	return 0;	// if the address is not stock
+}
 
-		else	// if the address is not stock
+uint32_t knx_link_add_grp_addresses (const uint16_t *list, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!knx_link_add_grp_address(list[i]))
 		{
 			return 0;
 		}
 	}
+	return 1;
+}
+
+#endif
+
+
+
+knx_link_tx_frame_t *knx_link_data_req_alloc (uint8_t lsdu_len)
+{
+	knx_link_tx_frame_t *frame;
+	uint8_t lsdu_max;
+
+	if ((lsdu_len == 0) || (lsdu_len > KNX_LINK_TX_MAX_LSDU))
+	{
+		return NULL;
+	}
+	if (lsdu_len <= KNX_LINK_STD_MAX_LSDU)
+	{
+		frame = (knx_link_tx_frame_t *)knx_pool_alloc(&knx_link_tx_std_pool);
+		lsdu_max = KNX_LINK_STD_MAX_LSDU;
+	}
+	else
+	{
+		frame = (knx_link_tx_frame_t *)knx_pool_alloc(&knx_link_tx_ext_pool);
+		lsdu_max = KNX_LINK_TX_MAX_LSDU;
+	}
+	if (frame != NULL)
+	{
+		frame->priority = KNX_LINK_PRIORITY_LOW;
+		frame->at = KNX_LINK_AT_GROUP;
+		frame->hop_count = KNX_LINK_DEFAULT_HOP_COUNT;
+		frame->da = 0;
+		frame->lsdu_len = lsdu_len;
+		frame->lsdu_max = lsdu_max;
+		frame->lsdu = &frame->bytes[KNX_LINK_TX_LSDU_POS];
+	}
+	return frame;
+}
+
+void knx_link_data_req_free (knx_link_tx_frame_t *frame)
+{
+	if (frame == NULL)
+	{
+		return;
+	}
+	knx_pool_free((frame->lsdu_max == KNX_LINK_STD_MAX_LSDU) ? &knx_link_tx_std_pool : &knx_link_tx_ext_pool, frame);
+}
+
+uint32_t knx_link_rx_is_duplicate (uint8_t ctrl, uint16_t sa, uint16_t da, uint8_t chk, uint32_t now)
+{
+	if ((ctrl & KNX_DATA_FRAME_CTRL_REP_MASK) != KNX_DATA_FRAME_CTRL_REP__REPEATED)
+	{
+		return 0;
+	}
+	return (knx_link_rx_dup_find(ctrl, sa, da, chk, now) != NULL) ? 1 : 0;
+}
+
+void knx_link_rx_delivered (uint8_t ctrl, uint16_t sa, uint16_t da, uint8_t chk, uint32_t now)
+{
+	knx_link_rx_dup_t *entry = knx_link_rx_dup_find(ctrl, sa, da, chk, now);
+	uint32_t i;
+
+	if (entry == NULL)
+	{
+		// Entrada libre o caducada; si no hay ninguna, la más antigua
+		entry = &knx_link_rx_dups[0];
+		for (i = 0; i < KNX_LINK_RX_DUP_ENTRIES; i++)
+		{
+			if ((knx_link_rx_dups[i].ctrl == 0) || ((now - knx_link_rx_dups[i].tick) >= KNX_LINK_RX_DUP_EXPIRY_MS))
+			{
+				entry = &knx_link_rx_dups[i];
+				break;
+			}
+			if ((now - knx_link_rx_dups[i].tick) > (now - entry->tick))
+			{
+				entry = &knx_link_rx_dups[i];
+			}
+		}
+		entry->addresses = (((uint32_t)sa) << 16) | da;
+		entry->ctrl = ctrl | KNX_DATA_FRAME_CTRL_REP__NONREPEATED;
+		entry->chk = chk ^ (ctrl & KNX_DATA_FRAME_CTRL_REP_MASK) ^ KNX_DATA_FRAME_CTRL_REP__NONREPEATED;
+	}
+	entry->tick = now;
+}
+
+
+
+uint32_t knx_link_data_req (knx_link_tx_frame_t *frame)
+{
+	knx_link_tx_queue_t *queue;
+	uint32_t result = KNX_LINK_DATA_REQ_OK;
+
+	if ((frame == NULL) || (frame->lsdu_len == 0) || (frame->lsdu_len > frame->lsdu_max) ||
+	    (frame->priority > KNX_LINK_PRIORITY_LOW) || (frame->at > KNX_LINK_AT_GROUP) ||
+	    (knx_link_comm_state != KNX_LINK_NORMAL_STATE))
+	{
+		return KNX_LINK_DATA_REQ_ERROR;
+	}
+	queue = &knx_link_tx_queues[frame->priority];
+	frame->tick = osKernelSysTick();
+
+	// Las ISR de la UART también entregan tramas (knx_link_tx_event)
+	taskENTER_CRITICAL();
+	if (queue->stats.depth >= KNX_LINK_TX_QUEUE_LEN)
+	{
+		queue->stats.rejected++;
+		KNX_STATS_TX_INC(queue_overflows);
+		result = KNX_LINK_DATA_REQ_BUSY;
+	}
+	else
+	{
+		queue->frames[(queue->head + queue->stats.depth) % KNX_LINK_TX_QUEUE_LEN] = frame;
+		queue->stats.depth++;
+		queue->stats.queued++;
+		if (queue->stats.depth > queue->stats.depth_hwm)
+		{
+			queue->stats.depth_hwm = queue->stats.depth;
+		}
+		knx_link_tx_dispatch();
+	}
+	taskEXIT_CRITICAL();
+	return result;
+}
+
+void knx_link_tx_event (uint32_t confirmed)
+{
+	UBaseType_t saved;
+
+	saved = taskENTER_CRITICAL_FROM_ISR();
+	if (confirmed)
+	{
+		knx_link_tx_in_flight = 0;
+	}
+	knx_link_tx_dispatch();
+	taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+void knx_link_health_poll (void)
+{
+	knx_stats_t stats;
+	uint32_t errors;
+
+	if (knx_link_comm_state == KNX_LINK_INIT_STATE)
+	{
+		// Recoger la confirmación de un reset que no llegó dentro de la espera
+		knx_link_wait_reset_con(0);
+	}
+	if (knx_link_comm_state == KNX_LINK_MONITOR_STATE)
+	{
+		// Sin esto la marca de tiempo de la captura pierde las vueltas del DWT
+		knx_monitor_poll();
+		return;
+	}
+	if ((knx_link_comm_state != KNX_LINK_NORMAL_STATE) && (knx_link_comm_state != KNX_LINK_STOP_STATE))
+	{
+		return;
+	}
+	knx_stats_read(&stats);
+	errors = (stats.rx.state_pe - knx_link_health_pe) + (stats.rx.state_te - knx_link_health_te);
+	knx_link_health_pe = stats.rx.state_pe;
+	knx_link_health_te = stats.rx.state_te;
+	knx_link_health_strikes = (errors != 0) ? (knx_link_health_strikes + 1) : 0;
+	knx_link_tx_throttle = (knx_phy_get_tpuart_state() & KNX_TPUART_U_STATE_TW) ? 1 : 0;
+
+	if ((knx_link_health_strikes >= KNX_LINK_HEALTH_MAX_STRIKES) || (knx_link_comm_state == KNX_LINK_STOP_STATE))
+	{
+		knx_link_health_strikes = 0;
+		taskENTER_CRITICAL();
+		KNX_STATS_TX_INC(health_resets);
+		taskEXIT_CRITICAL();
+		knx_link_reset();
+		knx_link_wait_reset_con(KNX_LINK_HEALTH_RESET_WAIT_MS);
+		return;
+	}
+	knx_phy_state_req();
+	knx_link_tx_event(0);
+}
+
+void knx_link_get_stats (knx_stats_t *stats)
+{
+	knx_stats_read(stats);
+}
+
+void knx_link_get_tx_stats (uint8_t priority, knx_link_tx_stats_t *stats)
+{
+	if (priority >= KNX_LINK_PRIORITIES)
+	{
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	taskENTER_CRITICAL();
+	*stats = knx_link_tx_queues[priority].stats;
+	taskEXIT_CRITICAL();
 }
 
 
@@ -387,6 +974,115 @@ knx_link_comm_state_t knx_link_get_comm_state (void)
 
 
 
+uint32_t knx_link_reset (void)
+{
+	// El reset anula la trama que tuviera la TP-UART; las encoladas se
+	// entregan cuando el nivel de enlace vuelve a NORMAL. Las ISR de la UART
+	// también leen y modifican knx_link_tx_in_flight (knx_link_tx_event)
+	taskENTER_CRITICAL();
+	knx_link_set_comm_state(KNX_LINK_INIT_STATE);
+	knx_link_tx_in_flight = 0;
+	taskEXIT_CRITICAL();
+	return (knx_phy_reset_req() == KNX_PHY_RESET_REQ_OK) ? 1 : 0;
+}
+
+knx_link_comm_state_t knx_link_wait_reset_con (uint32_t millisec)
+{
+	osEvent event;
+	osThreadId self = osThreadGetId();
+	osThreadId waiter;
+	uint32_t start, elapsed, remaining, reader;
+
+	start = osKernelSysTick();
+	while (knx_link_comm_state == KNX_LINK_INIT_STATE)
+	{
+		elapsed = osKernelSysTick() - start;
+		if ((millisec != osWaitForever) && (elapsed > millisec))
+		{
+			break;
+		}
+		remaining = (millisec == osWaitForever) ? osWaitForever : (millisec - elapsed);
+
+		// Sólo una tarea a la vez lee Ph_reset.con(): con notificación la
+		// primitiva admite un único consumidor
+		taskENTER_CRITICAL();
+		reader = (knx_link_reset_con_reader == NULL);
+		if (reader)
+		{
+			knx_link_reset_con_reader = self;
+		}
+		else if (remaining != 0)
+		{
+			knx_link_reset_con_waiter = self;
+		}
+		taskEXIT_CRITICAL();
+
+		if (reader)
+		{
+			event = knx_phy_reset_con_get(remaining);
+			if (event.status == osEventMessage)
+			{
+				knx_link_set_comm_state(((event.value.v & 0x00FF) == KNX_PHY_RESET_CON_OK) ?
+				                        KNX_LINK_NORMAL_STATE : KNX_LINK_STOP_STATE);
+				if (knx_link_comm_state == KNX_LINK_NORMAL_STATE)
+				{
+					knx_link_tx_event(0);
+				}
+			}
+			// El estado se publica antes de soltar la lectura: la tarea que se
+			// registre después lo verá sin necesidad de la señal. Si no ha
+			// llegado la confirmación, la que espera pasa a leerla ella
+			taskENTER_CRITICAL();
+			knx_link_reset_con_reader = NULL;
+			waiter = knx_link_reset_con_waiter;
+			knx_link_reset_con_waiter = NULL;
+			taskEXIT_CRITICAL();
+			if (waiter != NULL)
+			{
+				osSignalSet(waiter, KNX_LINK_SIGNAL_RESET_CON);
+			}
+			break;
+		}
+		if ((remaining == 0) || (knx_link_comm_state != KNX_LINK_INIT_STATE))
+		{
+			break;
+		}
+		// Otra tarea la está leyendo: avisa en cuanto publica el estado o
+		// deja de leer (una señal antigua sólo provoca una vuelta más)
+		osSignalWait(KNX_LINK_SIGNAL_RESET_CON, remaining);
+	}
+
+	taskENTER_CRITICAL();
+	if (knx_link_reset_con_waiter == self)
+	{
+		knx_link_reset_con_waiter = NULL;
+	}
+	taskEXIT_CRITICAL();
+	return knx_link_comm_state;
+}
+
+
+
+uint32_t knx_link_monitor_start (void)
+{
+	if (knx_link_comm_state != KNX_LINK_NORMAL_STATE)
+	{
+		return 0;
+	}
+	knx_monitor_start();
+	// El estado cambia antes de enviar la orden para que la ISR de recepción
+	// trate ya como tráfico del bus el primer octeto que entregue la TP-UART
+	knx_link_set_comm_state(KNX_LINK_MONITOR_STATE);
+	if (knx_phy_busmon_req() != KNX_PHY_BUSMON_REQ_OK)
+	{
+		knx_link_set_comm_state(KNX_LINK_NORMAL_STATE);
+		return 0;
+	}
+	return 1;
+}
+
+
+
 void knx_link_init (uint16_t ind_address, uint16_t poll_grp_address, uint16_t poll_slot_number)
 {
   knx_link_init_ind_address(ind_address);
@@ -395,7 +1091,11 @@ void knx_link_init (uint16_t ind_address, uint16_t poll_grp_address, uint16_t po
 
   knx_link_init_grp_addresses();
 
+  knx_link_init_tx_pool();
+
   knx_link_init_comm_state();
+
+  knx_phy_reset_req();
 }
 
 
@@ -0,0 +1,348 @@
+/**
+ * @file knx_monitor.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Monitor pasivo del bus KNX (modo busmonitor de la TP-UART)
+ *
+ * Ver knx_monitor.h
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>     // Para los tipos uintXX_t
+#include <string.h>     // Para memset, memcpy
+#include "knx_monitor.h" // Para las declaraciones públicas de este módulo
+#include "knx_phy.h"    // Para KNX_PHY_MAX_FRAME_LEN (y FreeRTOS, secciones críticas)
+#include "knx_phy_support.h" // Para las constantes de las tramas KNX
+#include "task.h"
+#include "stm32f4xx.h"  // Para el acceso al DWT (CMSIS) y SystemCoreClock
+
+/* --------------------------- Macros privadas ---------------------------- */
+
+#define KNX_MONITOR_BUFFER_MASK              (KNX_MONITOR_BUFFER_SIZE - 1)
+
+#if (KNX_MONITOR_BUFFER_SIZE & KNX_MONITOR_BUFFER_MASK) != 0
+#error "KNX_MONITOR_BUFFER_SIZE debe ser potencia de 2"
+#endif
+
+/* Base de tiempos: contador de ciclos del DWT */
+#define KNX_MONITOR_GET_CYCLES()             (DWT->CYCCNT)
+#ifndef KNX_MONITOR_CYCLES_PER_US
+#define KNX_MONITOR_CYCLES_PER_US            (SystemCoreClock / 1000000U)
+#endif
+
+/* Longitud de las tramas cuyo primer octeto las identifica sin necesidad de LG */
+#define KNX_MONITOR_ACK_FRAME_LEN            1   /**< Carácter de reconocimiento (ACK / NACK / BUSY) */
+#define KNX_MONITOR_POLL_FRAME_LEN           7   /**< Cabecera de trama de polling, sin los slots    */
+
+/* Posición (contando desde 1) del octeto que contiene LG en las tramas de datos */
+#define KNX_MONITOR_STD_LG_POS               6
+#define KNX_MONITOR_EXT_LG_POS               7
+
+/* ------------------------- Variables privadas --------------------------- */
+
+/**
+ * Cola de captura. head sólo lo escribe la ISR y tail sólo la tarea consumidora;
+ * ambos índices avanzan sin límite y se reducen con KNX_MONITOR_BUFFER_MASK al acceder
+ */
+static uint8_t knx_monitor_buffer[KNX_MONITOR_BUFFER_SIZE];
+static volatile uint32_t knx_monitor_head;
+static volatile uint32_t knx_monitor_tail;
+
+/**
+ * Trama en curso. Sus octetos se escriben directamente en la cola a partir de
+ * knx_monitor_head + KNX_MONITOR_HDR_LEN; la cabecera del registro se escribe
+ * (y el registro se publica) al terminar la trama
+ */
+static uint32_t knx_monitor_len;       /**< Octetos recibidos (0 = esperando inicio de trama)   */
+static uint32_t knx_monitor_expected;  /**< Longitud esperada (0 = aún desconocida)             */
+static uint32_t knx_monitor_start_us;  /**< Instante del primer octeto                           */
+static uint8_t  knx_monitor_ctrl;      /**< Primer octeto (CTRL en las tramas de datos)          */
+static uint8_t  knx_monitor_dropping;  /**< No había hueco en la cola: la trama se descarta (1)  */
+
+/**
+ * Base de tiempos en microsegundos, extendida a partir del contador de ciclos
+ * (que a 168 MHz da la vuelta cada ~25 s)
+ */
+static uint32_t knx_monitor_us;            /**< Microsegundos desde knx_monitor_start (módulo 2^32) */
+static uint32_t knx_monitor_cycles_last;   /**< Valor del contador en la última actualización      */
+static uint32_t knx_monitor_cycles_rem;    /**< Ciclos pendientes de completar un microsegundo     */
+static uint32_t knx_monitor_cycles_per_us; /**< Ciclos por microsegundo                            */
+static uint32_t knx_monitor_last_us;       /**< Instante del último octeto recibido                */
+
+/**
+ * Estadísticas de la captura, escritas sólo desde la ISR de recepción
+ * (o con ella enmascarada)
+ */
+static knx_monitor_stats_t knx_monitor_stats;
+
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+/**
+ * @brief Actualizar la base de tiempos
+ *
+ * Debe llamarse al menos una vez por vuelta del contador de ciclos, siempre
+ * desde la ISR de recepción o con ella enmascarada
+ *
+ * @returns Instante actual en microsegundos
+ */
+static uint32_t knx_monitor_now_us (void);
+
+/**
+ * @brief Terminar la trama en curso y publicar su registro en la cola
+ * @param[in] complete 1 si se ha recibido la longitud esperada, 0 si termina por silencio
+ *
+ * @returns Nada
+ */
+static void knx_monitor_frame_end (uint8_t complete);
+
+/**
+ * @brief Longitud de una trama a partir de su primer octeto
+ * @param[in] ctrl Primer octeto de la trama
+ *
+ * @returns Longitud en octetos, o 0 si depende de LG o no se conoce
+ */
+static uint32_t knx_monitor_frame_len (uint8_t ctrl);
+
+/**
+ * @brief Cerrar la trama en curso si lleva más de KNX_MONITOR_GAP_US en silencio
+ *
+ * Permite publicar la última trama de longitud desconocida sin esperar a que
+ * llegue otro octeto. Actualiza siempre la base de tiempos. Se llama desde el
+ * consumidor y desde @ref knx_monitor_poll.
+ *
+ * @returns Nada
+ */
+static void knx_monitor_flush_idle (void);
+
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+static uint32_t knx_monitor_now_us (void)
+{
+	uint32_t cycles = KNX_MONITOR_GET_CYCLES();
+	uint32_t delta = cycles - knx_monitor_cycles_last;
+
+	knx_monitor_cycles_last = cycles;
+	knx_monitor_us += delta / knx_monitor_cycles_per_us;
+	knx_monitor_cycles_rem += delta % knx_monitor_cycles_per_us;
+	if (knx_monitor_cycles_rem >= knx_monitor_cycles_per_us)
+	{
+		knx_monitor_cycles_rem -= knx_monitor_cycles_per_us;
+		knx_monitor_us++;
+	}
+	return knx_monitor_us;
+}
+
+static void knx_monitor_frame_end (uint8_t complete)
+{
+	uint32_t head = knx_monitor_head;
+	uint32_t rec_len = knx_monitor_len + KNX_MONITOR_HDR_LEN - 3;
+	uint32_t used;
+
+	if (!complete)
+	{
+		knx_monitor_stats.incomplete++;
+	}
+	if (knx_monitor_dropping)
+	{
+		knx_monitor_stats.dropped_frames++;
+		knx_monitor_stats.dropped_octets += knx_monitor_len;
+	}
+	else
+	{
+		knx_monitor_buffer[(head + 0) & KNX_MONITOR_BUFFER_MASK] = KNX_MONITOR_SYNC;
+		knx_monitor_buffer[(head + 1) & KNX_MONITOR_BUFFER_MASK] = (uint8_t)rec_len;
+		knx_monitor_buffer[(head + 2) & KNX_MONITOR_BUFFER_MASK] = (uint8_t)(rec_len >> 8);
+		knx_monitor_buffer[(head + 3) & KNX_MONITOR_BUFFER_MASK] = (uint8_t)knx_monitor_start_us;
+		knx_monitor_buffer[(head + 4) & KNX_MONITOR_BUFFER_MASK] = (uint8_t)(knx_monitor_start_us >> 8);
+		knx_monitor_buffer[(head + 5) & KNX_MONITOR_BUFFER_MASK] = (uint8_t)(knx_monitor_start_us >> 16);
+		knx_monitor_buffer[(head + 6) & KNX_MONITOR_BUFFER_MASK] = (uint8_t)(knx_monitor_start_us >> 24);
+		knx_monitor_buffer[(head + 7) & KNX_MONITOR_BUFFER_MASK] = KNX_MONITOR_EVENT;
+		head += KNX_MONITOR_HDR_LEN + knx_monitor_len;
+		// El registro debe estar escrito antes de publicarlo al consumidor
+		__DMB();
+		knx_monitor_head = head;
+		knx_monitor_stats.frames++;
+		used = head - knx_monitor_tail;
+		if (used > knx_monitor_stats.hwm)
+		{
+			knx_monitor_stats.hwm = used;
+		}
+	}
+	knx_monitor_len = 0;
+}
+
+static uint32_t knx_monitor_frame_len (uint8_t ctrl)
+{
+	if ((ctrl & KNX_ACK_FRAME_CTRL_FIXED_MASK) == KNX_ACK_FRAME_CTRL_FIXED_VALUE)
+	{
+		return KNX_MONITOR_ACK_FRAME_LEN;
+	}
+	if ((ctrl & KNX_POLL_FRAME_CTRL_FIXED_MASK) == KNX_POLL_FRAME_CTRL_FIXED_VALUE)
+	{
+		return KNX_MONITOR_POLL_FRAME_LEN;
+	}
+	return 0;
+}
+
+static void knx_monitor_flush_idle (void)
+{
+	uint32_t now;
+
+	taskENTER_CRITICAL();
+	now = knx_monitor_now_us();
+	if ((knx_monitor_len != 0) && ((now - knx_monitor_last_us) > KNX_MONITOR_GAP_US))
+	{
+		knx_monitor_frame_end(0);
+	}
+	taskEXIT_CRITICAL();
+}
+
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+void knx_monitor_start (void)
+{
+	taskENTER_CRITICAL();
+	knx_monitor_head = 0;
+	knx_monitor_tail = 0;
+	knx_monitor_len = 0;
+	memset(&knx_monitor_stats, 0, sizeof(knx_monitor_stats));
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	knx_monitor_cycles_per_us = KNX_MONITOR_CYCLES_PER_US;
+	knx_monitor_cycles_last = KNX_MONITOR_GET_CYCLES();
+	knx_monitor_cycles_rem = 0;
+	knx_monitor_us = 0;
+	knx_monitor_last_us = 0;
+	taskEXIT_CRITICAL();
+}
+
+void knx_monitor_rx_octet (uint8_t data)
+{
+	uint32_t now = knx_monitor_now_us();
+	uint32_t pos;
+
+	knx_monitor_stats.octets++;
+	if ((knx_monitor_len != 0) && ((now - knx_monitor_last_us) > KNX_MONITOR_GAP_US))
+	{
+		// Silencio en mitad de una trama: cerrarla tal cual y empezar otra
+		knx_monitor_frame_end(0);
+	}
+	knx_monitor_last_us = now;
+
+	if (knx_monitor_len == 0)
+	{
+		knx_monitor_start_us = now;
+		knx_monitor_ctrl = data;
+		knx_monitor_expected = knx_monitor_frame_len(data);
+		knx_monitor_dropping = 0;
+	}
+
+	// Escribir el octeto en su sitio; si no cabe, se descarta la trama completa
+	pos = knx_monitor_head + KNX_MONITOR_HDR_LEN + knx_monitor_len;
+	if (!knx_monitor_dropping && ((pos + 1 - knx_monitor_tail) > KNX_MONITOR_BUFFER_SIZE))
+	{
+		knx_monitor_dropping = 1;
+	}
+	if (!knx_monitor_dropping)
+	{
+		knx_monitor_buffer[pos & KNX_MONITOR_BUFFER_MASK] = data;
+	}
+	knx_monitor_len++;
+
+	// En las tramas de datos la longitud se conoce al llegar LG
+	if ((knx_monitor_ctrl & KNX_DATA_FRAME_CTRL_FIXED_MASK) == KNX_DATA_FRAME_CTRL_FIXED_VALUE)
+	{
+		if ((knx_monitor_ctrl & KNX_DATA_FRAME_CTRL_FT_MASK) == KNX_DATA_FRAME_CTRL_FT__STANDARD)
+		{
+			if (knx_monitor_len == KNX_MONITOR_STD_LG_POS)
+			{
+				knx_monitor_expected = KNX_MONITOR_STD_LG_POS + 2 +
+				                       ((data & KNX_STD_FRAME_ATLSDULG_LG_MASK) >> KNX_STD_FRAME_ATLSDULG_LG_SHIFT);
+			}
+		}
+		else if (knx_monitor_len == KNX_MONITOR_EXT_LG_POS)
+		{
+			knx_monitor_expected = KNX_MONITOR_EXT_LG_POS + 2 + (uint32_t)data;
+		}
+	}
+
+	if ((knx_monitor_expected != 0) && (knx_monitor_len >= knx_monitor_expected))
+	{
+		knx_monitor_frame_end(1);
+	}
+	else if (knx_monitor_len >= KNX_PHY_MAX_FRAME_LEN)
+	{
+		knx_monitor_frame_end(0);
+	}
+}
+
+void knx_monitor_poll (void)
+{
+	knx_monitor_flush_idle();
+}
+
+uint32_t knx_monitor_peek (const uint8_t **data)
+{
+	uint32_t head, tail, pos, len;
+
+	knx_monitor_flush_idle();
+	head = knx_monitor_head;
+	// Leer head antes que los datos que publica
+	__DMB();
+	tail = knx_monitor_tail;
+	pos = tail & KNX_MONITOR_BUFFER_MASK;
+	len = head - tail;
+	if (len > (KNX_MONITOR_BUFFER_SIZE - pos))
+	{
+		len = KNX_MONITOR_BUFFER_SIZE - pos;
+	}
+	*data = &knx_monitor_buffer[pos];
+	return len;
+}
+
+void knx_monitor_consume (uint32_t len)
+{
+	// Los datos deben estar leídos antes de devolver el hueco a la ISR
+	__DMB();
+	knx_monitor_tail += len;
+}
+
+uint32_t knx_monitor_read (uint8_t *buf, uint32_t maxlen)
+{
+	const uint8_t *data;
+	uint32_t len, total = 0;
+
+	// Como mucho dos bloques: hasta el final del buffer y desde su inicio
+	while (total < maxlen)
+	{
+		len = knx_monitor_peek(&data);
+		if (len == 0)
+		{
+			break;
+		}
+		if (len > (maxlen - total))
+		{
+			len = maxlen - total;
+		}
+		memcpy(&buf[total], data, len);
+		knx_monitor_consume(len);
+		total += len;
+	}
+	return total;
+}
+
+void knx_monitor_get_stats (knx_monitor_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = knx_monitor_stats;
+	taskEXIT_CRITICAL();
+}
+
+/* @} */
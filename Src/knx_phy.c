@@ -14,7 +14,7 @@
  *       Cola FreeRTOS pÃºblica knx_phy_reset_con
  *   
  * Utilizaremos la capa HAL para la transmisiÃ³n / recepciÃ³n a la UART,
- * y un timer TIM en modo bÃ¡sico para el time-out del reset de la TP-UART
+ * y un timer software de FreeRTOS (one-shot) para el time-out del reset de la TP-UART
  *
  * @{
  */
@@ -22,18 +22,71 @@
 /* ---------------- #includes necesarios para este fichero ----------------- */
 
 #include <stdint.h>     // Para los tipos uintXX_t
+#include <string.h>     // Para memset
 #include "knx_link.h"   // Para el acceso a los parÃ¡metros del nivel de enlace
 #include "knx_phy.h"    // Para  las declaraciones pÃºblicas de este mÃ³dulo
+#include "knx_phy_support.h" // Para las constantes de la TPUART y de las tramas KNX
+#include "knx_monitor.h" // Para la captura de octetos en modo busmonitor
+#include "knx_pool.h"   // Para las pilas de descriptores de trama
+#include "knx_stats.h"  // Para los contadores de los niveles físico y de enlace
+#include "isr_prof.h"   // Para la instrumentación de los callbacks de la UART
 #include "stm32f4xx_hal.h" // Para declaraciones de la capa HAL
+#include "usart.h"      // Para el handle de la UART conectada a la TPUART
 
 /* --------------------------- Macros privadas ---------------------------- */
 
-/* Valores asociados a knx_phy_data_ft */
-#define KNX_PHY_DATA_FT_ESTANDAR             0
-#define KNX_PHY_DATA_FT_EXTENDIDA            1
-/* Valores asociados a knx_phy_data_at */
-#define KNX_PHY_DATA_AT_INDIVIDUAL           0
-#define KNX_PHY_DATA_AT_GRUPO                1
+/* Acceso a la UART conectada a la TPUART y a la base de tiempos.
+   Todo el acceso al hardware de este módulo pasa por estas macros */
+#define KNX_PHY_UART_HANDLE                  huart3
+#define KNX_PHY_UART_TRANSMIT_IT(buf, len)   HAL_UART_Transmit_IT(&KNX_PHY_UART_HANDLE, (buf), (len))
+#define KNX_PHY_UART_TRANSMIT_DMA(buf, len)  HAL_UART_Transmit_DMA(&KNX_PHY_UART_HANDLE, (buf), (len))
+#define KNX_PHY_UART_RECEIVE_IT(buf, len)    HAL_UART_Receive_IT(&KNX_PHY_UART_HANDLE, (buf), (len))
+#define KNX_PHY_GET_TICK()                   HAL_GetTick()
+#define KNX_PHY_GET_CYCLES()                 (DWT->CYCCNT)
+
+/* Actualización de las estadísticas de recepción (sólo con KNX_PHY_RX_STATS) */
+#ifdef KNX_PHY_RX_STATS
+#define KNX_PHY_RX_STAT(expr)                do { expr; } while (0)
+#else
+#define KNX_PHY_RX_STAT(expr)                do { } while (0)
+#endif
+
+/* Máximo tiempo entre dos octetos de una misma trama (en ticks de la capa HAL).
+   A 9600 baudios un octeto ocupa ~1,15 ms y entre tramas hay al menos 50 bits (~5,2 ms),
+   de modo que un silencio mayor indica que se ha perdido la sincronización con la trama */
+#define KNX_PHY_RX_GAP_TICKS                 3
+
+/* Valores asociados a knx_phy_tx_kind */
+#define KNX_PHY_TX_NONE                      0  /**< UART libre                         */
+#define KNX_PHY_TX_ACK                       1  /**< Enviando U_AckInformation          */
+#define KNX_PHY_TX_OCTET                     2  /**< Enviando un octeto (Ph_data.req)   */
+#define KNX_PHY_TX_FRAME                     3  /**< Enviando una trama por DMA         */
+#define KNX_PHY_TX_COMMAND                   4  /**< Enviando una orden a la TPUART     */
+
+/* Octetos de cada tramo en que se sube una trama por DMA: un prefijo U_L_DATA
+   y su octeto, que no pueden separarse. Entre dos tramos se intercala el
+   U_AckInformation pendiente, que así espera como mucho un tramo
+   (~2,3 ms a 9600 baudios) en lugar de la trama completa (hasta ~145 ms) */
+#define KNX_PHY_TX_CHUNK_LEN                 2
+
+/* Bit NACK de U_AckInformation (0x10 | NACK | BUSY | ADDRESSED) */
+#define KNX_PHY_ACKINFO_NACK_BIT             (KNX_TPUART_COMMAND_U_ACKINFO__NACK & 0x0F)
+/* Bit BUSY de U_AckInformation */
+#define KNX_PHY_ACKINFO_BUSY_BIT             (KNX_TPUART_COMMAND_U_ACKINFO__BUSY & 0x0F)
+
+/* Señales (notificaciones de tarea) de las primitivas entregadas con KNX_PHY_xxx_USE_NOTIFY */
+#define KNX_PHY_SIGNAL_RESET_CON             ((int32_t)0x10)
+#define KNX_PHY_SIGNAL_DATA_CON              ((int32_t)0x20)
+#define KNX_PHY_SIGNAL_DATA_IND              ((int32_t)0x40)
+
+#if defined(KNX_PHY_RESET_CON_USE_NOTIFY) || defined(KNX_PHY_DATA_CON_USE_NOTIFY) || defined(KNX_PHY_DATA_IND_USE_NOTIFY)
+#define KNX_PHY_USE_NOTIFY
+#endif
+
+#if ((KNX_PHY_RESET_CON_LEN & (KNX_PHY_RESET_CON_LEN - 1)) != 0) || ((KNX_PHY_DATA_CON_LEN & (KNX_PHY_DATA_CON_LEN - 1)) != 0) || \
+    ((KNX_PHY_DATA_IND_LEN & (KNX_PHY_DATA_IND_LEN - 1)) != 0)
+#error "KNX_PHY_RESET_CON_LEN, KNX_PHY_DATA_CON_LEN y KNX_PHY_DATA_IND_LEN deben ser potencias de 2"
+#endif
 
 /* ----------------------- Tipos de datos privados ------------------------ */
 
@@ -53,19 +106,42 @@ enum knx_phy_fsm_state_e {
     KNX_PHY_FSM_EX_SA2,       /**< Procesar parte baja SA (trama extendida) */
     KNX_PHY_FSM_EX_DA1,       /**< Procesar parte alta DA (trama extendida) */
     KNX_PHY_FSM_EX_DA2,       /**< Procesar parte baja DA (trama extendida) */
+    KNX_PHY_FSM_EX_LG,        /**< Procesar campo LG (trama extendida)      */
 };
 /**
  * RedefiniciÃ³n con typedef para usar una Ãºnica palabra
  */
 typedef enum knx_phy_fsm_state_e knx_phy_fsm_state_t;
 
+#ifdef KNX_PHY_USE_NOTIFY
+/**
+ * Tipo estructurado con el buffer circular de una primitiva entregada por
+ * notificación. head y tail avanzan sin límite y se reducen con size - 1 al
+ * acceder; ambos se modifican dentro de una sección crítica, ya que puede
+ * haber más de un productor (p.ej. Ph_reset.con desde la ISR y desde el timer)
+ */
+struct knx_phy_mailbox_s {
+    volatile uint32_t head;             /**< Elementos escritos                           */
+    volatile uint32_t tail;             /**< Elementos leídos                             */
+    osThreadId volatile consumer;       /**< Tarea a notificar (NULL hasta su primera espera) */
+    uint32_t size;                      /**< Número de elementos (potencia de 2)          */
+    int32_t signal;                     /**< Señal con la que se notifica al consumidor   */
+    uint32_t *items;                    /**< Elementos                                    */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_phy_mailbox_s knx_phy_mailbox_t;
+#endif
+
 
 /* ------------------------- Variables privadas --------------------------- */
 
 /**
- * Tiempo absoluto de inicio del reset de la TPUART (en ticks de la capa HAL)
+ * Intento de reset de la TPUART en curso (1 .. KNX_PHY_RESET_MAX_ATTEMPTS),
+ * 0 si no hay ningún reset en curso
  */
-static uint32_t knx_phy_reset_start_tick;
+static volatile uint8_t knx_phy_reset_attempt;
 
 /**
  * Estado de la FSM que analiza las tramas entrantes
@@ -77,15 +153,865 @@ static knx_phy_fsm_state_t knx_phy_fsm_state;
  */
 static uint8_t knx_phy_data_ft;  /**< Frame type (KNX_PHY_DATA_FT_ESTANDAR / KNX_PHY_DATA_FT_EXTENDIDA) */
 static uint8_t knx_phy_data_at;  /**< Address type (KNX_PHY_DATA_AT_INDIVIDUAL / KNX_PHY_DATA_AT_GRUPO) */
+static uint8_t knx_phy_data_prio; /**< Prioridad (campo CTRL) */
 static uint16_t knx_phy_data_sa; /**< Source address      */
 static uint16_t knx_phy_data_da; /**< Destination address */
+static uint8_t knx_phy_data_addressed; /**< La trama va dirigida a este sistema (1) o no (0) */
+static uint8_t knx_phy_data_ack;       /**< U_AckInformation enviado para la trama (0 si ninguno) */
+static volatile uint8_t knx_phy_data_error; /**< Error de la UART durante la trama (1) o no (0) */
+
+/**
+ * Octeto recibido por la UART conectada a la TPUART (destino de HAL_UART_Receive_IT)
+ */
+static uint8_t knx_phy_rx_data;
+
+/**
+ * Tiempo absoluto de recepción del último octeto (en ticks de la capa HAL)
+ */
+static uint32_t knx_phy_rx_last_tick;
+
+/**
+ * Octetos que quedan por recibir de la trama en curso (incluido CHK)
+ */
+static uint16_t knx_phy_rx_remaining;
+
+/**
+ * XOR negado de los octetos recibidos de la trama en curso: al llegar CHK
+ * vale 0 si el checksum es correcto
+ */
+static uint8_t knx_phy_rx_chk;
+
+/**
+ * Descriptores en los que la ISR ensambla las tramas recibidas,
+ * para tramas estándar y para tramas extendidas
+ */
+KNX_POOL_STORAGE(knx_phy_rx_std_storage, sizeof(knx_phy_frame_t) + KNX_POOL_STD_FRAME_LEN, KNX_PHY_RX_STD_FRAMES);
+KNX_POOL_STORAGE(knx_phy_rx_ext_storage, sizeof(knx_phy_frame_t) + KNX_PHY_MAX_FRAME_LEN, KNX_PHY_RX_EXT_FRAMES);
+static knx_pool_t knx_phy_rx_std_pool;
+static knx_pool_t knx_phy_rx_ext_pool;
+
+/**
+ * Descriptor en el que se está ensamblando la trama en curso
+ * (NULL si no había descriptores libres al comenzar la trama)
+ */
+static knx_phy_frame_t *knx_phy_rx_frame;
+
+/**
+ * Orden U_AckInformation a enviar a la TPUART (destino de HAL_UART_Transmit_IT)
+ */
+static uint8_t knx_phy_ack_info;
+
+/**
+ * Orden de servicio a enviar a la TPUART (destino de HAL_UART_Transmit_IT)
+ */
+static uint8_t knx_phy_command;
+
+/**
+ * Transmisión en curso hacia la TPUART (KNX_PHY_TX_xxx)
+ */
+static volatile uint8_t knx_phy_tx_kind = KNX_PHY_TX_NONE;
+/**
+ * Bits de estado del último U_State.ind recibido
+ */
+static volatile uint8_t knx_phy_tpuart_state;
+
+/**
+ * Secuencia de prefijos U_L_DATA y octetos a enviar a la TPUART
+ */
+static uint8_t knx_phy_tx_buffer[2 * KNX_PHY_TX_MAX_FRAME_LEN];
+
+/**
+ * Subida por tramos de knx_phy_tx_buffer: octetos ya entregados al DMA y
+ * total, y U_AckInformation a intercalar en el siguiente hueco (0 si ninguno)
+ */
+static volatile uint8_t knx_phy_tx_frame_pos;
+static uint8_t knx_phy_tx_frame_len;
+static volatile uint8_t knx_phy_tx_ack_pending;
+#ifdef KNX_PHY_RX_STATS
+static uint32_t knx_phy_tx_ack_pending_cycles;  /**< Instante en que se dejó pendiente */
+#endif
+
+/**
+ * Gestión de valores de la transmisión en curso, para Ph_data.con()
+ */
+static knx_phy_data_con_status_t knx_phy_tx_con_status; /**< Clase del octeto enviado          */
+static uint8_t knx_phy_tx_data;                         /**< Último octeto enviado             */
+static uint8_t knx_phy_tx_index;                        /**< Índice del octeto en la trama     */
+
+#ifdef KNX_PHY_RX_STATS
+/**
+ * Estadísticas de la recepción, escritas sólo desde la ISR de recepción
+ */
+static knx_phy_rx_stats_t knx_phy_rx_stats;
+#endif
+
+/**
+ * Buffers de las primitivas entregadas por notificación. No se reinician en
+ * knx_phy_init, para no perder el registro de un consumidor que ya espera
+ */
+#ifdef KNX_PHY_RESET_CON_USE_NOTIFY
+static uint32_t knx_phy_reset_con_items[KNX_PHY_RESET_CON_LEN];
+static knx_phy_mailbox_t knx_phy_reset_con_mbox = { 0, 0, NULL, KNX_PHY_RESET_CON_LEN, KNX_PHY_SIGNAL_RESET_CON, knx_phy_reset_con_items };
+#endif
+#ifdef KNX_PHY_DATA_CON_USE_NOTIFY
+static uint32_t knx_phy_data_con_items[KNX_PHY_DATA_CON_LEN];
+static knx_phy_mailbox_t knx_phy_data_con_mbox = { 0, 0, NULL, KNX_PHY_DATA_CON_LEN, KNX_PHY_SIGNAL_DATA_CON, knx_phy_data_con_items };
+#endif
+#ifdef KNX_PHY_DATA_IND_USE_NOTIFY
+static uint32_t knx_phy_data_ind_items[KNX_PHY_DATA_IND_LEN];
+static knx_phy_mailbox_t knx_phy_data_ind_mbox = { 0, 0, NULL, KNX_PHY_DATA_IND_LEN, KNX_PHY_SIGNAL_DATA_IND, knx_phy_data_ind_items };
+#endif
 
 
 /* ----------------- DeclaraciÃ³n de funciones privadas -------------------- */
 
+/**
+ * @brief Enviar U_Reset.req a la TPUART y armar el time-out del intento en curso
+ *
+ * Si la UART está ocupada no se envía la orden y el intento sólo consume su
+ * time-out. Debe llamarse con la ISR de recepción excluida (sección crítica).
+ *
+ * @returns Nada
+ */
+static void knx_phy_reset_send (void);
+
+/**
+ * @brief Terminar el reset en curso y señalizar Ph_reset.con()
+ * @param[in] status KNX_PHY_RESET_CON_OK / KNX_PHY_RESET_CON_ERROR
+ *
+ * @returns Nada
+ */
+static void knx_phy_reset_confirm (uint16_t status);
+
+/**
+ * @brief Procesar un octeto recibido desde la TPUART
+ * @param[in] data Octeto recibido
+ *
+ * Avanza la FSM de análisis de tramas entrantes. Es llamada desde
+ * @ref knx_phy_tpuart_rx_cplt, es decir, en contexto de interrupción.
+ *
+ * @returns Nada
+ */
+static void knx_phy_rx_process (uint8_t data);
+
+/**
+ * @brief Procesar un octeto de servicio de la TPUART
+ * @param[in] data Octeto recibido fuera de una trama de datos
+ *
+ * Trata las respuestas / señalizaciones de la TPUART que no forman
+ * parte de una trama de datos (L_Data.confirmation, etc.)
+ *
+ * @returns Nada
+ */
+static void knx_phy_rx_service (uint8_t data);
+
+/**
+ * @brief Decidir si la trama en curso va dirigida a este sistema
+ *
+ * Utiliza knx_phy_data_at y knx_phy_data_da, por lo que sólo puede llamarse
+ * una vez analizados DA y AT
+ *
+ * @returns 1 Si la trama va dirigida a este sistema, 0 en otro caso
+ */
+static uint8_t knx_phy_rx_is_addressed (void);
+
+/**
+ * @brief Tomar la decisión de reconocimiento de la trama en curso
+ *
+ * Es llamada desde la ISR de recepción en cuanto se conocen DA y AT y, si la
+ * trama va dirigida a este sistema, responde a la TPUART con U_AckInformation
+ * antes de que termine la trama:
+ * - NACK si la UART ha señalado un error durante la trama
+ * - BUSY si no había descriptor libre para guardarla (el emisor la repetirá)
+ * - ADDRESSED en otro caso
+ *
+ * @returns Nada
+ */
+static void knx_phy_rx_ack (void);
+
+/**
+ * @brief Comenzar la recepción de una trama
+ *
+ * Toma un descriptor libre para la trama que empieza. Si no hay ninguno,
+ * la trama se analiza igualmente pero sus octetos se descartan.
+ *
+ * @returns Nada
+ */
+static void knx_phy_rx_frame_start (uint8_t ctrl);
+
+/**
+ * @brief Terminar la recepción de la trama en curso
+ *
+ * Señaliza la trama completa al nivel de enlace (un único elemento en
+ * knx_phy_data_ind) si va dirigida a este sistema; en otro caso el
+ * descriptor se reutiliza para la siguiente trama.
+ *
+ * @returns Nada
+ */
+static void knx_phy_rx_frame_end (void);
+
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+/**
+ * @brief Señalizar un octeto de trama a través de knx_phy_data_ind
+ * @param[in] ind_class Clase de octeto
+ * @param[in] data      Octeto recibido
+ *
+ * @returns Nada
+ */
+static void knx_phy_rx_ind_octet (knx_phy_data_ind_class_t ind_class, uint8_t data);
+#endif
+
+/**
+ * @brief Reservar la UART conectada a la TPUART para una transmisión
+ * @param[in] kind Tipo de transmisión (KNX_PHY_TX_xxx)
+ *
+ * Puede llamarse tanto desde una tarea como desde la ISR de recepción
+ *
+ * @returns 1 Si la UART estaba libre y queda reservada, 0 en otro caso
+ */
+static uint32_t knx_phy_tx_acquire (uint8_t kind);
+
+/**
+ * @brief Continuar la subida por tramos de la trama de knx_phy_tx_buffer
+ *
+ * Envía el U_AckInformation pendiente si lo hay y, si no, el siguiente tramo
+ * de KNX_PHY_TX_CHUNK_LEN octetos. Se llama al empezar la trama y desde
+ * el callback de transmisión completada, con la UART reservada para
+ * KNX_PHY_TX_FRAME
+ *
+ * @returns 1 Si ha iniciado una transmisión, 0 si la trama ya está subida
+ */
+static uint32_t knx_phy_tx_frame_next (void);
+
+#ifdef KNX_PHY_USE_NOTIFY
+/**
+ * @brief Guardar un elemento en el buffer de una primitiva y notificar a su consumidor
+ * @param[in] mbox Buffer de la primitiva
+ * @param[in] item Elemento
+ *
+ * Puede llamarse tanto desde una tarea como desde una ISR, y no espera nunca
+ *
+ * @returns osOK si el elemento se ha guardado, osErrorOS si el buffer está lleno
+ */
+static osStatus knx_phy_mailbox_put (knx_phy_mailbox_t *mbox, uint32_t item);
+
+/**
+ * @brief Esperar un elemento del buffer de una primitiva
+ * @param[in] mbox     Buffer de la primitiva
+ * @param[in] millisec Tiempo máximo de espera (0 no espera, osWaitForever sin límite)
+ *
+ * Sólo puede llamarse desde una tarea, que pasa a ser la que se notifica
+ *
+ * @returns Igual que osMessageGet
+ */
+static osEvent knx_phy_mailbox_get (knx_phy_mailbox_t *mbox, uint32_t millisec);
+#endif
+
+/**
+ * @brief Entregar un elemento de Ph_reset.con() (por su cola o por notificación)
+ * @param[in] item Elemento
+ *
+ * @returns osOK si se ha entregado, otro valor si no había espacio
+ */
+static osStatus knx_phy_reset_con_put (uint32_t item);
+
+/**
+ * @brief Entregar un elemento de Ph_data.con() (por su cola o por notificación)
+ * @param[in] item Elemento
+ *
+ * @returns osOK si se ha entregado, otro valor si no había espacio
+ */
+static osStatus knx_phy_data_con_put (uint32_t item);
+
+/**
+ * @brief Entregar un elemento de Ph_data.ind() (por su cola o por notificación)
+ * @param[in] item Elemento
+ *
+ * @returns osOK si se ha entregado, otro valor si no había espacio
+ */
+static osStatus knx_phy_data_ind_put (uint32_t item);
+
+/**
+ * @brief Procesar un octeto recibido de la TPUART
+ * @param[in] data Octeto recibido
+ * @param[in] now  Instante de recepción (en ticks de la capa HAL)
+ *
+ * Resincroniza la FSM si ha habido un silencio en mitad de una trama
+ * y procesa el octeto. Común a la ISR y a knx_phy_rx_replay().
+ */
+static void knx_phy_rx_octet (uint8_t data, uint32_t now);
+
 
 /* ---------------- ImplementaciÃ³n de funciones privadas ------------------ */
 
+static void knx_phy_rx_process (uint8_t data)
+{
+	if (knx_phy_fsm_state != KNX_PHY_FSM_E_CTRL)
+	{
+		knx_phy_rx_chk ^= data;
+		if ((knx_phy_rx_frame != NULL) && (knx_phy_rx_frame->len < knx_phy_rx_frame->size))
+		{
+			knx_phy_rx_frame->bytes[knx_phy_rx_frame->len++] = data;
+		}
+		else
+		{
+			KNX_PHY_RX_STAT(knx_phy_rx_stats.dropped_octets++);
+		}
+	}
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+	if ((knx_phy_fsm_state != KNX_PHY_FSM_E_CTRL) && (knx_phy_fsm_state != KNX_PHY_FSM_E_OTRO))
+	{
+		knx_phy_rx_ind_octet(KNX_PHY_DATA_IND_CLASS_INNER, data);
+	}
+#endif
+
+	switch (knx_phy_fsm_state)
+	{
+	case KNX_PHY_FSM_E_CTRL:
+		if (((data & KNX_DATA_FRAME_CTRL_FIXED_MASK) != KNX_DATA_FRAME_CTRL_FIXED_VALUE) ||
+		    (knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE))
+		{
+			knx_phy_rx_service(data);
+			break;
+		}
+		knx_phy_rx_frame_start(data);
+		knx_phy_rx_chk = (uint8_t)~data;
+		if (knx_phy_rx_frame != NULL)
+		{
+			knx_phy_rx_frame->ctrl = data;
+			knx_phy_rx_frame->bytes[knx_phy_rx_frame->len++] = data;
+		}
+		else
+		{
+			KNX_PHY_RX_STAT(knx_phy_rx_stats.dropped_octets++);
+		}
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+		knx_phy_rx_ind_octet(KNX_PHY_DATA_IND_CLASS_START, data);
+#endif
+		knx_phy_data_prio = (data & KNX_DATA_FRAME_CTRL_PRIO_MASK) >> KNX_DATA_FRAME_CTRL_PRIO_SHIFT;
+		knx_phy_data_addressed = 0;
+		knx_phy_data_ack = 0;
+		knx_phy_data_error = 0;
+		if ((data & KNX_DATA_FRAME_CTRL_FT_MASK) == KNX_DATA_FRAME_CTRL_FT__STANDARD)
+		{
+			knx_phy_data_ft = KNX_PHY_DATA_FT_ESTANDAR;
+			knx_phy_fsm_state = KNX_PHY_FSM_E_SA1;
+		}
+		else
+		{
+			knx_phy_data_ft = KNX_PHY_DATA_FT_EXTENDIDA;
+			knx_phy_fsm_state = KNX_PHY_FSM_EX_CTRL;
+		}
+		break;
+
+	case KNX_PHY_FSM_EX_CTRL:
+		knx_phy_data_at = ((data & KNX_EXT_FRAME_CTRLE_AT_MASK) == KNX_EXT_FRAME_CTRLE_AT_SHIFT__DA_GROUP) ?
+		                  KNX_PHY_DATA_AT_GRUPO : KNX_PHY_DATA_AT_INDIVIDUAL;
+		knx_phy_fsm_state = KNX_PHY_FSM_EX_SA1;
+		break;
+
+	case KNX_PHY_FSM_E_SA1:
+	case KNX_PHY_FSM_EX_SA1:
+		knx_phy_data_sa = ((uint16_t)data) << 8;
+		knx_phy_fsm_state = (knx_phy_fsm_state == KNX_PHY_FSM_E_SA1) ? KNX_PHY_FSM_E_SA2 : KNX_PHY_FSM_EX_SA2;
+		break;
+
+	case KNX_PHY_FSM_E_SA2:
+	case KNX_PHY_FSM_EX_SA2:
+		knx_phy_data_sa |= data;
+		knx_phy_fsm_state = (knx_phy_fsm_state == KNX_PHY_FSM_E_SA2) ? KNX_PHY_FSM_E_DA1 : KNX_PHY_FSM_EX_DA1;
+		break;
+
+	case KNX_PHY_FSM_E_DA1:
+	case KNX_PHY_FSM_EX_DA1:
+		knx_phy_data_da = ((uint16_t)data) << 8;
+		knx_phy_fsm_state = (knx_phy_fsm_state == KNX_PHY_FSM_E_DA1) ? KNX_PHY_FSM_E_DA2 : KNX_PHY_FSM_EX_DA2;
+		break;
+
+	case KNX_PHY_FSM_E_DA2:
+		knx_phy_data_da |= data;
+		knx_phy_fsm_state = KNX_PHY_FSM_E_ATLSDULG;
+		break;
+
+	case KNX_PHY_FSM_EX_DA2:
+		// En la trama extendida AT ya se conoce (CTRLE): decidir el reconocimiento ya
+		knx_phy_data_da |= data;
+		knx_phy_rx_ack();
+		knx_phy_fsm_state = KNX_PHY_FSM_EX_LG;
+		break;
+
+	case KNX_PHY_FSM_E_ATLSDULG:
+		knx_phy_data_at = ((data & KNX_STD_FRAME_ATLSDULG_AT_MASK) == KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_GROUP) ?
+		                  KNX_PHY_DATA_AT_GRUPO : KNX_PHY_DATA_AT_INDIVIDUAL;
+		knx_phy_rx_ack();
+		// Quedan LG + 1 octetos (TPCI ... ) más CHK
+		knx_phy_rx_remaining = ((data & KNX_STD_FRAME_ATLSDULG_LG_MASK) >> KNX_STD_FRAME_ATLSDULG_LG_SHIFT) + 2;
+		knx_phy_fsm_state = KNX_PHY_FSM_E_OTRO;
+		break;
+
+	case KNX_PHY_FSM_EX_LG:
+		knx_phy_rx_remaining = ((uint16_t)data) + 2;
+		knx_phy_fsm_state = KNX_PHY_FSM_E_OTRO;
+		break;
+
+	case KNX_PHY_FSM_E_OTRO:
+		if (--knx_phy_rx_remaining == 0)
+		{
+			KNX_PHY_RX_STAT(knx_phy_rx_stats.chk_errors += (knx_phy_rx_chk != 0));
+			{
+				knx_stats_rx_t *stats = knx_stats_rx_begin();
+				stats->frames[knx_phy_data_prio]++;
+				stats->chk_errors += (knx_phy_rx_chk != 0);
+				knx_stats_rx_end();
+			}
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+			knx_phy_rx_ind_octet((knx_phy_rx_chk == 0) ? KNX_PHY_DATA_IND_CLASS_END : KNX_PHY_DATA_IND_CLASS_END_CHK_ERROR, data);
+#endif
+			knx_phy_rx_frame_end();
+			knx_phy_fsm_state = KNX_PHY_FSM_E_CTRL;
+		}
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+		else
+		{
+			knx_phy_rx_ind_octet(KNX_PHY_DATA_IND_CLASS_INNER, data);
+		}
+#endif
+		break;
+
+	default:
+		knx_phy_fsm_state = KNX_PHY_FSM_E_CTRL;
+		break;
+	}
+}
+
+static void knx_phy_reset_send (void)
+{
+	uint32_t timeout = ((uint32_t)KNX_PHY_RESET_TIMEOUT_MS) << (knx_phy_reset_attempt - 1);
+
+	if (knx_phy_tx_acquire(KNX_PHY_TX_COMMAND))
+	{
+		knx_phy_command = KNX_TPUART_COMMAND_U_RESET_REQUEST;
+		if (KNX_PHY_UART_TRANSMIT_IT(&knx_phy_command, 1) != 0)
+		{
+			knx_phy_tx_kind = KNX_PHY_TX_NONE;
+		}
+	}
+	osTimerStart(knx_phy_reset_timerHandle, (timeout < KNX_PHY_RESET_TIMEOUT_MAX_MS) ? timeout : KNX_PHY_RESET_TIMEOUT_MAX_MS);
+}
+
+static void knx_phy_reset_confirm (uint16_t status)
+{
+	knx_phy_tpuart_state = 0;
+	knx_phy_reset_con_put(((((uint16_t)knx_phy_reset_attempt) << 8) & 0xFF00) | (status & 0x00FF));
+	knx_phy_reset_attempt = 0;
+}
+
+static void knx_phy_rx_service (uint8_t data)
+{
+	if ((data == KNX_TPUART_U_RESET_INDICATION) && (knx_phy_reset_attempt != 0))
+	{
+		osTimerStop(knx_phy_reset_timerHandle);
+		knx_phy_reset_confirm(KNX_PHY_RESET_CON_OK);
+	}
+	else if ((data == KNX_TPUART_L_DATA_CONFIRMATION_POS) || (data == KNX_TPUART_L_DATA_CONFIRMATION_NEG))
+	{
+		if (data == KNX_TPUART_L_DATA_CONFIRMATION_POS)
+		{
+			KNX_STATS_RX_INC(con_pos);
+		}
+		else
+		{
+			KNX_STATS_RX_INC(con_neg);
+		}
+		if (knx_phy_data_con_put(((((uint16_t)KNX_PHY_DATA_CON_STATUS_LDATA_CONFIRM) << 8) & 0xFF00) | (((uint16_t)data) & 0x00FF)) != osOK)
+		{
+			KNX_STATS_RX_INC(con_overflows);
+		}
+		// La TP-UART ha terminado con la trama: el nivel de enlace puede entregar la siguiente
+		knx_link_tx_event(1);
+	}
+	else if ((data & KNX_TPUART_U_STATE_INDICATION_MASK) == KNX_TPUART_U_STATE_INDICATION)
+	{
+		knx_stats_rx_t *stats = knx_stats_rx_begin();
+
+		stats->state_inds++;
+		stats->state_sc += ((data & KNX_TPUART_U_STATE_SC) != 0);
+		stats->state_re += ((data & KNX_TPUART_U_STATE_RE) != 0);
+		stats->state_te += ((data & KNX_TPUART_U_STATE_TE) != 0);
+		stats->state_pe += ((data & KNX_TPUART_U_STATE_PE) != 0);
+		stats->state_tw += ((data & KNX_TPUART_U_STATE_TW) != 0);
+		knx_stats_rx_end();
+		knx_phy_tpuart_state = data & ~KNX_TPUART_U_STATE_INDICATION_MASK;
+	}
+}
+
+static uint8_t knx_phy_rx_is_addressed (void)
+{
+	if (knx_phy_data_at == KNX_PHY_DATA_AT_GRUPO)
+	{
+		// La dirección de grupo 0 es la de difusión (broadcast)
+		return ((knx_phy_data_da == 0) || knx_link_exists_grp_address(knx_phy_data_da)) ? 1 : 0;
+	}
+	return (knx_phy_data_da == knx_link_get_ind_address()) ? 1 : 0;
+}
+
+static void knx_phy_rx_ack (void)
+{
+	uint8_t ack = KNX_TPUART_COMMAND_U_ACKINFO__ADDRESSED;
+
+	knx_phy_data_addressed = knx_phy_rx_is_addressed();
+	if (!knx_phy_data_addressed)
+	{
+		return;
+	}
+	// Los bits BUSY y NACK se combinan con ADDRESSED en la misma orden
+	if (knx_phy_data_error)
+	{
+		ack |= KNX_TPUART_COMMAND_U_ACKINFO__NACK;
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.acks_nack++);
+	}
+	else if (knx_phy_rx_frame == NULL)
+	{
+		ack |= KNX_TPUART_COMMAND_U_ACKINFO__BUSY;
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.acks_busy++);
+	}
+	knx_phy_data_ack = ack;
+	if (knx_phy_tx_acquire(KNX_PHY_TX_ACK))
+	{
+		knx_phy_ack_info = ack;
+		if (KNX_PHY_UART_TRANSMIT_IT(&knx_phy_ack_info, 1) != 0)
+		{
+			knx_phy_tx_kind = KNX_PHY_TX_NONE;
+			KNX_PHY_RX_STAT(knx_phy_rx_stats.acks_missed++);
+			return;
+		}
+	}
+	else if (knx_phy_tx_kind == KNX_PHY_TX_FRAME)
+	{
+		// Subiendo una trama: el ACK sale en cuanto termine el tramo en curso
+		// (knx_phy_tx_frame_next). Este callback y el de transmisión completada
+		// comparten la interrupción de la UART, así que no se solapan
+		knx_phy_tx_ack_pending = ack;
+		KNX_PHY_RX_STAT(knx_phy_tx_ack_pending_cycles = KNX_PHY_GET_CYCLES());
+	}
+	else
+	{
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.acks_missed++);
+		return;
+	}
+	if (ack & KNX_PHY_ACKINFO_NACK_BIT)
+	{
+		KNX_STATS_RX_INC(nacks);
+	}
+	else if (ack & KNX_PHY_ACKINFO_BUSY_BIT)
+	{
+		KNX_STATS_RX_INC(busys);
+	}
+	else
+	{
+		KNX_STATS_RX_INC(acks);
+	}
+}
+
+static void knx_phy_rx_frame_start (uint8_t ctrl)
+{
+	uint16_t size = ((ctrl & KNX_DATA_FRAME_CTRL_FT_MASK) == KNX_DATA_FRAME_CTRL_FT__STANDARD) ?
+	                KNX_POOL_STD_FRAME_LEN : KNX_PHY_MAX_FRAME_LEN;
+
+	// Si la trama anterior no llegó a completarse, se reutiliza su descriptor
+	// sólo si es de la pila que corresponde a la nueva: una trama estándar no
+	// puede retener un descriptor extendido (de los que hay muy pocos)
+	if ((knx_phy_rx_frame != NULL) && (knx_phy_rx_frame->size != size))
+	{
+		knx_phy_data_ind_release(knx_phy_rx_frame);
+		knx_phy_rx_frame = NULL;
+	}
+	if (knx_phy_rx_frame == NULL)
+	{
+		knx_phy_rx_frame = (knx_phy_frame_t *)knx_pool_alloc((size == KNX_POOL_STD_FRAME_LEN) ?
+		                                                     &knx_phy_rx_std_pool : &knx_phy_rx_ext_pool);
+		if (knx_phy_rx_frame == NULL)
+		{
+			return;
+		}
+		knx_phy_rx_frame->size = size;
+	}
+	knx_phy_rx_frame->len = 0;
+}
+
+static void knx_phy_rx_frame_end (void)
+{
+	knx_phy_frame_t *frame = knx_phy_rx_frame;
+#ifndef KNX_PHY_DATA_IND_PER_OCTET
+	uint8_t ctrl, chk;
+#endif
+
+	KNX_PHY_RX_STAT(knx_phy_rx_stats.frames++);
+#ifndef KNX_PHY_DATA_IND_PER_OCTET
+	if ((frame == NULL) || !knx_phy_data_addressed || (knx_phy_data_ack & KNX_PHY_ACKINFO_NACK_BIT))
+	{
+		// Sin descriptor (BUSY), rechazada (NACK, el emisor la repetirá) o trama
+		// para otro sistema: el descriptor se reutiliza para la siguiente
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.dropped_frames += knx_phy_data_addressed);
+		return;
+	}
+	frame->ft = knx_phy_data_ft;
+	frame->at = knx_phy_data_at;
+	frame->ctrle = (knx_phy_data_ft == KNX_PHY_DATA_FT_EXTENDIDA) ? frame->bytes[1] : 0;
+	frame->sa = knx_phy_data_sa;
+	frame->da = knx_phy_data_da;
+	frame->chk = (knx_phy_rx_chk == 0) ? KNX_PHY_DATA_CHK_OK : KNX_PHY_DATA_CHK_ERROR;
+	// TPCI va tras AT/LSDU/LG (estándar, posición 6) o tras LG (extendida, posición 7)
+	frame->lsdu_pos = (knx_phy_data_ft == KNX_PHY_DATA_FT_ESTANDAR) ? 6 : 7;
+	frame->lsdu_len = frame->len - frame->lsdu_pos - 1;
+	ctrl = frame->ctrl;
+	chk = frame->bytes[frame->len - 1];
+	if ((knx_phy_rx_chk == 0) && knx_link_rx_is_duplicate(ctrl, knx_phy_data_sa, knx_phy_data_da, chk, knx_phy_rx_last_tick))
+	{
+		// Repetición (REP = 0) de una trama ya entregada cuyo reconocimiento
+		// no llegó al emisor: ya se ha reconocido de nuevo, no se entrega otra vez
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.duplicates++);
+		KNX_STATS_RX_INC(duplicates);
+		return;
+	}
+	if (knx_phy_data_ind_put((uint32_t)frame) == osOK)
+	{
+		// El descriptor pertenece ahora al receptor
+		knx_phy_rx_frame = NULL;
+		// Recordarla para descartar sus repeticiones (sin tocar ya el descriptor)
+		if (knx_phy_rx_chk == 0)
+		{
+			knx_link_rx_delivered(ctrl, knx_phy_data_sa, knx_phy_data_da, chk, knx_phy_rx_last_tick);
+		}
+#ifdef KNX_PHY_RX_STATS
+		{
+#ifdef KNX_PHY_DATA_IND_USE_NOTIFY
+			uint32_t waiting = knx_phy_data_ind_mbox.head - knx_phy_data_ind_mbox.tail;
+#else
+			uint32_t waiting = (uint32_t)uxQueueMessagesWaitingFromISR(knx_phy_data_indHandle);
+#endif
+			knx_phy_rx_stats.frames_ind++;
+			if (waiting > knx_phy_rx_stats.ind_queue_hwm)
+			{
+				knx_phy_rx_stats.ind_queue_hwm = waiting;
+			}
+		}
+#endif
+	}
+	else
+	{
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.dropped_frames++);
+		KNX_STATS_RX_INC(ind_overflows);
+	}
+#else
+	(void)frame;
+#endif
+}
+
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+static void knx_phy_rx_ind_octet (knx_phy_data_ind_class_t ind_class, uint8_t data)
+{
+	knx_phy_data_ind_put(((((uint16_t)ind_class) << 8) & 0xFF00) | (((uint16_t)data) & 0x00FF));
+}
+#endif
+
+
+#ifdef KNX_PHY_USE_NOTIFY
+static osStatus knx_phy_mailbox_put (knx_phy_mailbox_t *mbox, uint32_t item)
+{
+	UBaseType_t saved;
+	uint32_t head;
+	osThreadId consumer;
+
+	saved = taskENTER_CRITICAL_FROM_ISR();
+	head = mbox->head;
+	if ((head - mbox->tail) >= mbox->size)
+	{
+		taskEXIT_CRITICAL_FROM_ISR(saved);
+		return osErrorOS;
+	}
+	mbox->items[head & (mbox->size - 1)] = item;
+	mbox->head = head + 1;
+	consumer = mbox->consumer;
+	taskEXIT_CRITICAL_FROM_ISR(saved);
+	if (consumer != NULL)
+	{
+		osSignalSet(consumer, mbox->signal);
+	}
+	return osOK;
+}
+
+static osEvent knx_phy_mailbox_get (knx_phy_mailbox_t *mbox, uint32_t millisec)
+{
+	osEvent event;
+	UBaseType_t saved;
+	uint32_t tail, start, elapsed;
+
+	start = osKernelSysTick();
+	if (millisec != 0)
+	{
+		// Registrarse antes de mirar el buffer: un elemento que llegue después
+		// deja la notificación pendiente y la espera no llega a bloquearse
+		mbox->consumer = osThreadGetId();
+	}
+	for (;;)
+	{
+		saved = taskENTER_CRITICAL_FROM_ISR();
+		tail = mbox->tail;
+		if (tail != mbox->head)
+		{
+			event.value.v = mbox->items[tail & (mbox->size - 1)];
+			mbox->tail = tail + 1;
+			taskEXIT_CRITICAL_FROM_ISR(saved);
+			event.status = osEventMessage;
+			return event;
+		}
+		taskEXIT_CRITICAL_FROM_ISR(saved);
+		if (millisec == 0)
+		{
+			event.status = osOK;
+			return event;
+		}
+		elapsed = osKernelSysTick() - start;
+		if ((millisec != osWaitForever) && (elapsed >= millisec))
+		{
+			event.status = osEventTimeout;
+			return event;
+		}
+		// Una notificación de un elemento que ya se leyó sin esperar, o de otra
+		// señal de la misma tarea, sólo provoca una vuelta más
+		osSignalWait(mbox->signal, (millisec == osWaitForever) ? osWaitForever : (millisec - elapsed));
+	}
+}
+#endif
+
+static osStatus knx_phy_reset_con_put (uint32_t item)
+{
+#ifdef KNX_PHY_RESET_CON_USE_NOTIFY
+	return knx_phy_mailbox_put(&knx_phy_reset_con_mbox, item);
+#else
+	return osMessagePut(knx_phy_reset_conHandle, item, 0);
+#endif
+}
+
+static osStatus knx_phy_data_con_put (uint32_t item)
+{
+#ifdef KNX_PHY_DATA_CON_USE_NOTIFY
+	return knx_phy_mailbox_put(&knx_phy_data_con_mbox, item);
+#else
+	return osMessagePut(knx_phy_data_conHandle, item, 0);
+#endif
+}
+
+static osStatus knx_phy_data_ind_put (uint32_t item)
+{
+#ifdef KNX_PHY_DATA_IND_USE_NOTIFY
+	return knx_phy_mailbox_put(&knx_phy_data_ind_mbox, item);
+#else
+	return osMessagePut(knx_phy_data_indHandle, item, 0);
+#endif
+}
+
+static uint32_t knx_phy_tx_acquire (uint8_t kind)
+{
+	UBaseType_t saved;
+	uint32_t acquired = 0;
+
+	saved = taskENTER_CRITICAL_FROM_ISR();
+	if (knx_phy_tx_kind == KNX_PHY_TX_NONE)
+	{
+		knx_phy_tx_kind = kind;
+		acquired = 1;
+	}
+	taskEXIT_CRITICAL_FROM_ISR(saved);
+	return acquired;
+}
+
+static uint32_t knx_phy_tx_frame_next (void)
+{
+	UBaseType_t saved;
+	uint32_t pos, len, started = 0;
+	uint8_t ack;
+#ifdef KNX_PHY_RX_STATS
+	uint32_t cycles;
+#endif
+
+	// Desde knx_phy_frame_req compite con la ISR de recepción por el ACK pendiente
+	saved = taskENTER_CRITICAL_FROM_ISR();
+	ack = knx_phy_tx_ack_pending;
+	knx_phy_tx_ack_pending = 0;
+	if (ack != 0)
+	{
+		knx_phy_ack_info = ack;
+		if (KNX_PHY_UART_TRANSMIT_IT(&knx_phy_ack_info, 1) == 0)
+		{
+#ifdef KNX_PHY_RX_STATS
+			cycles = KNX_PHY_GET_CYCLES() - knx_phy_tx_ack_pending_cycles;
+			knx_phy_rx_stats.acks_deferred++;
+			if (cycles > knx_phy_rx_stats.ack_defer_cycles_max)
+			{
+				knx_phy_rx_stats.ack_defer_cycles_max = cycles;
+			}
+#endif
+			started = 1;
+		}
+		else
+		{
+			KNX_PHY_RX_STAT(knx_phy_rx_stats.acks_missed++);
+		}
+	}
+	pos = knx_phy_tx_frame_pos;
+	if (!started && (pos < knx_phy_tx_frame_len))
+	{
+		len = knx_phy_tx_frame_len - pos;
+		if (len > KNX_PHY_TX_CHUNK_LEN)
+		{
+			len = KNX_PHY_TX_CHUNK_LEN;
+		}
+		if (KNX_PHY_UART_TRANSMIT_DMA(&knx_phy_tx_buffer[pos], (uint16_t)len) == 0)
+		{
+			knx_phy_tx_frame_pos = (uint8_t)(pos + len);
+			started = 1;
+		}
+	}
+	taskEXIT_CRITICAL_FROM_ISR(saved);
+	return started;
+}
+
+static void knx_phy_rx_octet (uint8_t data, uint32_t now)
+{
+#ifdef KNX_PHY_RX_STATS
+	uint32_t cycles = KNX_PHY_GET_CYCLES();
+#endif
+
+	if (knx_link_get_comm_state() == KNX_LINK_MONITOR_STATE)
+	{
+		// Modo busmonitor: todo octeto es parte del tráfico del bus, sin análisis ni reconocimiento
+		knx_phy_fsm_state = KNX_PHY_FSM_E_CTRL;
+		knx_monitor_rx_octet(data);
+		return;
+	}
+	if ((knx_phy_fsm_state != KNX_PHY_FSM_E_CTRL) && ((now - knx_phy_rx_last_tick) > KNX_PHY_RX_GAP_TICKS))
+	{
+		// Silencio demasiado largo en mitad de una trama: descartarla
+		knx_phy_fsm_state = KNX_PHY_FSM_E_CTRL;
+		KNX_PHY_RX_STAT(knx_phy_rx_stats.resyncs++);
+	}
+	knx_phy_rx_last_tick = now;
+
+	knx_phy_rx_process(data);
+
+#ifdef KNX_PHY_RX_STATS
+	cycles = KNX_PHY_GET_CYCLES() - cycles;
+	knx_phy_rx_stats.octets++;
+	knx_phy_rx_stats.cycles_last = cycles;
+	knx_phy_rx_stats.cycles_total += cycles;
+	if (cycles > knx_phy_rx_stats.cycles_max)
+	{
+		knx_phy_rx_stats.cycles_max = cycles;
+	}
+#endif
+}
 
 /* ---------------- ImplementaciÃ³n de funciones pÃºblicas ------------------ */
 
@@ -94,14 +1020,74 @@ static uint16_t knx_phy_data_da; /**< Destination address */
 
 void knx_phy_tpuart_tx_cplt(void)
 {
+	ISR_PROF_ENTER(ISR_PROF_KNX_TX_CPLT);
+	uint8_t kind = knx_phy_tx_kind;
+
+	if ((kind == KNX_PHY_TX_FRAME) && knx_phy_tx_frame_next())
+	{
+		// Queda trama por subir (o se ha intercalado un ACK): la UART sigue reservada
+		ISR_PROF_EXIT(ISR_PROF_KNX_TX_CPLT);
+		return;
+	}
+	knx_phy_tx_kind = KNX_PHY_TX_NONE;
+	if ((kind == KNX_PHY_TX_OCTET) || (kind == KNX_PHY_TX_FRAME))
+	{
+		if (knx_phy_data_con_put(((((uint16_t)knx_phy_tx_con_status) << 8) & 0xFF00) | (((uint16_t)knx_phy_tx_data) & 0x00FF)) != osOK)
+		{
+			KNX_STATS_RX_INC(con_overflows);
+		}
+	}
+	// UART libre: reintentar la trama que hubiera encontrado ocupada la TP-UART
+	knx_link_tx_event(0);
+	ISR_PROF_EXIT(ISR_PROF_KNX_TX_CPLT);
 }
 
 void knx_phy_tpuart_rx_cplt(void)
 {
+	ISR_PROF_ENTER(ISR_PROF_KNX_RX_CPLT);
+	uint8_t data = knx_phy_rx_data;
+
+	// Volver a armar la recepción antes de procesar para no perder el siguiente octeto
+	KNX_PHY_UART_RECEIVE_IT(&knx_phy_rx_data, 1);
+
+	knx_phy_rx_octet(data, KNX_PHY_GET_TICK());
+	ISR_PROF_EXIT(ISR_PROF_KNX_RX_CPLT);
+}
+
+void knx_phy_tpuart_rx_error(uint32_t error_code)
+{
+	knx_stats_rx_t *stats = knx_stats_rx_begin();
+
+	stats->parity_errors += ((error_code & HAL_UART_ERROR_PE) != 0);
+	stats->framing_errors += ((error_code & HAL_UART_ERROR_FE) != 0);
+	stats->noise_errors += ((error_code & HAL_UART_ERROR_NE) != 0);
+	stats->overrun_errors += ((error_code & HAL_UART_ERROR_ORE) != 0);
+	knx_stats_rx_end();
+
+	knx_phy_data_error = 1;
+	KNX_PHY_UART_RECEIVE_IT(&knx_phy_rx_data, 1);
 }
 
 void knx_phy_tpuart_reset_timeout(void)
 {
+	ISR_PROF_ENTER(ISR_PROF_KNX_RESET_TIMEOUT);
+	// Excluir a la ISR de recepción, que puede estar confirmando el reset
+	taskENTER_CRITICAL();
+	if (knx_phy_reset_attempt == 0)
+	{
+		// U_Reset.ind llegó mientras vencía el timer: nada que hacer
+	}
+	else if (knx_phy_reset_attempt >= KNX_PHY_RESET_MAX_ATTEMPTS)
+	{
+		knx_phy_reset_confirm(KNX_PHY_RESET_CON_ERROR);
+	}
+	else
+	{
+		knx_phy_reset_attempt++;
+		knx_phy_reset_send();
+	}
+	taskEXIT_CRITICAL();
+	ISR_PROF_EXIT(ISR_PROF_KNX_RESET_TIMEOUT);
 }
 
 
@@ -113,6 +1099,26 @@ void knx_phy_tpuart_reset_timeout(void)
 
 uint32_t knx_phy_reset_req (void)
 {
+	uint32_t result = KNX_PHY_RESET_REQ_ERROR;
+
+	taskENTER_CRITICAL();
+	if ((knx_link_get_comm_state() == KNX_LINK_INIT_STATE) && (knx_phy_reset_attempt == 0))
+	{
+		knx_phy_reset_attempt = 1;
+		knx_phy_reset_send();
+		result = KNX_PHY_RESET_REQ_OK;
+	}
+	taskEXIT_CRITICAL();
+	return result;
+}
+
+osEvent knx_phy_reset_con_get (uint32_t millisec)
+{
+#ifdef KNX_PHY_RESET_CON_USE_NOTIFY
+	return knx_phy_mailbox_get(&knx_phy_reset_con_mbox, millisec);
+#else
+	return osMessageGet(knx_phy_reset_conHandle, millisec);
+#endif
 }
 
 
@@ -122,15 +1128,201 @@ uint32_t knx_phy_reset_req (void)
 
 uint32_t knx_phy_data_req (knx_phy_data_req_class_t p_req_class, uint8_t p_data)
 {
+	uint8_t prefix;
+
+	if (knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE)
+	{
+		return KNX_PHY_DATA_REQ_ERROR;
+	}
+	if (!knx_phy_tx_acquire(KNX_PHY_TX_OCTET))
+	{
+		return KNX_PHY_DATA_REQ_BUSY;
+	}
+	switch (p_req_class)
+	{
+	case KNX_PHY_DATA_REQ_CLASS_START:
+		knx_phy_tx_index = 0;
+		prefix = KNX_TPUART_COMMAND_U_L_DATA_START;
+		knx_phy_tx_con_status = KNX_PHY_DATA_CON_STATUS_START;
+		break;
+	case KNX_PHY_DATA_REQ_CLASS_INNER:
+		prefix = KNX_TPUART_COMMAND_U_L_DATA_CONTINUE + knx_phy_tx_index;
+		knx_phy_tx_con_status = KNX_PHY_DATA_CON_STATUS_INNER;
+		break;
+	default:
+		// El índice del último octeto (CHK) es el número de octetos que le preceden
+		prefix = KNX_TPUART_COMMAND_U_L_DATA_END + knx_phy_tx_index;
+		knx_phy_tx_con_status = KNX_PHY_DATA_CON_STATUS_END;
+		break;
+	}
+	knx_phy_tx_index++;
+	knx_phy_tx_data = p_data;
+	knx_phy_tx_buffer[0] = prefix;
+	knx_phy_tx_buffer[1] = p_data;
+	if (KNX_PHY_UART_TRANSMIT_IT(knx_phy_tx_buffer, 2) != 0)
+	{
+		knx_phy_tx_kind = KNX_PHY_TX_NONE;
+		return KNX_PHY_DATA_REQ_BUSY;
+	}
+	return KNX_PHY_DATA_REQ_OK;
+}
+
+uint32_t knx_phy_frame_req (const uint8_t *frame, uint8_t len)
+{
+	uint8_t *p = knx_phy_tx_buffer;
+	uint8_t i;
+	uint8_t chk = 0xFF;
+
+	if ((knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE) || (len == 0) || (len >= KNX_PHY_TX_MAX_FRAME_LEN))
+	{
+		return KNX_PHY_DATA_REQ_ERROR;
+	}
+	if (!knx_phy_tx_acquire(KNX_PHY_TX_FRAME))
+	{
+		return KNX_PHY_DATA_REQ_BUSY;
+	}
+	// Una única pasada: prefijo U_L_DATA_START / CONTINUE + índice para cada
+	// octeto, acumulando el checksum, y U_L_DATA_END + índice de CHK (len,
+	// porque frame no lo incluye) para el checksum
+	for (i = 0; i < len; i++)
+	{
+		*p++ = KNX_TPUART_COMMAND_U_L_DATA_CONTINUE + i;
+		*p++ = frame[i];
+		chk ^= frame[i];
+	}
+	*p++ = KNX_TPUART_COMMAND_U_L_DATA_END + len;
+	*p++ = chk;
+
+	knx_phy_tx_con_status = KNX_PHY_DATA_CON_STATUS_END;
+	knx_phy_tx_data = chk;
+	knx_phy_tx_frame_len = (uint8_t)(p - knx_phy_tx_buffer);
+	knx_phy_tx_frame_pos = 0;
+	if (!knx_phy_tx_frame_next())
+	{
+		knx_phy_tx_kind = KNX_PHY_TX_NONE;
+		return KNX_PHY_DATA_REQ_BUSY;
+	}
+	return KNX_PHY_DATA_REQ_OK;
+}
+
+
+
+void knx_phy_data_ind_release (knx_phy_frame_t *frame)
+{
+	if (frame == NULL)
+	{
+		return;
+	}
+	knx_pool_free(knx_pool_owns(&knx_phy_rx_std_pool, frame) ? &knx_phy_rx_std_pool : &knx_phy_rx_ext_pool, frame);
+}
+
+osEvent knx_phy_data_con_get (uint32_t millisec)
+{
+#ifdef KNX_PHY_DATA_CON_USE_NOTIFY
+	return knx_phy_mailbox_get(&knx_phy_data_con_mbox, millisec);
+#else
+	return osMessageGet(knx_phy_data_conHandle, millisec);
+#endif
+}
+
+osEvent knx_phy_data_ind_get (uint32_t millisec)
+{
+#ifdef KNX_PHY_DATA_IND_USE_NOTIFY
+	return knx_phy_mailbox_get(&knx_phy_data_ind_mbox, millisec);
+#else
+	return osMessageGet(knx_phy_data_indHandle, millisec);
+#endif
+}
+
+
+#ifdef KNX_PHY_RX_STATS
+void knx_phy_get_rx_stats (knx_phy_rx_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = knx_phy_rx_stats;
+	taskEXIT_CRITICAL();
+}
+
+void knx_phy_reset_rx_stats (void)
+{
+	taskENTER_CRITICAL();
+	memset(&knx_phy_rx_stats, 0, sizeof(knx_phy_rx_stats));
+	taskEXIT_CRITICAL();
+}
+
+void knx_phy_rx_replay (uint8_t data, uint32_t tick)
+{
+	knx_phy_rx_octet(data, tick);
 }
+#endif
 
 
 
-/* ----------------------- SECCIÃ“N 2.C: General  -------------------------- */
+/* ----------------------- SECCIÓN 2.C: Busmonitor  ----------------------- */
+
+
+uint32_t knx_phy_state_req (void)
+{
+	if ((knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE) || !knx_phy_tx_acquire(KNX_PHY_TX_COMMAND))
+	{
+		return KNX_PHY_STATE_REQ_ERROR;
+	}
+	knx_phy_command = KNX_TPUART_COMMAND_U_STATE_REQUEST;
+	if (KNX_PHY_UART_TRANSMIT_IT(&knx_phy_command, 1) != 0)
+	{
+		knx_phy_tx_kind = KNX_PHY_TX_NONE;
+		return KNX_PHY_STATE_REQ_ERROR;
+	}
+	return KNX_PHY_STATE_REQ_OK;
+}
+
+uint8_t knx_phy_get_tpuart_state (void)
+{
+	return knx_phy_tpuart_state;
+}
+
+
+
+uint32_t knx_phy_busmon_req (void)
+{
+	if ((knx_link_get_comm_state() != KNX_LINK_MONITOR_STATE) || !knx_phy_tx_acquire(KNX_PHY_TX_COMMAND))
+	{
+		return KNX_PHY_BUSMON_REQ_ERROR;
+	}
+	knx_phy_command = KNX_TPUART_COMMAND_U_ACTIVATE_BUSMON;
+	if (KNX_PHY_UART_TRANSMIT_IT(&knx_phy_command, 1) != 0)
+	{
+		knx_phy_tx_kind = KNX_PHY_TX_NONE;
+		return KNX_PHY_BUSMON_REQ_ERROR;
+	}
+	return KNX_PHY_BUSMON_REQ_OK;
+}
+
+
+
+/* ----------------------- SECCIÃ“N 2.D: General  -------------------------- */
 
 
 void knx_phy_init (void)
 {
+	knx_phy_fsm_state = KNX_PHY_FSM_E_CTRL;
+	knx_phy_reset_attempt = 0;
+	knx_phy_rx_frame = NULL;
+	knx_pool_init(&knx_phy_rx_std_pool, "phy_rx_std", knx_phy_rx_std_storage,
+	              sizeof(knx_phy_frame_t) + KNX_POOL_STD_FRAME_LEN, KNX_PHY_RX_STD_FRAMES);
+	knx_pool_init(&knx_phy_rx_ext_pool, "phy_rx_ext", knx_phy_rx_ext_storage,
+	              sizeof(knx_phy_frame_t) + KNX_PHY_MAX_FRAME_LEN, KNX_PHY_RX_EXT_FRAMES);
+	knx_phy_rx_last_tick = KNX_PHY_GET_TICK();
+#ifdef KNX_PHY_RX_STATS
+	memset(&knx_phy_rx_stats, 0, sizeof(knx_phy_rx_stats));
+	// Contador de ciclos del DWT para medir el coste de la ISR. Sólo se
+	// habilita: lo comparten las run-time stats, isr_prof y knx_monitor, que
+	// sólo toleran que dé la vuelta, no que se ponga a cero
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	KNX_PHY_UART_RECEIVE_IT(&knx_phy_rx_data, 1);
 }
 
 
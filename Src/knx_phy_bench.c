@@ -0,0 +1,351 @@
+/**
+ * @file knx_phy_bench.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Latencia de entrega de Ph_Data.ind y Ph_Data.con hasta su tarea consumidora
+ *
+ * Ver knx_phy_bench.h. Todo el contenido de este fichero queda excluido de la
+ * compilación si no se define la macro KNX_PHY_BENCH.
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>         // Para los tipos uintXX_t
+#include <stddef.h>         // Para NULL
+#include "knx_phy_bench.h"  // Para las declaraciones públicas de este módulo
+
+#ifdef KNX_PHY_BENCH
+
+#include "cmsis_os.h"       // Para osDelay
+#include "stm32f4xx.h"      // Para el acceso al DWT (CMSIS)
+#include "stm32f4xx_hal.h"  // Para HAL_GetTick y el control de la interrupción de la UART
+#include "knx_phy.h"        // Para knx_phy_rx_replay, knx_phy_frame_req y las estadísticas de la recepción
+#include "knx_phy_support.h" // Para las constantes de las tramas KNX
+#include "knx_link.h"       // Para las direcciones de este sistema
+#include "helpers.h"        // Para appendString y appendUnsignedInt
+#include "debug_repo.h"     // Para el envío del resultado
+
+#ifndef KNX_PHY_RX_STATS
+#error "knx_phy_bench necesita KNX_PHY_RX_STATS (ver knx_phy.h)"
+#endif
+
+/* --------------------------- Macros privadas ---------------------------- */
+
+/* Interrupción de la UART conectada a la TP-UART (huart3) */
+#define KNX_PHY_BENCH_UART_IRQn     USART3_IRQn
+
+/* Octetos de LSDU de las tramas de DATA_IND */
+#define KNX_PHY_BENCH_LSDU_LEN      2
+
+/* Longitud de las tramas de DATA_IND: CTRL SA SA DA DA AT/LSDU/LG, LSDU y CHK */
+#define KNX_PHY_BENCH_FRAME_LEN     (6 + KNX_PHY_BENCH_LSDU_LEN + 1)
+
+/* Valor de knx_phy_bench_pending sin inyección en curso */
+#define KNX_PHY_BENCH_NONE          KNX_PHY_BENCH_NUM_IDS
+
+/* Trama que se sube a la TP-UART en la comprobación del ACK: octetos de LSDU
+   (20 octetos de trama, 42 con los prefijos U_L_DATA: unos 48 ms a 9600
+   baudios) y espera (en ms) antes de recibir la trama dirigida, para que
+   llegue con la subida a medias */
+#define KNX_PHY_BENCH_TX_LSDU_LEN   14
+#define KNX_PHY_BENCH_TX_LEN        (6 + KNX_PHY_BENCH_TX_LSDU_LEN)
+#define KNX_PHY_BENCH_TX_DELAY_MS   5
+
+/* Espera (en ms) a que terminen la subida, la transmisión en el bus (con sus
+   repeticiones si nadie la reconoce) y el L_Data.con */
+#define KNX_PHY_BENCH_TX_SETTLE_MS  300
+
+/* Longitud máxima de una línea de knx_phy_bench_run() */
+#define KNX_PHY_BENCH_LINE_MAXLEN   112
+
+/* ------------------------- Variables privadas --------------------------- */
+
+/**
+ * Primitiva cuya entrega se está midiendo (KNX_PHY_BENCH_NONE si ninguna)
+ * y valor de DWT->CYCCNT justo antes de inyectar el octeto que la completa
+ */
+static volatile uint32_t knx_phy_bench_pending = KNX_PHY_BENCH_NONE;
+static volatile uint32_t knx_phy_bench_start;
+
+/**
+ * Resultado de cada primitiva
+ */
+static knx_phy_bench_stats_t knx_phy_bench_stats[KNX_PHY_BENCH_NUM_IDS];
+
+/**
+ * Trama de DATA_IND en construcción
+ */
+static uint8_t knx_phy_bench_frame[KNX_PHY_BENCH_FRAME_LEN];
+
+/**
+ * Nombres de las primitivas en el resultado, en el orden de knx_phy_bench_id_t
+ */
+static const char * const knx_phy_bench_names[KNX_PHY_BENCH_NUM_IDS] = {
+    "DATA_IND",
+    "DATA_CON"
+};
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+/**
+ * @brief Construir una trama de DATA_IND
+ * @param[in] seq Número de secuencia (distingue el contenido de la LSDU)
+ *
+ * @returns Nada
+ */
+static void knx_phy_bench_build (uint32_t seq);
+
+/**
+ * @brief Inyectar octetos como si los entregase la TP-UART, midiendo el último
+ * @param[in] id   Primitiva que completa el último octeto
+ * @param[in] data Octetos
+ * @param[in] len  Número de octetos
+ *
+ * @returns Nada
+ */
+static void knx_phy_bench_inject (knx_phy_bench_id_t id, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Enviar el resultado de una primitiva a través de debug_repo
+ * @param[in] id Primitiva
+ *
+ * @returns Nada
+ */
+static void knx_phy_bench_report (knx_phy_bench_id_t id);
+
+/**
+ * @brief Comprobar que el ACK de una trama recibida sale durante la subida de otra
+ * @param[in] seq Número de secuencia de la trama recibida
+ *
+ * Pide la transmisión de una trama con knx_phy_frame_req y, con la subida a la
+ * TP-UART a medias, inyecta una trama dirigida a este sistema. Su ACK debe
+ * intercalarse entre dos tramos de la subida (acks_deferred) y no perderse
+ * (acks_missed). Envía el resultado a través de debug_repo.
+ *
+ * @returns Nada
+ */
+static void knx_phy_bench_ack_during_tx (uint32_t seq);
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+static void knx_phy_bench_build (uint32_t seq)
+{
+	uint8_t *p = knx_phy_bench_frame;
+	uint16_t sa = knx_link_get_ind_address() ^ 0x0100;
+	uint8_t chk = 0xFF;
+	uint32_t i;
+
+	*p++ = KNX_DATA_FRAME_CTRL_FIXED_VALUE | KNX_DATA_FRAME_CTRL_FT__STANDARD |
+	       KNX_DATA_FRAME_CTRL_REP__NONREPEATED | KNX_DATA_FRAME_CTRL_PRIO__LOW;
+	*p++ = (uint8_t)(sa >> 8);
+	*p++ = (uint8_t)sa;
+	*p++ = (uint8_t)(KNX_PHY_BENCH_GRP_ADDRESS >> 8);
+	*p++ = (uint8_t)KNX_PHY_BENCH_GRP_ADDRESS;
+	*p++ = KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_GROUP | ((6 << KNX_STD_FRAME_ATLSDULG_LSDU_SHIFT) & KNX_STD_FRAME_ATLSDULG_LSDU_MASK) |
+	       ((KNX_PHY_BENCH_LSDU_LEN - 1) & KNX_STD_FRAME_ATLSDULG_LG_MASK);
+	for (i = 0; i < KNX_PHY_BENCH_LSDU_LEN; i++)
+	{
+		*p++ = (uint8_t)(seq + i);
+	}
+	for (i = 0; i < (KNX_PHY_BENCH_FRAME_LEN - 1); i++)
+	{
+		chk ^= knx_phy_bench_frame[i];
+	}
+	*p = chk;
+}
+
+static void knx_phy_bench_inject (knx_phy_bench_id_t id, const uint8_t *data, uint32_t len)
+{
+	uint32_t i, tick;
+
+	// La UART real no puede intercalar octetos. Las tareas consumidoras tienen
+	// más prioridad: cada entrega las despierta dentro de knx_phy_rx_replay
+	HAL_NVIC_DisableIRQ(KNX_PHY_BENCH_UART_IRQn);
+	tick = HAL_GetTick();
+	for (i = 0; i < (len - 1); i++)
+	{
+		knx_phy_rx_replay(data[i], tick);
+	}
+	knx_phy_bench_start = DWT->CYCCNT;
+	knx_phy_bench_pending = id;
+	knx_phy_rx_replay(data[len - 1], tick);
+	if (knx_phy_bench_pending != KNX_PHY_BENCH_NONE)
+	{
+		// Primitiva descartada (cola llena, trama rechazada...) o consumidora ocupada
+		knx_phy_bench_pending = KNX_PHY_BENCH_NONE;
+		knx_phy_bench_stats[id].missed++;
+	}
+	HAL_NVIC_EnableIRQ(KNX_PHY_BENCH_UART_IRQn);
+}
+
+static void knx_phy_bench_report (knx_phy_bench_id_t id)
+{
+	static char line[KNX_PHY_BENCH_LINE_MAXLEN];
+	char *end = &line[KNX_PHY_BENCH_LINE_MAXLEN - 3];
+	char *p;
+	knx_phy_bench_stats_t *stats = &knx_phy_bench_stats[id];
+	uint32_t notify;
+
+#ifdef KNX_PHY_DATA_IND_USE_NOTIFY
+	notify = (id == KNX_PHY_BENCH_DATA_IND);
+#else
+	notify = 0;
+#endif
+#ifdef KNX_PHY_DATA_CON_USE_NOTIFY
+	notify |= (id == KNX_PHY_BENCH_DATA_CON);
+#endif
+	p = appendString(line, end, "[knxbench] ");
+	p = appendString(p, end, knx_phy_bench_names[id]);
+	p = appendString(p, end, notify ? " mode=notify" : " mode=queue");
+	p = appendUnsignedInt(p, end, " n=", stats->count);
+	p = appendUnsignedInt(p, end, " missed=", stats->missed);
+	p = appendUnsignedInt(p, end, " min=", (stats->count > 0) ? stats->min : 0);
+	p = appendUnsignedInt(p, end, " max=", stats->max);
+	p = appendUnsignedInt(p, end, " mean=", (stats->count > 0) ? (uint32_t)(stats->total / stats->count) : 0);
+	if (p == NULL)
+	{
+		return;
+	}
+	*p++ = '\r';
+	*p++ = '\n';
+	*p = '\0';
+	debugrepoInsertMsg(line);
+}
+
+static void knx_phy_bench_ack_during_tx (uint32_t seq)
+{
+	static char line[KNX_PHY_BENCH_LINE_MAXLEN];
+	static uint8_t tx[KNX_PHY_BENCH_TX_LEN];
+	char *end = &line[KNX_PHY_BENCH_LINE_MAXLEN - 3];
+	char *p;
+	uint8_t *q = tx;
+	uint16_t sa = knx_link_get_ind_address();
+	uint16_t da = KNX_PHY_BENCH_GRP_ADDRESS + 1;
+	knx_phy_rx_stats_t stats;
+	uint32_t i, tick, req, pass;
+
+	*q++ = KNX_DATA_FRAME_CTRL_FIXED_VALUE | KNX_DATA_FRAME_CTRL_FT__STANDARD |
+	       KNX_DATA_FRAME_CTRL_REP__NONREPEATED | KNX_DATA_FRAME_CTRL_PRIO__LOW;
+	*q++ = (uint8_t)(sa >> 8);
+	*q++ = (uint8_t)sa;
+	*q++ = (uint8_t)(da >> 8);
+	*q++ = (uint8_t)da;
+	*q++ = KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_GROUP | ((6 << KNX_STD_FRAME_ATLSDULG_LSDU_SHIFT) & KNX_STD_FRAME_ATLSDULG_LSDU_MASK) |
+	       ((KNX_PHY_BENCH_TX_LSDU_LEN - 1) & KNX_STD_FRAME_ATLSDULG_LG_MASK);
+	for (i = 0; i < KNX_PHY_BENCH_TX_LSDU_LEN; i++)
+	{
+		*q++ = (uint8_t)i;
+	}
+	knx_phy_bench_build(seq);
+	knx_phy_reset_rx_stats();
+
+	req = knx_phy_frame_req(tx, KNX_PHY_BENCH_TX_LEN);
+	if (req == KNX_PHY_DATA_REQ_OK)
+	{
+		osDelay(KNX_PHY_BENCH_TX_DELAY_MS);
+		// La subida sólo avanza desde la interrupción de la UART: mientras se
+		// inyecta la trama queda detenida al final del tramo en curso
+		HAL_NVIC_DisableIRQ(KNX_PHY_BENCH_UART_IRQn);
+		tick = HAL_GetTick();
+		for (i = 0; i < KNX_PHY_BENCH_FRAME_LEN; i++)
+		{
+			knx_phy_rx_replay(knx_phy_bench_frame[i], tick);
+		}
+		HAL_NVIC_EnableIRQ(KNX_PHY_BENCH_UART_IRQn);
+		osDelay(KNX_PHY_BENCH_TX_SETTLE_MS);
+	}
+	knx_phy_get_rx_stats(&stats);
+	pass = (req == KNX_PHY_DATA_REQ_OK) && (stats.acks_deferred == 1) && (stats.acks_missed == 0);
+
+	p = appendString(line, end, "[knxbench] ACK_DURING_TX");
+	p = appendString(p, end, (req == KNX_PHY_DATA_REQ_OK) ? " req=ok" : " req=busy");
+	p = appendUnsignedInt(p, end, " deferred=", stats.acks_deferred);
+	p = appendUnsignedInt(p, end, " missed=", stats.acks_missed);
+	p = appendUnsignedInt(p, end, " wait_max=", stats.ack_defer_cycles_max);
+	p = appendString(p, end, pass ? " PASS" : " FAIL");
+	if (p == NULL)
+	{
+		return;
+	}
+	*p++ = '\r';
+	*p++ = '\n';
+	*p = '\0';
+	debugrepoInsertMsg(line);
+}
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+void knx_phy_bench_run (uint32_t iterations)
+{
+	static const uint8_t con = KNX_TPUART_L_DATA_CONFIRMATION_POS;
+	uint32_t i, id;
+
+	if (knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE)
+	{
+		debugrepoInsertMsg("[knxbench] ERROR link\r\n");
+		return;
+	}
+	knx_link_add_grp_address(KNX_PHY_BENCH_GRP_ADDRESS);
+
+	for (id = 0; id < KNX_PHY_BENCH_NUM_IDS; id++)
+	{
+		knx_phy_bench_stats[id].count = 0;
+		knx_phy_bench_stats[id].missed = 0;
+		knx_phy_bench_stats[id].min = UINT32_MAX;
+		knx_phy_bench_stats[id].max = 0;
+		knx_phy_bench_stats[id].total = 0;
+	}
+
+	for (i = 0; i < iterations; i++)
+	{
+		knx_phy_bench_build(i);
+		knx_phy_bench_inject(KNX_PHY_BENCH_DATA_IND, knx_phy_bench_frame, KNX_PHY_BENCH_FRAME_LEN);
+		osDelay(KNX_PHY_BENCH_GAP_MS);
+	}
+	for (i = 0; i < iterations; i++)
+	{
+		knx_phy_bench_inject(KNX_PHY_BENCH_DATA_CON, &con, 1);
+		osDelay(KNX_PHY_BENCH_GAP_MS);
+	}
+
+	for (id = 0; id < KNX_PHY_BENCH_NUM_IDS; id++)
+	{
+		knx_phy_bench_report((knx_phy_bench_id_t)id);
+	}
+
+	knx_phy_bench_ack_during_tx(iterations);
+}
+
+void knx_phy_bench_delivered (knx_phy_bench_id_t id)
+{
+	uint32_t cycles = DWT->CYCCNT - knx_phy_bench_start;
+	knx_phy_bench_stats_t *stats = &knx_phy_bench_stats[id];
+
+	if (knx_phy_bench_pending != (uint32_t)id)
+	{
+		return;
+	}
+	knx_phy_bench_pending = KNX_PHY_BENCH_NONE;
+	stats->count++;
+	stats->total += cycles;
+	if (cycles < stats->min)
+	{
+		stats->min = cycles;
+	}
+	if (cycles > stats->max)
+	{
+		stats->max = cycles;
+	}
+}
+
+void knx_phy_bench_get_stats (knx_phy_bench_id_t id, knx_phy_bench_stats_t *stats)
+{
+	*stats = knx_phy_bench_stats[id];
+}
+
+#endif /* KNX_PHY_BENCH */
+
+/* @} */
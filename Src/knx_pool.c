@@ -0,0 +1,186 @@
+/**
+ * @file knx_pool.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Pilas de bloques de tamaño fijo para los descriptores de trama
+ *
+ * Ver knx_pool.h
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>     // Para los tipos uintXX_t
+#include <stddef.h>     // Para NULL
+#include "knx_pool.h"   // Para las declaraciones públicas de este módulo
+#include "stm32f4xx.h"  // Para __LDREXW, __STREXW, __CLREX (CMSIS)
+
+/* ------------------------- Variables privadas --------------------------- */
+
+/**
+ * Pilas registradas por knx_pool_init (para knx_pool_get)
+ */
+static knx_pool_t *knx_pool_list[KNX_POOL_MAX_POOLS];
+static volatile uint32_t knx_pool_list_count;
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+/**
+ * @brief Sumar atómicamente a un contador
+ * @param[in] counter Contador
+ * @param[in] delta   Valor a sumar (puede ser negativo)
+ *
+ * @returns Nuevo valor del contador
+ */
+static uint32_t knx_pool_atomic_add (volatile uint32_t *counter, int32_t delta);
+
+/**
+ * @brief Actualizar atómicamente un máximo
+ * @param[in] max   Máximo a actualizar
+ * @param[in] value Nuevo valor observado
+ *
+ * @returns Nada
+ */
+static void knx_pool_atomic_max (volatile uint32_t *max, uint32_t value);
+
+/**
+ * @brief Dirección de un bloque a partir de su índice
+ * @param[in] pool  Pila
+ * @param[in] index Índice del bloque
+ *
+ * @returns Dirección del bloque
+ */
+static uint32_t *knx_pool_block (const knx_pool_t *pool, uint32_t index);
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+static uint32_t knx_pool_atomic_add (volatile uint32_t *counter, int32_t delta)
+{
+	uint32_t value;
+
+	do
+	{
+		value = __LDREXW(counter) + (uint32_t)delta;
+	} while (__STREXW(value, counter) != 0);
+	return value;
+}
+
+static void knx_pool_atomic_max (volatile uint32_t *max, uint32_t value)
+{
+	do
+	{
+		if (__LDREXW(max) >= value)
+		{
+			__CLREX();
+			return;
+		}
+	} while (__STREXW(value, max) != 0);
+}
+
+static uint32_t *knx_pool_block (const knx_pool_t *pool, uint32_t index)
+{
+	return (uint32_t *)(void *)&pool->storage[index * pool->block_size];
+}
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+void knx_pool_init (knx_pool_t *pool, const char *name, void *storage, uint32_t size, uint32_t count)
+{
+	uint32_t i, registered = 0;
+
+	pool->storage = (uint8_t *)storage;
+	pool->block_size = KNX_POOL_BLOCK_SIZE(size);
+	pool->count = count;
+	pool->name = name;
+	// La lista libre se encadena por índices (índice + 1, 0 = fin) guardados
+	// en la primera palabra de cada bloque libre
+	for (i = 0; i < count; i++)
+	{
+		*knx_pool_block(pool, i) = (i + 1 < count) ? (i + 2) : 0;
+	}
+	pool->used = 0;
+	pool->hwm = 0;
+	pool->failures = 0;
+	pool->free = (count > 0) ? 1 : 0;
+
+	for (i = 0; i < knx_pool_list_count; i++)
+	{
+		registered |= (knx_pool_list[i] == pool);
+	}
+	if (!registered && (knx_pool_list_count < KNX_POOL_MAX_POOLS))
+	{
+		knx_pool_list[knx_pool_list_count++] = pool;
+	}
+}
+
+void *knx_pool_alloc (knx_pool_t *pool)
+{
+	uint32_t head, next;
+	uint32_t *block;
+
+	do
+	{
+		head = __LDREXW(&pool->free);
+		if (head == 0)
+		{
+			__CLREX();
+			knx_pool_atomic_add(&pool->failures, 1);
+			return NULL;
+		}
+		// Si otro contexto reserva este bloque (y escribe en él) antes del
+		// STREX, éste falla porque ha habido una excepción entre medias
+		block = knx_pool_block(pool, head - 1);
+		next = *block;
+	} while (__STREXW(next, &pool->free) != 0);
+
+	knx_pool_atomic_max(&pool->hwm, knx_pool_atomic_add(&pool->used, 1));
+	return block;
+}
+
+void knx_pool_free (knx_pool_t *pool, void *block)
+{
+	uint32_t index;
+
+	if (block == NULL)
+	{
+		return;
+	}
+	index = (uint32_t)((uint8_t *)block - pool->storage) / pool->block_size;
+	do
+	{
+		*(uint32_t *)block = __LDREXW(&pool->free);
+	} while (__STREXW(index + 1, &pool->free) != 0);
+	knx_pool_atomic_add(&pool->used, -1);
+}
+
+uint32_t knx_pool_owns (const knx_pool_t *pool, const void *block)
+{
+	const uint8_t *p = (const uint8_t *)block;
+
+	return ((p >= pool->storage) && (p < &pool->storage[pool->count * pool->block_size])) ? 1 : 0;
+}
+
+void knx_pool_get_stats (const knx_pool_t *pool, knx_pool_stats_t *stats)
+{
+	stats->name = pool->name;
+	stats->block_size = pool->block_size;
+	stats->count = pool->count;
+	stats->used = pool->used;
+	stats->hwm = pool->hwm;
+	stats->failures = pool->failures;
+}
+
+void knx_pool_reset_stats (knx_pool_t *pool)
+{
+	pool->hwm = pool->used;
+	pool->failures = 0;
+}
+
+knx_pool_t *knx_pool_get (uint32_t index)
+{
+	return (index < knx_pool_list_count) ? knx_pool_list[index] : NULL;
+}
+
+/* @} */
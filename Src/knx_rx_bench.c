@@ -0,0 +1,512 @@
+/**
+ * @file knx_rx_bench.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Medida de la carga de la recepción KNX con tráfico sintético
+ *
+ * Ver knx_rx_bench.h. Todo el contenido de este fichero queda excluido de la
+ * compilación si no se define la macro KNX_RX_BENCH.
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>             // Para los tipos uintXX_t
+#include <stddef.h>             // Para NULL
+#include "knx_rx_bench.h"       // Para las declaraciones públicas de este módulo
+
+#ifdef KNX_RX_BENCH
+
+#include <string.h>             // Para strcmp
+#include "cmsis_os.h"           // Para osDelay y osDelayUntil
+#include "task.h"               // Para vTaskSuspendAll y xTaskResumeAll
+#include "stm32f4xx_hal.h"      // Para HAL_GetTick y el control de la interrupción de la UART
+#include "knx_phy.h"            // Para knx_phy_rx_replay y las estadísticas de la recepción
+#include "knx_phy_support.h"    // Para las constantes de las tramas KNX
+#include "knx_link.h"           // Para las direcciones de este sistema
+#include "knx_pool.h"           // Para la ocupación de las pilas de descriptores
+#include "helpers.h"            // Para appendString y appendUnsignedInt
+#include "debug_repo.h"         // Para el envío del resultado
+
+#ifndef KNX_PHY_RX_STATS
+#error "knx_rx_bench necesita KNX_PHY_RX_STATS (ver knx_phy.h)"
+#endif
+
+/* --------------------------- Macros privadas ---------------------------- */
+
+/* Interrupción de la UART conectada a la TP-UART (huart3) */
+#define KNX_RX_BENCH_UART_IRQn          USART3_IRQn
+
+/* Temporización del bus TP1: 9600 bit/s, 13 bits por carácter (11 más 2 de
+   pausa) y, tras el último, 15 de pausa, el carácter de ACK y 50 de silencio */
+#define KNX_RX_BENCH_BIT_RATE           9600
+#define KNX_RX_BENCH_OCTET_BITS         13
+#define KNX_RX_BENCH_FRAME_GAP_BITS     (15 - 2 + 11 + 50)
+
+/* Espera tras la última trama de cada carga para que se vacíen las colas (en ms) */
+#define KNX_RX_BENCH_SETTLE_MS          100
+
+/* Longitud máxima de una línea de knx_rx_bench_run() */
+#define KNX_RX_BENCH_LINE_MAXLEN        256
+
+/* Comprobación de checksum: bit que se cambia en el octeto elegido, número
+   de secuencia de las tramas (distinto de los de knx_rx_bench_run, para que
+   no se tomen por repeticiones) y valor de got sin entrega */
+#define KNX_RX_BENCH_CHK_FLIP_MASK      0x01
+#define KNX_RX_BENCH_CHK_SEQ            0x80
+#define KNX_RX_BENCH_CHK_NONE           0xFF
+
+/* Nombres de las pilas de descriptores de recepción (ver knx_phy_init) */
+#define KNX_RX_BENCH_STD_POOL           "phy_rx_std"
+#define KNX_RX_BENCH_EXT_POOL           "phy_rx_ext"
+
+/* ----------------------- Tipos de datos privados ------------------------ */
+
+/**
+ * Tipo estructurado con la descripción de una trama de la mezcla de tráfico
+ */
+struct knx_rx_bench_kind_s {
+    uint8_t ext;                    /**< 1 para trama extendida                 */
+    uint8_t group;                  /**< 1 si DA es una dirección de grupo      */
+    uint8_t ours;                   /**< 1 si DA es de este sistema             */
+    uint8_t lsdu_len;               /**< Octetos de LSDU                        */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef struct knx_rx_bench_kind_s knx_rx_bench_kind_t;
+
+/**
+ * Tipo enumerado con el octeto que se corrompe en la comprobación de checksum
+ */
+enum knx_rx_bench_flip_e {
+    KNX_RX_BENCH_FLIP_NONE,         /**< Trama intacta (referencia)             */
+    KNX_RX_BENCH_FLIP_HEADER,       /**< Octeto bajo de SA                      */
+    KNX_RX_BENCH_FLIP_LSDU,         /**< Primer octeto de LSDU                  */
+    KNX_RX_BENCH_FLIP_CHK,          /**< CHK                                    */
+    KNX_RX_BENCH_NUM_FLIPS          /**< Número de casos (no es uno)            */
+};
+/**
+ * Redefinición con typedef para usar una única palabra
+ */
+typedef enum knx_rx_bench_flip_e knx_rx_bench_flip_t;
+
+/* ------------------------- Variables privadas --------------------------- */
+
+/**
+ * Mezcla de tráfico, que se repite cíclicamente
+ */
+static const knx_rx_bench_kind_t knx_rx_bench_mix[] = {
+    { 0, 1, 1,  2 },                /* Escritura de grupo corta                 */
+    { 0, 1, 0,  2 },                /* Escritura de grupo para otro sistema     */
+    { 0, 0, 1,  4 },                /* Individual para este sistema             */
+    { 0, 0, 0,  8 },                /* Individual para otro sistema             */
+    { 1, 1, 1, 40 },                /* Extendida de grupo para este sistema     */
+    { 0, 1, 1, 16 },                /* Estándar de grupo de longitud máxima     */
+    { 1, 0, 0, 60 },                /* Extendida individual para otro sistema   */
+    { 0, 1, 0,  1 }                 /* Estándar mínima para otro sistema        */
+};
+
+/**
+ * Cargas medidas, en % del tiempo de la línea
+ */
+static const uint8_t knx_rx_bench_loads[] = { 25, 50, 75, 100 };
+
+/**
+ * Tramas de la comprobación de checksum, ambas dirigidas a este sistema
+ */
+static const knx_rx_bench_kind_t knx_rx_bench_chk_kinds[] = {
+    { 0, 1, 1,  2 },                /* Estándar                                 */
+    { 1, 1, 1, 20 }                 /* Extendida                                */
+};
+
+/**
+ * Nombres de los casos en el resultado, en el orden de knx_rx_bench_flip_t
+ */
+static const char * const knx_rx_bench_flip_names[KNX_RX_BENCH_NUM_FLIPS] = {
+    "none",
+    "header",
+    "lsdu",
+    "chk"
+};
+
+/**
+ * Trama en construcción y línea del resultado
+ */
+static uint8_t knx_rx_bench_frame[KNX_PHY_MAX_FRAME_LEN];
+static char knx_rx_bench_line[KNX_RX_BENCH_LINE_MAXLEN];
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+/**
+ * @brief Construir una trama de la mezcla de tráfico
+ * @param[in] kind Descripción de la trama
+ * @param[in] seq  Número de secuencia (distingue el contenido de la LSDU)
+ *
+ * @returns Octetos de la trama en knx_rx_bench_frame (incluido CHK)
+ */
+static uint32_t knx_rx_bench_build (const knx_rx_bench_kind_t *kind, uint32_t seq);
+
+/**
+ * @brief Inyectar una trama completa como si la entregase la TP-UART
+ * @param[in] len Octetos de knx_rx_bench_frame
+ *
+ * @returns Nada
+ */
+static void knx_rx_bench_inject (uint32_t len);
+
+/**
+ * @brief Poner a cero las estadísticas de la recepción y de sus pilas de descriptores
+ *
+ * @returns Nada
+ */
+static void knx_rx_bench_reset (void);
+
+/**
+ * @brief Máximo de bloques en uso de una pila de descriptores
+ * @param[in] name Nombre de la pila
+ *
+ * @returns Máximo histórico desde @ref knx_rx_bench_reset (0 si no existe)
+ */
+static uint32_t knx_rx_bench_pool_hwm (const char *name);
+
+/**
+ * @brief Enviar el resultado de una carga a través de debug_repo
+ * @param[in] load Carga en %
+ *
+ * @returns Nada
+ */
+static void knx_rx_bench_report (uint32_t load);
+
+/**
+ * @brief Inyectar una trama corrompida y comprobar su señalización
+ * @param[in] queue Cola a la que knxRxTask reenvía lo que entrega Ph_Data.ind
+ * @param[in] kind  Descripción de la trama
+ * @param[in] flip  Octeto que se corrompe
+ * @param[in] seq   Número de secuencia
+ *
+ * Envía el resultado del caso a través de debug_repo.
+ *
+ * @returns 1 si el resultado es el esperado, 0 si no
+ */
+static uint32_t knx_rx_bench_chk_case (osMessageQId queue, const knx_rx_bench_kind_t *kind,
+                                       knx_rx_bench_flip_t flip, uint32_t seq);
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+static uint32_t knx_rx_bench_build (const knx_rx_bench_kind_t *kind, uint32_t seq)
+{
+	uint8_t *p = knx_rx_bench_frame;
+	uint16_t sa = knx_link_get_ind_address() ^ 0x0100;
+	uint16_t da;
+	uint8_t at, ctrl, chk;
+	uint32_t i, len;
+
+	if (kind->group)
+	{
+		da = kind->ours ? KNX_RX_BENCH_GRP_ADDRESS : (KNX_RX_BENCH_GRP_ADDRESS + 1);
+	}
+	else
+	{
+		da = kind->ours ? knx_link_get_ind_address() : (knx_link_get_ind_address() ^ 0x0001);
+	}
+	ctrl = KNX_DATA_FRAME_CTRL_FIXED_VALUE | KNX_DATA_FRAME_CTRL_REP__NONREPEATED | KNX_DATA_FRAME_CTRL_PRIO__LOW;
+	if (kind->ext)
+	{
+		// CTRL CTRLE SA SA DA DA LG
+		at = kind->group ? KNX_EXT_FRAME_CTRLE_AT_SHIFT__DA_GROUP : KNX_EXT_FRAME_CTRLE_AT_SHIFT__DA_INDIVIDUAL;
+		*p++ = ctrl | KNX_DATA_FRAME_CTRL_FT__EXTENDED;
+		*p++ = at | ((6 << KNX_EXT_FRAME_CTRLE_HOP_SHIFT) & KNX_EXT_FRAME_CTRLE_HOP_MASK);
+	}
+	else
+	{
+		// CTRL SA SA DA DA AT/LSDU/LG
+		at = kind->group ? KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_GROUP : KNX_STD_FRAME_ATLSDULG_AT_SHIFT__DA_INDIVIDUAL;
+		*p++ = ctrl | KNX_DATA_FRAME_CTRL_FT__STANDARD;
+	}
+	*p++ = (uint8_t)(sa >> 8);
+	*p++ = (uint8_t)sa;
+	*p++ = (uint8_t)(da >> 8);
+	*p++ = (uint8_t)da;
+	if (kind->ext)
+	{
+		*p++ = kind->lsdu_len - 1;
+	}
+	else
+	{
+		*p++ = at | ((6 << KNX_STD_FRAME_ATLSDULG_LSDU_SHIFT) & KNX_STD_FRAME_ATLSDULG_LSDU_MASK) |
+		       ((kind->lsdu_len - 1) & KNX_STD_FRAME_ATLSDULG_LG_MASK);
+	}
+	for (i = 0; i < kind->lsdu_len; i++)
+	{
+		*p++ = (uint8_t)(seq + i);
+	}
+	len = (uint32_t)(p - knx_rx_bench_frame);
+	for (i = 0, chk = 0xFF; i < len; i++)
+	{
+		chk ^= knx_rx_bench_frame[i];
+	}
+	*p = chk;
+	return len + 1;
+}
+
+static void knx_rx_bench_inject (uint32_t len)
+{
+	uint32_t i, tick;
+
+	// Como en la ISR: las tareas que despierte la trama no se ejecutan hasta
+	// terminarla, y la UART real no puede intercalar octetos
+	vTaskSuspendAll();
+	HAL_NVIC_DisableIRQ(KNX_RX_BENCH_UART_IRQn);
+	tick = HAL_GetTick();
+	for (i = 0; i < len; i++)
+	{
+		knx_phy_rx_replay(knx_rx_bench_frame[i], tick);
+	}
+	HAL_NVIC_EnableIRQ(KNX_RX_BENCH_UART_IRQn);
+	xTaskResumeAll();
+}
+
+static void knx_rx_bench_reset (void)
+{
+	knx_pool_t *pool;
+	knx_pool_stats_t stats;
+	uint32_t i;
+
+	knx_phy_reset_rx_stats();
+	for (i = 0; (pool = knx_pool_get(i)) != NULL; i++)
+	{
+		knx_pool_get_stats(pool, &stats);
+		if ((strcmp(stats.name, KNX_RX_BENCH_STD_POOL) == 0) || (strcmp(stats.name, KNX_RX_BENCH_EXT_POOL) == 0))
+		{
+			knx_pool_reset_stats(pool);
+		}
+	}
+}
+
+static uint32_t knx_rx_bench_pool_hwm (const char *name)
+{
+	knx_pool_t *pool;
+	knx_pool_stats_t stats;
+	uint32_t i;
+
+	for (i = 0; (pool = knx_pool_get(i)) != NULL; i++)
+	{
+		knx_pool_get_stats(pool, &stats);
+		if (strcmp(stats.name, name) == 0)
+		{
+			return stats.hwm;
+		}
+	}
+	return 0;
+}
+
+static void knx_rx_bench_report (uint32_t load)
+{
+	char *end = &knx_rx_bench_line[KNX_RX_BENCH_LINE_MAXLEN - 3];
+	char *p;
+	knx_phy_rx_stats_t stats;
+
+	knx_phy_get_rx_stats(&stats);
+	p = appendUnsignedInt(knx_rx_bench_line, end, "[rxbench] load=", load);
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+	p = appendString(p, end, " mode=octet");
+#else
+	p = appendString(p, end, " mode=frame");
+#endif
+	p = appendUnsignedInt(p, end, " frames=", stats.frames);
+	p = appendUnsignedInt(p, end, " ind=", stats.frames_ind);
+	p = appendUnsignedInt(p, end, " cyc_frame=", (stats.frames > 0) ? (uint32_t)(stats.cycles_total / stats.frames) : 0);
+	p = appendUnsignedInt(p, end, " cyc_octet_max=", stats.cycles_max);
+	p = appendUnsignedInt(p, end, " ind_hwm=", stats.ind_queue_hwm);
+	p = appendUnsignedInt(p, end, " std_hwm=", knx_rx_bench_pool_hwm(KNX_RX_BENCH_STD_POOL));
+	p = appendUnsignedInt(p, end, " ext_hwm=", knx_rx_bench_pool_hwm(KNX_RX_BENCH_EXT_POOL));
+	p = appendUnsignedInt(p, end, " drop_frames=", stats.dropped_frames);
+	p = appendUnsignedInt(p, end, " drop_octets=", stats.dropped_octets);
+	p = appendUnsignedInt(p, end, " busy=", stats.acks_busy);
+	p = appendUnsignedInt(p, end, " nack=", stats.acks_nack);
+	p = appendUnsignedInt(p, end, " missed=", stats.acks_missed);
+	if (p == NULL)
+	{
+		return;
+	}
+	*p++ = '\r';
+	*p++ = '\n';
+	*p = '\0';
+	debugrepoInsertMsg(knx_rx_bench_line);
+}
+
+static uint32_t knx_rx_bench_chk_case (osMessageQId queue, const knx_rx_bench_kind_t *kind,
+                                       knx_rx_bench_flip_t flip, uint32_t seq)
+{
+	char *end = &knx_rx_bench_line[KNX_RX_BENCH_LINE_MAXLEN - 3];
+	char *p;
+	knx_phy_rx_stats_t before, after;
+	osEvent event;
+	uint32_t i, len, tick, pos, errors, want, pass;
+	uint32_t got = KNX_RX_BENCH_CHK_NONE;
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+	uint32_t ind_class;
+#endif
+
+	len = knx_rx_bench_build(kind, seq);
+	// SA y LSDU empiezan una posición más tarde en la trama extendida (CTRLE)
+	switch (flip)
+	{
+	case KNX_RX_BENCH_FLIP_HEADER:
+		pos = kind->ext ? 3 : 2;
+		break;
+	case KNX_RX_BENCH_FLIP_LSDU:
+		pos = kind->ext ? 7 : 6;
+		break;
+	case KNX_RX_BENCH_FLIP_CHK:
+		pos = len - 1;
+		break;
+	default:
+		pos = len;
+		break;
+	}
+	if (pos < len)
+	{
+		knx_rx_bench_frame[pos] ^= KNX_RX_BENCH_CHK_FLIP_MASK;
+	}
+
+	knx_phy_get_rx_stats(&before);
+	HAL_NVIC_DisableIRQ(KNX_RX_BENCH_UART_IRQn);
+	tick = HAL_GetTick();
+	for (i = 0; i < len; i++)
+	{
+		knx_phy_rx_replay(knx_rx_bench_frame[i], tick);
+		// knxRxTask, más prioritaria, ya ha reenviado lo entregado: recogerlo
+		// octeto a octeto para que no se llene la cola en el modo octeto a octeto
+		while ((event = osMessageGet(queue, 0)).status == osEventMessage)
+		{
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+			ind_class = (event.value.v >> 8) & 0xFF;
+			if ((ind_class == KNX_PHY_DATA_IND_CLASS_END) || (ind_class == KNX_PHY_DATA_IND_CLASS_END_CHK_ERROR))
+			{
+				got = ind_class;
+			}
+#else
+			got = ((knx_phy_frame_t *)event.value.p)->chk;
+			knx_phy_data_ind_release((knx_phy_frame_t *)event.value.p);
+#endif
+		}
+	}
+	HAL_NVIC_EnableIRQ(KNX_RX_BENCH_UART_IRQn);
+	knx_phy_get_rx_stats(&after);
+
+	errors = after.chk_errors - before.chk_errors;
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+	want = (flip == KNX_RX_BENCH_FLIP_NONE) ? KNX_PHY_DATA_IND_CLASS_END : KNX_PHY_DATA_IND_CLASS_END_CHK_ERROR;
+#else
+	want = (flip == KNX_RX_BENCH_FLIP_NONE) ? KNX_PHY_DATA_CHK_OK : KNX_PHY_DATA_CHK_ERROR;
+#endif
+	pass = (got == want) && (errors == ((flip == KNX_RX_BENCH_FLIP_NONE) ? 0 : 1));
+
+	p = appendString(knx_rx_bench_line, end, kind->ext ? "[rxchk] ft=ext" : "[rxchk] ft=std");
+	p = appendString(p, end, " flip=");
+	p = appendString(p, end, knx_rx_bench_flip_names[flip]);
+#ifdef KNX_PHY_DATA_IND_PER_OCTET
+	p = appendString(p, end, " mode=octet");
+#else
+	p = appendString(p, end, " mode=frame");
+#endif
+	p = appendUnsignedInt(p, end, " got=", got);
+	p = appendUnsignedInt(p, end, " want=", want);
+	p = appendUnsignedInt(p, end, " chk_errors=", errors);
+	p = appendString(p, end, pass ? " PASS" : " FAIL");
+	if (p != NULL)
+	{
+		*p++ = '\r';
+		*p++ = '\n';
+		*p = '\0';
+		debugrepoInsertMsg(knx_rx_bench_line);
+	}
+	return pass;
+}
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+void knx_rx_bench_run (uint32_t frames)
+{
+	const knx_rx_bench_kind_t *kind;
+	uint32_t load, i, len, wake, period_us, pending_us;
+
+	if (knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE)
+	{
+		debugrepoInsertMsg("[rxbench] ERROR link\r\n");
+		return;
+	}
+	knx_link_add_grp_address(KNX_RX_BENCH_GRP_ADDRESS);
+
+	for (load = 0; load < sizeof(knx_rx_bench_loads); load++)
+	{
+		knx_rx_bench_reset();
+		pending_us = 0;
+		wake = osKernelSysTick();
+		for (i = 0; i < frames; i++)
+		{
+			kind = &knx_rx_bench_mix[i % (sizeof(knx_rx_bench_mix) / sizeof(knx_rx_bench_mix[0]))];
+			len = knx_rx_bench_build(kind, i);
+			knx_rx_bench_inject(len);
+
+			// Siguiente trama cuando la actual (con su ACK y el silencio
+			// posterior) ocupe el porcentaje de la línea de esta carga
+			period_us = (((len * KNX_RX_BENCH_OCTET_BITS) + KNX_RX_BENCH_FRAME_GAP_BITS) * 1000000UL) /
+			            KNX_RX_BENCH_BIT_RATE;
+			pending_us += (period_us * 100) / knx_rx_bench_loads[load];
+			if (pending_us >= 1000)
+			{
+				osDelayUntil(&wake, pending_us / 1000);
+				pending_us %= 1000;
+			}
+		}
+		osDelay(KNX_RX_BENCH_SETTLE_MS);
+		knx_rx_bench_report(knx_rx_bench_loads[load]);
+	}
+}
+
+uint32_t knx_rx_bench_check_chk (osMessageQId queue)
+{
+	char *end = &knx_rx_bench_line[KNX_RX_BENCH_LINE_MAXLEN - 3];
+	char *p;
+	uint32_t k, flip, cases = 0, failed = 0;
+
+	if (knx_link_get_comm_state() != KNX_LINK_NORMAL_STATE)
+	{
+		debugrepoInsertMsg("[rxchk] ERROR link\r\n");
+		return 1;
+	}
+	knx_link_add_grp_address(KNX_RX_BENCH_GRP_ADDRESS);
+
+	for (k = 0; k < (sizeof(knx_rx_bench_chk_kinds) / sizeof(knx_rx_bench_chk_kinds[0])); k++)
+	{
+		for (flip = 0; flip < KNX_RX_BENCH_NUM_FLIPS; flip++)
+		{
+			if (!knx_rx_bench_chk_case(queue, &knx_rx_bench_chk_kinds[k], (knx_rx_bench_flip_t)flip,
+			                           KNX_RX_BENCH_CHK_SEQ + cases))
+			{
+				failed++;
+			}
+			cases++;
+		}
+	}
+
+	p = appendUnsignedInt(knx_rx_bench_line, end, "[rxchk] cases=", cases);
+	p = appendUnsignedInt(p, end, " fail=", failed);
+	if (p != NULL)
+	{
+		*p++ = '\r';
+		*p++ = '\n';
+		*p = '\0';
+		debugrepoInsertMsg(knx_rx_bench_line);
+	}
+	return failed;
+}
+
+#endif /* KNX_RX_BENCH */
+
+/* @} */
@@ -0,0 +1,109 @@
+/**
+ * @file knx_stats.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Contadores de los niveles físico y de enlace KNX
+ *
+ * Ver knx_stats.h
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>     // Para los tipos uintXX_t
+#include <string.h>     // Para memcpy
+#include "knx_stats.h"  // Para las declaraciones públicas de este módulo
+#include "stm32f4xx.h"  // Para __DMB (CMSIS)
+
+/* ----------------------- Tipos de datos privados ------------------------ */
+
+/**
+ * Bloque rx con su contador de secuencia (impar mientras se escribe)
+ */
+struct knx_stats_rx_block_s {
+    volatile uint32_t seq;
+    knx_stats_rx_t data;
+};
+
+/**
+ * Bloque tx con su contador de secuencia (impar mientras se escribe)
+ */
+struct knx_stats_tx_block_s {
+    volatile uint32_t seq;
+    knx_stats_tx_t data;
+};
+
+/* ------------------------- Variables privadas --------------------------- */
+
+static struct knx_stats_rx_block_s knx_stats_rx;
+static struct knx_stats_tx_block_s knx_stats_tx;
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+/**
+ * @brief Copiar un bloque de contadores de forma coherente
+ * @param[in]  seq  Contador de secuencia del bloque
+ * @param[out] dst  Destino de la copia
+ * @param[in]  src  Contadores del bloque
+ * @param[in]  size Tamaño de los contadores en bytes
+ *
+ * @returns Nada
+ */
+static void knx_stats_copy (const volatile uint32_t *seq, void *dst, const void *src, uint32_t size);
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+static void knx_stats_copy (const volatile uint32_t *seq, void *dst, const void *src, uint32_t size)
+{
+	uint32_t start;
+
+	do
+	{
+		// Esperar a que el escritor (que tiene más prioridad) termine
+		do
+		{
+			start = *seq;
+		} while (start & 1);
+		__DMB();
+		memcpy(dst, src, size);
+		__DMB();
+	} while (*seq != start);
+}
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+knx_stats_rx_t *knx_stats_rx_begin (void)
+{
+	knx_stats_rx.seq++;
+	__DMB();
+	return &knx_stats_rx.data;
+}
+
+void knx_stats_rx_end (void)
+{
+	__DMB();
+	knx_stats_rx.seq++;
+}
+
+knx_stats_tx_t *knx_stats_tx_begin (void)
+{
+	knx_stats_tx.seq++;
+	__DMB();
+	return &knx_stats_tx.data;
+}
+
+void knx_stats_tx_end (void)
+{
+	__DMB();
+	knx_stats_tx.seq++;
+}
+
+void knx_stats_read (knx_stats_t *stats)
+{
+	knx_stats_copy(&knx_stats_rx.seq, &stats->rx, &knx_stats_rx.data, sizeof(stats->rx));
+	knx_stats_copy(&knx_stats_tx.seq, &stats->tx, &knx_stats_tx.data, sizeof(stats->tx));
+}
+
+/* @} */
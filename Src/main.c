@@ -50,6 +50,7 @@
 #include "main.h"
 #include "stm32f4xx_hal.h"
 #include "cmsis_os.h"
+#include "dma.h"
 #include "i2c.h"
 #include "i2s.h"
 #include "spi.h"
@@ -61,6 +62,7 @@
 
 #include "helpers.h"
 #include "debug_repo.h"
+#include "isr_prof.h"
 
 /* USER CODE END Includes */
 
@@ -113,12 +115,16 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_I2C1_Init();
   MX_I2S3_Init();
   MX_SPI1_Init();
   MX_USART2_UART_Init();
   MX_USART3_UART_Init();
   /* USER CODE BEGIN 2 */
+#ifdef ISR_PROF
+  isr_prof_init();
+#endif
 
   /* USER CODE END 2 */
 
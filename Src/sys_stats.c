@@ -0,0 +1,210 @@
+/**
+ * @file sys_stats.c
+ * @author PON TU NOMBRE AQUÍ
+ * @date Otoño 2017
+ *
+ * @brief Informe periódico del uso de CPU, pila y memoria dinámica
+ *
+ * Ver sys_stats.h
+ *
+ * @{
+ */
+
+/* ---------------- #includes necesarios para este fichero ----------------- */
+
+#include <stdint.h>     // Para los tipos uintXX_t
+#include <stddef.h>     // Para NULL
+#include "FreeRTOS.h"   // Para configTOTAL_HEAP_SIZE, xPortGetFreeHeapSize
+#include "task.h"       // Para uxTaskGetSystemState
+#include "cmsis_os.h"   // Para osKernelSysTick
+#include "helpers.h"    // Para formatUnsignedInt, appendString y appendUnsignedInt
+#include "debug_repo.h" // Para el envío del informe
+#include "knx_pool.h"   // Para los contadores de las pilas de bloques
+#include "sys_stats.h"  // Para las declaraciones públicas de este módulo
+
+#if (configGENERATE_RUN_TIME_STATS != 1) || (configUSE_TRACE_FACILITY != 1)
+#error "sys_stats necesita configGENERATE_RUN_TIME_STATS y configUSE_TRACE_FACILITY"
+#endif
+
+/* --------------------------- Macros privadas ---------------------------- */
+
+/* Longitud máxima de una línea del informe */
+#define SYS_STATS_LINE_MAXLEN       (32 + configMAX_TASK_NAME_LEN + 5 * 11)
+
+/* ------------------------- Variables privadas --------------------------- */
+
+/**
+ * Estado de las tareas obtenido en el informe en curso
+ */
+static TaskStatus_t sys_stats_tasks[SYS_STATS_MAX_TASKS];
+
+/**
+ * Número y contador de ejecución de cada tarea en el informe anterior
+ */
+static UBaseType_t sys_stats_prev_number[SYS_STATS_MAX_TASKS];
+static uint32_t sys_stats_prev_runtime[SYS_STATS_MAX_TASKS];
+static uint32_t sys_stats_prev_count;
+
+/**
+ * Contador de ejecución total en el informe anterior
+ */
+static uint32_t sys_stats_prev_total;
+
+/**
+ * Línea del informe en construcción
+ */
+static char sys_stats_line[SYS_STATS_LINE_MAXLEN];
+
+/* ----------------- Declaración de funciones privadas -------------------- */
+
+
+/**
+ * @brief Terminar una línea y enviarla a través de debug_repo
+ * @param[in] p Posición de escritura (NULL si no había espacio: no se envía)
+ *
+ * @returns Nada
+ */
+static void sys_stats_send (char *p);
+
+/**
+ * @brief Tiempo de ejecución de una tarea en el informe anterior
+ * @param[in] number Número de la tarea (xTaskNumber)
+ *
+ * @returns Contador de ejecución anterior, o 0 si la tarea es nueva
+ */
+static uint32_t sys_stats_prev_runtime_of (UBaseType_t number);
+
+/**
+ * @brief Letra con la que se informa del estado de una tarea
+ * @param[in] state Estado de FreeRTOS
+ *
+ * @returns Cadena de una letra
+ */
+static const char *sys_stats_state_name (eTaskState state);
+
+/* ---------------- Implementación de funciones privadas ------------------ */
+
+
+static void sys_stats_send (char *p)
+{
+	if (p == NULL)
+	{
+		return;
+	}
+	*p++ = '\r';
+	*p++ = '\n';
+	*p = '\0';
+	debugrepoInsertMsg(sys_stats_line);
+}
+
+static uint32_t sys_stats_prev_runtime_of (UBaseType_t number)
+{
+	uint32_t i;
+
+	for (i = 0; i < sys_stats_prev_count; i++)
+	{
+		if (sys_stats_prev_number[i] == number)
+		{
+			return sys_stats_prev_runtime[i];
+		}
+	}
+	return 0;
+}
+
+static const char *sys_stats_state_name (eTaskState state)
+{
+	switch (state)
+	{
+	case eRunning:
+	case eReady:
+		return "R";
+	case eBlocked:
+		return "B";
+	case eSuspended:
+		return "S";
+	default:
+		return "D";
+	}
+}
+
+/* ---------------- Implementación de funciones públicas ------------------ */
+
+void sys_stats_report (void)
+{
+	char *end = &sys_stats_line[SYS_STATS_LINE_MAXLEN - 3];
+	char *p;
+	uint32_t i, count, total, dt, cpu;
+	knx_pool_t *pool;
+	knx_pool_stats_t pool_stats;
+
+	count = uxTaskGetSystemState(sys_stats_tasks, SYS_STATS_MAX_TASKS, &total);
+	if (count == 0)
+	{
+		// uxTaskGetSystemState no hace nada si no caben todas las tareas
+		p = appendUnsignedInt(sys_stats_line, end, "[sysstats] ERROR tasks=", uxTaskGetNumberOfTasks());
+		p = appendUnsignedInt(p, end, " max=", SYS_STATS_MAX_TASKS);
+		sys_stats_send(p);
+		return;
+	}
+	dt = total - sys_stats_prev_total;
+
+	p = appendUnsignedInt(sys_stats_line, end, "[sysstats] BEGIN t=", osKernelSysTick());
+	p = appendUnsignedInt(p, end, " dt=", dt);
+	p = appendUnsignedInt(p, end, " tasks=", count);
+	sys_stats_send(p);
+
+	for (i = 0; i < count; i++)
+	{
+		// Centésimas de porcentaje del intervalo (el producto no cabe en 32 bits)
+		cpu = (dt > 0) ? (uint32_t)(((uint64_t)(sys_stats_tasks[i].ulRunTimeCounter -
+		      sys_stats_prev_runtime_of(sys_stats_tasks[i].xTaskNumber)) * 10000) / dt) : 0;
+		p = appendString(sys_stats_line, end, "[sysstats] TASK ");
+		p = appendString(p, end, sys_stats_tasks[i].pcTaskName);
+		p = appendUnsignedInt(p, end, " prio=", sys_stats_tasks[i].uxCurrentPriority);
+		p = appendString(p, end, " state=");
+		p = appendString(p, end, sys_stats_state_name(sys_stats_tasks[i].eCurrentState));
+		p = appendUnsignedInt(p, end, " cpu=", cpu / 100);
+		p = appendString(p, end, ".");
+		if ((p != NULL) && ((end - p) >= 2))
+		{
+			p = formatUnsignedInt(p, end - p, cpu % 100, 2, '0');
+		}
+		else
+		{
+			p = NULL;
+		}
+		p = appendUnsignedInt(p, end, " hwm=", sys_stats_tasks[i].usStackHighWaterMark);
+		sys_stats_send(p);
+	}
+
+	p = appendUnsignedInt(sys_stats_line, end, "[sysstats] HEAP size=", configTOTAL_HEAP_SIZE);
+	p = appendUnsignedInt(p, end, " free=", xPortGetFreeHeapSize());
+	p = appendUnsignedInt(p, end, " min=", xPortGetMinimumEverFreeHeapSize());
+	sys_stats_send(p);
+
+	for (i = 0; (pool = knx_pool_get(i)) != NULL; i++)
+	{
+		knx_pool_get_stats(pool, &pool_stats);
+		p = appendString(sys_stats_line, end, "[sysstats] POOL ");
+		p = appendString(p, end, pool_stats.name);
+		p = appendUnsignedInt(p, end, " count=", pool_stats.count);
+		p = appendUnsignedInt(p, end, " used=", pool_stats.used);
+		p = appendUnsignedInt(p, end, " hwm=", pool_stats.hwm);
+		p = appendUnsignedInt(p, end, " fail=", pool_stats.failures);
+		sys_stats_send(p);
+	}
+
+	p = appendString(sys_stats_line, end, "[sysstats] END");
+	sys_stats_send(p);
+
+	// Contadores de referencia para el siguiente intervalo
+	for (i = 0; i < count; i++)
+	{
+		sys_stats_prev_number[i] = sys_stats_tasks[i].xTaskNumber;
+		sys_stats_prev_runtime[i] = sys_stats_tasks[i].ulRunTimeCounter;
+	}
+	sys_stats_prev_count = count;
+	sys_stats_prev_total = total;
+}
+
+/* @} */
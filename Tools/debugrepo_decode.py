@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Fichero: debugrepo_decode.py
+Proposito:
+  Decodificar en el PC la salida de la consola de debug_repo, que mezcla
+  mensajes de texto con trazas binarias (debugrepoInsertTrace).
+
+  Cada traza llega como una trama
+    0x1E | longitud (2 bytes) | marca de tiempo (4 bytes, ms) | evento (1 byte) | datos
+  con los campos multibyte en little-endian y la longitud contando los bytes
+  que la siguen (ver debug_repo.h). Las capturas del monitor del bus
+  (knx_monitor.h) usan el mismo formato, con la marca de tiempo en us.
+
+  Modos de salida:
+    text  Texto tal cual y una línea legible por cada traza (por defecto)
+    pcap  Fichero pcap (LINKTYPE_USER0) con un paquete por traza cuyo contenido
+          es el identificador de evento seguido de los datos; el texto se
+          descarta o se copia a stderr con --text-to-stderr
+
+Uso:
+  debugrepo_decode.py captura.bin
+  debugrepo_decode.py --serial /dev/ttyUSB0 --baud 115200
+  debugrepo_decode.py --format pcap -o trazas.pcap captura.bin
+"""
+
+import argparse
+import struct
+import sys
+
+TRACE_SYNC = 0x1E
+TRACE_FRAME_LEN = 3
+TRACE_HDR_LEN = 5
+# DEBUGREPO_MSG_MAXLEN - DEBUGREPO_TRACE_FRAME_LEN: una longitud mayor no
+# puede venir del equipo y se trata como texto
+TRACE_MAX_PAYLOAD = 512 - TRACE_FRAME_LEN
+
+TRACE_KNX_RX = 0x01
+TRACE_KNX_TX = 0x02
+TRACE_KNX_MON = 0x03
+EVENT_NAMES = {
+    TRACE_KNX_RX: "KNX_RX",
+    TRACE_KNX_TX: "KNX_TX",
+    TRACE_KNX_MON: "KNX_MON",
+}
+KNX_EVENTS = (TRACE_KNX_RX, TRACE_KNX_TX, TRACE_KNX_MON)
+# Eventos cuya marca de tiempo está en microsegundos (el resto en milisegundos)
+US_EVENTS = (TRACE_KNX_MON,)
+
+KNX_ACK_CHARS = {0xCC: "ACK", 0x0C: "NACK", 0xC0: "BUSY", 0x00: "NACK+BUSY"}
+
+LINKTYPE_USER0 = 147
+
+
+class TraceParser:
+    """Separa el flujo de bytes de la consola en líneas de texto y trazas.
+
+    feed() devuelve una lista de tuplas ('text', bytes) o
+    ('trace', (timestamp, event_id, data)); timestamp en ms o us
+    según el evento (ver US_EVENTS).
+    """
+
+    def __init__(self):
+        self._buf = bytearray()
+        self._text = bytearray()
+
+    def feed(self, data):
+        self._buf.extend(data)
+        out = []
+        while self._buf:
+            if self._buf[0] != TRACE_SYNC:
+                byte = self._buf.pop(0)
+                self._text.append(byte)
+                if byte == ord("\n"):
+                    out.append(("text", bytes(self._text)))
+                    self._text.clear()
+                continue
+            if len(self._buf) < TRACE_FRAME_LEN:
+                break
+            length = self._buf[1] | (self._buf[2] << 8)
+            if length < TRACE_HDR_LEN or length > TRACE_MAX_PAYLOAD:
+                # Marca de trama espuria: tratarla como texto
+                self._text.append(self._buf.pop(0))
+                continue
+            if len(self._buf) < TRACE_FRAME_LEN + length:
+                break
+            payload = bytes(self._buf[TRACE_FRAME_LEN:TRACE_FRAME_LEN + length])
+            del self._buf[:TRACE_FRAME_LEN + length]
+            if self._text:
+                out.append(("text", bytes(self._text)))
+                self._text.clear()
+            timestamp, event_id = struct.unpack_from("<IB", payload)
+            out.append(("trace", (timestamp, event_id, payload[TRACE_HDR_LEN:])))
+        return out
+
+    def flush(self):
+        out = []
+        self._text.extend(self._buf)
+        self._buf.clear()
+        if self._text:
+            out.append(("text", bytes(self._text)))
+            self._text.clear()
+        return out
+
+
+def _knx_address(addr, group):
+    if group:
+        return "%d/%d/%d" % (addr >> 11, (addr >> 8) & 0x07, addr & 0xFF)
+    return "%d.%d.%d" % (addr >> 12, (addr >> 8) & 0x0F, addr & 0xFF)
+
+
+def describe_knx_frame(data):
+    """Resumen de una trama KNX (estándar o extendida) para el modo texto."""
+    if len(data) == 1 and data[0] in KNX_ACK_CHARS:
+        return " " + KNX_ACK_CHARS[data[0]]
+    ctrl = data[0] if data else 0
+    if len(data) < 7 or (ctrl & 0x53) != 0x10:
+        return ""
+    if ctrl & 0x80:
+        src = (data[1] << 8) | data[2]
+        dst = (data[3] << 8) | data[4]
+        group = (data[5] & 0x80) != 0
+        hops = (data[5] >> 4) & 0x07
+        lg = data[5] & 0x0F
+    else:
+        if len(data) < 8:
+            return ""
+        src = (data[2] << 8) | data[3]
+        dst = (data[4] << 8) | data[5]
+        group = (data[1] & 0x80) != 0
+        hops = (data[1] >> 4) & 0x07
+        lg = data[6]
+    expected = (8 if ctrl & 0x80 else 9) + lg
+    chk = 0xFF
+    for byte in data[:-1]:
+        chk ^= byte
+    if len(data) != expected:
+        return " %s %s -> %s incompleta (%d de %d octetos)" % (
+            "std" if ctrl & 0x80 else "ext",
+            _knx_address(src, False), _knx_address(dst, group), len(data), expected)
+    return " %s %s -> %s prio=%d hops=%d lg=%d%s%s" % (
+        "std" if ctrl & 0x80 else "ext",
+        _knx_address(src, False), _knx_address(dst, group),
+        (ctrl >> 2) & 0x03, hops, lg,
+        "" if ctrl & 0x20 else " rep",
+        "" if chk == data[-1] else " chk-err")
+
+
+def timestamp_us(timestamp, event_id):
+    return timestamp if event_id in US_EVENTS else timestamp * 1000
+
+
+def format_trace(timestamp, event_id, data):
+    name = EVENT_NAMES.get(event_id, "EV")
+    line = "[trace %14.6f] %s(0x%02X) len=%d" % (timestamp_us(timestamp, event_id) / 1e6,
+                                                 name, event_id, len(data))
+    if event_id in KNX_EVENTS:
+        line += describe_knx_frame(data)
+    if data:
+        line += " : " + " ".join("%02X" % b for b in data)
+    return line
+
+
+class TextWriter:
+    def __init__(self, out):
+        self._out = out
+
+    def text(self, data):
+        self._out.write(data.decode("latin-1"))
+
+    def trace(self, timestamp, event_id, data):
+        self._out.write(format_trace(timestamp, event_id, data) + "\n")
+
+    def flush(self):
+        self._out.flush()
+
+
+class PcapWriter:
+    def __init__(self, out, text_out=None):
+        self._out = out
+        self._text_out = text_out
+        self._out.write(struct.pack("<IHHiIII", 0xA1B2C3D4, 2, 4, 0, 0, 65535, LINKTYPE_USER0))
+
+    def text(self, data):
+        if self._text_out is not None:
+            self._text_out.write(data.decode("latin-1"))
+
+    def trace(self, timestamp, event_id, data):
+        packet = bytes([event_id]) + data
+        usec = timestamp_us(timestamp, event_id)
+        self._out.write(struct.pack("<IIII", usec // 1000000, usec % 1000000,
+                                    len(packet), len(packet)))
+        self._out.write(packet)
+
+    def flush(self):
+        self._out.flush()
+
+
+def _chunks(args):
+    if args.serial:
+        try:
+            import serial
+        except ImportError:
+            sys.exit("--serial necesita el paquete pyserial")
+        port = serial.Serial(args.serial, args.baud, timeout=0.1)
+        while True:
+            data = port.read(4096)
+            if data:
+                yield data
+    else:
+        src = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+        with src:
+            while True:
+                data = src.read(4096)
+                if not data:
+                    break
+                yield data
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decodificador de la consola de debug_repo")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="fichero con la captura de la consola ('-' para stdin)")
+    parser.add_argument("--serial", help="leer directamente de un puerto serie (pyserial)")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("-f", "--format", choices=("text", "pcap"), default="text")
+    parser.add_argument("-o", "--output", help="fichero de salida (stdout por defecto)")
+    parser.add_argument("--text-to-stderr", action="store_true",
+                        help="en modo pcap, copiar los mensajes de texto a stderr")
+    args = parser.parse_args()
+
+    if args.format == "pcap":
+        out = open(args.output, "wb") if args.output else sys.stdout.buffer
+        writer = PcapWriter(out, sys.stderr if args.text_to_stderr else None)
+    else:
+        out = open(args.output, "w") if args.output else sys.stdout
+        writer = TextWriter(out)
+
+    trace_parser = TraceParser()
+    try:
+        for chunk in _chunks(args):
+            for kind, item in trace_parser.feed(chunk):
+                if kind == "text":
+                    writer.text(item)
+                else:
+                    writer.trace(*item)
+            if args.serial:
+                writer.flush()
+    except KeyboardInterrupt:
+        pass
+    for kind, item in trace_parser.flush():
+        if kind == "text":
+            writer.text(item)
+        else:
+            writer.trace(*item)
+    writer.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Fichero: stack_depth.py
+Proposito:
+  Estimar en el PC el peor consumo de pila de cada tarea a partir de los
+  grafos de llamadas que genera GCC con -fcallgraph-info=su (un fichero .ci
+  por cada .c, con el tamaño del marco de cada función y sus llamadas).
+
+  Para cada punto de entrada recorre todas las cadenas de llamadas y muestra
+  la más profunda con la suma de sus marcos. Las funciones sin marco conocido
+  (de ficheros compilados sin la opción, llamadas a través de punteros o
+  recursivas) cuentan 0 bytes y se listan aparte, para que se sumen a mano o
+  se compilen también con la opción.
+
+  El resultado es una cota para comparar con el campo hwm= de las líneas
+  [sysstats] TASK (sys_stats.h), que es la medida real en la placa. A la
+  cadena hay que añadirle el marco que apila el cambio de contexto (17
+  palabras sin contexto de FPU, 51 con él).
+
+Uso (tras compilar el proyecto añadiendo -fcallgraph-info=su a CFLAGS):
+  stack_depth.py build/*.ci
+  stack_depth.py --entry StartKnxTxTask --entry _debugrepoTask build/*.ci
+"""
+
+import argparse
+import re
+import sys
+
+# Tareas de freertos.c y la de extracción de debug_repo
+DEFAULT_ENTRIES = (
+    "StartAppTask",
+    "StartKnxRxTask",
+    "StartKnxTxTask",
+    "StartKnxHealthTask",
+    "StartSysStatsTask",
+    "_debugrepoTask",
+)
+
+NODE_RE = re.compile(r'node: \{ title: "([^"]+)" label: "[^"]*?\\n(\d+) bytes')
+EDGE_RE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+
+
+class CallGraph:
+    """Marcos de pila y llamadas leídos de los ficheros .ci."""
+
+    def __init__(self):
+        self.frames = {}
+        self.calls = {}
+
+    def load(self, path):
+        with open(path, encoding="utf-8", errors="replace") as f:
+            for line in f:
+                m = NODE_RE.match(line)
+                if m:
+                    self.frames[m.group(1)] = int(m.group(2))
+                    continue
+                m = EDGE_RE.match(line)
+                if m:
+                    self.calls.setdefault(m.group(1), set()).add(m.group(2))
+
+    def resolve(self, name):
+        """Las funciones static aparecen como 'fichero:nombre'."""
+        if name in self.frames:
+            return name
+        for title in self.frames:
+            if title.endswith(":" + name):
+                return title
+        return None
+
+    def deepest(self, fn, unknown, path=()):
+        """Devuelve (bytes, cadena) de la cadena más profunda desde fn."""
+        if fn in path:
+            unknown.add(fn + " (recursiva)")
+            return 0, []
+        if fn not in self.frames:
+            unknown.add(fn)
+            return 0, []
+        best = (0, [])
+        for callee in sorted(self.calls.get(fn, ())):
+            depth = self.deepest(callee, unknown, path + (fn,))
+            if depth[0] > best[0]:
+                best = depth
+        return self.frames[fn] + best[0], [fn] + best[1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Peor cadena de llamadas por tarea (GCC -fcallgraph-info=su)")
+    parser.add_argument("ci", nargs="+", help="Ficheros .ci")
+    parser.add_argument("--entry", action="append", help="Punto de entrada (se puede repetir)")
+    args = parser.parse_args()
+
+    graph = CallGraph()
+    for path in args.ci:
+        graph.load(path)
+
+    status = 0
+    for entry in args.entry or DEFAULT_ENTRIES:
+        name = graph.resolve(entry)
+        if name is None:
+            print("%s: no encontrada" % entry, file=sys.stderr)
+            status = 1
+            continue
+        unknown = set()
+        total, chain = graph.deepest(name, unknown)
+        print("%-20s %6d bytes  %s" % (entry, total, " > ".join(chain)))
+        if unknown:
+            print("%-20s sin marco: %s" % ("", ", ".join(sorted(unknown))))
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())